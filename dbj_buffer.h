@@ -2,8 +2,13 @@
 #define DBJ_BUFFER_INC
 
 #ifndef DBJ_ASSERT
+#ifdef _WIN32
 #include <crtdbg.h>
 #define DBJ_ASSERT _ASSERTE
+#else // ! _WIN32
+#include <assert.h>
+#define DBJ_ASSERT assert
+#endif // ! _WIN32
 #endif // ! DBJ_ASSERT
 
 #if 0
@@ -46,7 +51,17 @@
 
 #define DBJ_USES_STD_LIB
 
-#ifdef DBJ_INCLUDES_WINDOWS
+/*
+n2w / w2n are using MultiByteToWideChar / WideCharToMultiByte on Windows
+elsewhere, or if DBJ_BUFFER_UTF_BACKEND is defined, dbj::utf is used
+*/
+#if !defined(_WIN32) && !defined(DBJ_BUFFER_UTF_BACKEND)
+#define DBJ_BUFFER_UTF_BACKEND
+#endif
+
+#ifdef DBJ_BUFFER_UTF_BACKEND
+// no Win32 API
+#elif defined(DBJ_INCLUDES_WINDOWS)
 #include "dbj_windows_include.h"
 #else  // ! DBJ_INCLUDES_WINDOWS
 // these are in Kernel32.lib, in some very unlikely scenario it is not already in your app DLL dependancy tree
@@ -73,6 +88,9 @@ extern "C"
 #endif // ! DBJ_INCLUDES_WINDOWS
 
 #include "./utf/dbj_utf_cpp.h"
+#ifdef DBJ_BUFFER_UTF_BACKEND
+#include "./utf/dbj_utf_view.h"
+#endif // DBJ_BUFFER_UTF_BACKEND
 
 #include <vector>
 #include <type_traits>
@@ -80,13 +98,719 @@ extern "C"
 #include "nonstd/dbj_nonstd.h"
 #include "nonstd/dbj++array.h"
 
+#ifdef DBJ_USES_STD_LIB
+#include <stdio.h>
+#include <string.h>
+#include <charconv>
+#include <string_view>
+
+namespace dbj::nonstd
+{
+	using std::basic_string_view;
+	using std::string_view;
+	using std::wstring_view;
+	using std::vector;
+	using ::snprintf;
+} // namespace dbj::nonstd
+#endif // DBJ_USES_STD_LIB
+
 #undef DBJ_VECTOR
 #define DBJ_VECTOR nonstd::vector
 
+#ifndef CP_ACP
+#define CP_ACP 0 // default to ANSI code page, from winnls.h
+#endif			 // CP_ACP
+
 #ifndef CP_UTF8
 #define CP_UTF8 65001 // UTF-8 translation, from winnls.h
 #endif				  // CP_UTF8
 
+// code page identifiers, there are no macros for these in winnls.h
+#ifndef DBJ_CP_LATIN_1
+#define DBJ_CP_LATIN_1 28591 // ISO 8859-1 Latin 1; Western European (ISO)
+#endif
+#ifndef DBJ_CP_US_ASCII
+#define DBJ_CP_US_ASCII 20127 // US-ASCII (7-bit)
+#endif
+
+#ifdef DBJ_BUFFER_UTF_BACKEND
+#pragma region dbj utf backend
+
+/*
+n2w / w2n made of the dbj::utf kernels, one pass, into the exactly sized vector
+
+	CP_UTF8, CP_ACP  -- UTF-8 to and from UTF-16 or UTF-32, whatever is the
+	                    wchar_t size; the ANSI code page is UTF-8 here
+	DBJ_CP_LATIN_1   -- bytes are code points 0 .. 255
+	DBJ_CP_US_ASCII  -- bytes are code points 0 .. 127
+
+Same as Win32 does, without MB_ERR_INVALID_CHARS, ill formed UTF-8 becomes
+U+FFFD; wide chars not in the single byte code page become '?'. Results are
+zero terminated, the terminator is included in the size.
+*/
+namespace dbj::buffer_utf
+{
+	enum : unsigned
+	{
+		replacement_char = 0xFFFD
+	};
+
+	/*
+	utf8 to utf16 or utf32, as the reference in lenient mode does; sequence
+	where it stops is one U+FFFD: the lead byte and the continuation bytes after it
+	*/
+	template <typename wide_type>
+	inline DBJ_VECTOR<wide_type> utf8_to_wide(const char *text_, size_t size_)
+	{
+		using namespace dbj::utf;
+		static_assert(sizeof(wide_type) == 2 || sizeof(wide_type) == 4);
+		using unit_type = std::conditional_t<sizeof(wide_type) == 2, UTF16, UTF32>;
+
+		const UTF8 *source_ = reinterpret_cast<const UTF8 *>(text_);
+		const UTF8 *const source_end_ = source_ + size_;
+		// exact for valid input
+		size_t count_ = sizeof(wide_type) == 2
+							? utf16_length_from_utf8(source_, source_end_)
+							: utf32_length_from_utf8(source_, source_end_);
+		// continuation bytes at the very beginning are one U+FFFD
+		count_ += (size_ > 0 && (*source_ & 0xC0) == 0x80);
+
+		DBJ_VECTOR<wide_type> rez(count_ + 1, wide_type(0));
+		unit_type *target_ = reinterpret_cast<unit_type *>(rez.data());
+		unit_type *target_end_ = target_ + count_;
+
+		while (source_ < source_end_)
+		{
+			conversion_result status_;
+			if constexpr (sizeof(wide_type) == 2)
+				status_ = convert_utf8_to_utf16(&source_, source_end_, &target_, target_end_, lenientConversion);
+			else
+				status_ = convert_utf8_to_utf32(&source_, source_end_, &target_, target_end_, lenientConversion);
+
+			if (status_ == conversionOK)
+				break;
+			if (status_ == targetExhausted || target_ == target_end_)
+			{
+				/*
+				stray continuation bytes, after the complete sequence, are not
+				counted; there are no more units than the bytes left
+				*/
+				const size_t produced_ = (size_t)(target_ - reinterpret_cast<unit_type *>(rez.data()));
+				const size_t left_ = (size_t)(source_end_ - source_);
+				rez.resize(produced_ + left_ + 1, wide_type(0));
+				target_ = reinterpret_cast<unit_type *>(rez.data()) + produced_;
+				target_end_ = target_ + left_;
+				if (status_ == targetExhausted)
+					continue;
+			}
+			// sourceIllegal or sourceExhausted
+			utf8_view::decode(source_, source_end_, source_);
+			*target_++ = replacement_char;
+		}
+
+		const size_t produced_ = (size_t)(target_ - reinterpret_cast<unit_type *>(rez.data()));
+		if (produced_ + 1 < rez.size())
+			rez.resize(produced_ + 1);
+		return rez;
+	}
+
+	/*
+	utf16 or utf32 to utf8, lenient, unpaired surrogates are encoded as they are
+	only the high surrogate at the very end is U+FFFD, and so is utf32 above U+10FFFF
+	*/
+	template <typename wide_type>
+	inline DBJ_VECTOR<char> wide_to_utf8(const wide_type *text_, size_t size_)
+	{
+		using namespace dbj::utf;
+		static_assert(sizeof(wide_type) == 2 || sizeof(wide_type) == 4);
+		using unit_type = std::conditional_t<sizeof(wide_type) == 2, UTF16, UTF32>;
+
+		const unit_type *source_ = reinterpret_cast<const unit_type *>(text_);
+		const unit_type *const source_end_ = source_ + size_;
+		size_t count_ = 0;
+		if constexpr (sizeof(wide_type) == 2)
+			count_ = utf8_length_from_utf16(source_, source_end_);
+		else
+			count_ = utf8_length_from_utf32(source_, source_end_);
+
+		DBJ_VECTOR<char> rez(count_ + 1, char(0));
+		UTF8 *target_ = reinterpret_cast<UTF8 *>(rez.data());
+		UTF8 *const target_end_ = target_ + count_;
+
+		conversion_result status_;
+		if constexpr (sizeof(wide_type) == 2)
+			status_ = convert_utf16_to_utf8(&source_, source_end_, &target_, target_end_, lenientConversion);
+		else
+			status_ = convert_utf32_to_utf8(&source_, source_end_, &target_, target_end_, lenientConversion);
+
+		if (status_ == sourceExhausted)
+		{
+			// the length of the lone high surrogate is 3, the same as U+FFFD
+			DBJ_ASSERT(target_end_ - target_ >= 3);
+			*target_++ = 0xEF;
+			*target_++ = 0xBF;
+			*target_++ = 0xBD;
+		}
+		else
+		{
+			// utf32 above U+10FFFF is written as U+FFFD, the reference still says sourceIllegal
+			DBJ_ASSERT(status_ == conversionOK || (sizeof(wide_type) == 4 && status_ == sourceIllegal));
+		}
+		DBJ_ASSERT(target_ == target_end_);
+		return rez;
+	}
+
+	/* single byte code page, bytes above the last one are U+FFFD */
+	template <typename wide_type>
+	inline DBJ_VECTOR<wide_type> single_byte_to_wide(const char *text_, size_t size_, unsigned last_)
+	{
+		DBJ_VECTOR<wide_type> rez(size_ + 1, wide_type(0));
+		const unsigned char *source_ = reinterpret_cast<const unsigned char *>(text_);
+		wide_type *target_ = rez.data();
+		for (size_t k = 0; k < size_; ++k)
+			target_[k] = wide_type(source_[k] <= last_ ? unsigned(source_[k]) : unsigned(replacement_char));
+		return rez;
+	}
+
+	/* wide chars above the last one are '?', surrogate pair is one char */
+	template <typename wide_type>
+	inline DBJ_VECTOR<char> wide_to_single_byte(const wide_type *text_, size_t size_, unsigned last_)
+	{
+		DBJ_VECTOR<char> rez(size_ + 1, char(0));
+		char *target_ = rez.data();
+		for (size_t k = 0; k < size_; ++k)
+		{
+			const unsigned ch_ = (unsigned)text_[k];
+			if constexpr (sizeof(wide_type) == 2)
+			{
+				if ((ch_ & 0xFC00) == 0xD800 && k + 1 < size_ && (text_[k + 1] & 0xFC00) == 0xDC00)
+					++k;
+			}
+			*target_++ = ch_ <= last_ ? char(ch_) : '?';
+		}
+		const size_t produced_ = (size_t)(target_ - rez.data());
+		if (produced_ < size_)
+			rez.resize(produced_ + 1);
+		return rez;
+	}
+
+	template <auto CODE_PAGE_>
+	inline constexpr bool supported_code_page =
+		CODE_PAGE_ == CP_UTF8 || CODE_PAGE_ == CP_ACP ||
+		CODE_PAGE_ == DBJ_CP_LATIN_1 || CODE_PAGE_ == DBJ_CP_US_ASCII;
+
+	template <auto CODE_PAGE_, typename wide_type>
+	inline DBJ_VECTOR<wide_type> n2w(const char *text_, size_t size_)
+	{
+		static_assert(supported_code_page<CODE_PAGE_>, "CP_UTF8, CP_ACP, DBJ_CP_LATIN_1 or DBJ_CP_US_ASCII please");
+		if constexpr (CODE_PAGE_ == DBJ_CP_LATIN_1)
+			return single_byte_to_wide<wide_type>(text_, size_, 0xFF);
+		else if constexpr (CODE_PAGE_ == DBJ_CP_US_ASCII)
+			return single_byte_to_wide<wide_type>(text_, size_, 0x7F);
+		else
+			return utf8_to_wide<wide_type>(text_, size_);
+	}
+
+	template <auto CODE_PAGE_, typename wide_type>
+	inline DBJ_VECTOR<char> w2n(const wide_type *text_, size_t size_)
+	{
+		static_assert(supported_code_page<CODE_PAGE_>, "CP_UTF8, CP_ACP, DBJ_CP_LATIN_1 or DBJ_CP_US_ASCII please");
+		if constexpr (CODE_PAGE_ == DBJ_CP_LATIN_1)
+			return wide_to_single_byte(text_, size_, 0xFF);
+		else if constexpr (CODE_PAGE_ == DBJ_CP_US_ASCII)
+			return wide_to_single_byte(text_, size_, 0x7F);
+		else
+			return wide_to_utf8(text_, size_);
+	}
+} // namespace dbj::buffer_utf
+
+#pragma endregion
+#endif // DBJ_BUFFER_UTF_BACKEND
+
+#pragma region dbj buffer format
+
+/*
+printf formatting in one pass, for buffer::format and buffer::format_to
+
+Chars are written straight into the vector, it is grown if too small.
+Arguments are kept as printf has them after the default promotions;
+integers and floats are written by std::to_chars, when there are no
+flags and no width; the other conversions, and these with flags or width,
+are printf-ed one by one. Length modifiers are taken from the arguments,
+hh and h are respected. '*' width or precision, %n and %N$ are not done
+here, format() returns false and the caller printf-s all of it.
+
+The results vs snprintf, and the time vs the two pass snprintf, are the
+DBJ_BUFFER_TEST block at the bottom
+
+g++ -std=c++17 -O2 -DDBJ_BUFFER_TEST -x c++ dbj_buffer.h
+*/
+namespace dbj::buffer_format
+{
+	// the thread scratch starts as big as this
+	constexpr inline size_t scratch_size = 1024;
+
+	// one argument, as printf sees it
+	struct argument final
+	{
+		enum kind_type : unsigned char
+		{
+			signed_kind,
+			unsigned_kind,
+			double_kind,
+			long_double_kind,
+			string_kind,
+			pointer_kind
+		};
+
+		kind_type kind;
+		// bytes of the integer
+		unsigned char size;
+		union
+		{
+			long long i;
+			unsigned long long u;
+			double d;
+			long double ld;
+			const char *s;
+			const void *p;
+		};
+	};
+
+	template <typename T>
+	inline constexpr bool dependent_false = false;
+
+	template <typename T>
+	inline argument make_argument(T value_) noexcept
+	{
+		argument arg_{};
+		if constexpr (std::is_enum_v<T>)
+		{
+			return make_argument(static_cast<std::underlying_type_t<T>>(value_));
+		}
+		else if constexpr (std::is_integral_v<T>)
+		{
+			// promoted to int, bool and char included
+			if constexpr (sizeof(T) < sizeof(int))
+			{
+				arg_.kind = argument::signed_kind;
+				arg_.size = sizeof(int);
+				arg_.i = static_cast<int>(value_);
+			}
+			else if constexpr (std::is_signed_v<T>)
+			{
+				arg_.kind = argument::signed_kind;
+				arg_.size = sizeof(T);
+				arg_.i = static_cast<long long>(value_);
+			}
+			else
+			{
+				arg_.kind = argument::unsigned_kind;
+				arg_.size = sizeof(T);
+				arg_.u = static_cast<unsigned long long>(value_);
+			}
+		}
+		else if constexpr (std::is_same_v<T, long double>)
+		{
+			arg_.kind = argument::long_double_kind;
+			arg_.ld = value_;
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			arg_.kind = argument::double_kind;
+			arg_.d = static_cast<double>(value_);
+		}
+		else if constexpr (std::is_same_v<T, const char *> || std::is_same_v<T, char *>)
+		{
+			arg_.kind = argument::string_kind;
+			arg_.s = value_;
+		}
+		else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>)
+		{
+			arg_.kind = argument::pointer_kind;
+			arg_.p = static_cast<const void *>(value_);
+		}
+		else
+		{
+			static_assert(dependent_false<T>, "not a printf argument");
+		}
+		return arg_;
+	}
+
+	// chars written into the vector, it is resized when full
+	struct writer final
+	{
+		DBJ_VECTOR<char> &out;
+		size_t size;
+
+		char *room(size_t count_)
+		{
+			if (size + count_ > out.size())
+				out.resize(size + count_ > 2 * out.size() ? size + count_ : 2 * out.size());
+			return out.data() + size;
+		}
+
+		void put(const char *chars_, size_t count_)
+		{
+			if (count_ == 0)
+				return;
+			memcpy(room(count_), chars_, count_);
+			size += count_;
+		}
+
+		void put(char char_)
+		{
+			*room(1) = char_;
+			size += 1;
+		}
+
+		void upper(size_t from_)
+		{
+			for (size_t k = from_; k < size; ++k)
+				if (out[k] >= 'a' && out[k] <= 'z')
+					out[k] = char(out[k] - 'a' + 'A');
+		}
+
+		// sign and padding, of the chars written from from_ on
+		void pad(size_t from_, char sign_, bool left_, bool zeros_, size_t width_)
+		{
+			if (sign_ && out[from_] != '-')
+			{
+				room(1);
+				memmove(out.data() + from_ + 1, out.data() + from_, size - from_);
+				out[from_] = sign_;
+				size += 1;
+			}
+			const size_t length_ = size - from_;
+			if (length_ >= width_)
+				return;
+			const size_t fill_ = width_ - length_;
+			char *body_ = room(fill_) - length_;
+			if (left_)
+			{
+				memset(body_ + length_, ' ', fill_);
+			}
+			else
+			{
+				// zeros go after the sign
+				const size_t skip_ = zeros_ && (body_[0] == '-' || body_[0] == '+' || body_[0] == ' ') ? 1 : 0;
+				memmove(body_ + skip_ + fill_, body_ + skip_, length_ - skip_);
+				memset(body_ + skip_, zeros_ ? '0' : ' ', fill_);
+			}
+			size += fill_;
+		}
+	};
+
+	inline bool is_integer(argument const &arg_) noexcept
+	{
+		return arg_.kind == argument::signed_kind || arg_.kind == argument::unsigned_kind;
+	}
+
+	// integer arguments only, size_ bytes of it
+	inline long long as_signed(argument const &arg_, size_t size_) noexcept
+	{
+		DBJ_ASSERT(is_integer(arg_));
+		switch (size_)
+		{
+		case 1: return (signed char)arg_.u;
+		case 2: return (short)arg_.u;
+		case 4: return (int)arg_.u;
+		default: return arg_.i;
+		}
+	}
+
+	inline unsigned long long as_unsigned(argument const &arg_, size_t size_) noexcept
+	{
+		DBJ_ASSERT(is_integer(arg_));
+		return size_ >= sizeof(unsigned long long) ? arg_.u
+			: arg_.u & ((1ULL << (size_ * 8)) - 1);
+	}
+
+	/*
+	the conversion, its length modifier and the argument agree
+	if not, or if the conversion is not known here, printf does it all, with
+	the arguments as they were given: %S, %C, %ls, %lc, %I64d ...
+	*/
+	inline bool matches(char conversion_, const char *modifier_, size_t modifier_size_, argument const &arg_) noexcept
+	{
+		const std::string_view modifier_view_(modifier_, modifier_size_);
+		const bool no_modifier_ = modifier_size_ == 0;
+		switch (conversion_)
+		{
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+			return is_integer(arg_) && (no_modifier_ || modifier_view_ == "hh" || modifier_view_ == "h" ||
+										modifier_view_ == "l" || modifier_view_ == "ll" || modifier_view_ == "j" ||
+										modifier_view_ == "z" || modifier_view_ == "t");
+		case 'c':
+			return is_integer(arg_) && no_modifier_;
+		case 's':
+			return arg_.kind == argument::string_kind && no_modifier_;
+		case 'p':
+			return (arg_.kind == argument::pointer_kind || arg_.kind == argument::string_kind) && no_modifier_;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			if (modifier_view_ == "L")
+				return arg_.kind == argument::long_double_kind;
+			return arg_.kind == argument::double_kind && (no_modifier_ || modifier_view_ == "l");
+		default:
+			return false;
+		}
+	}
+
+	/*
+	one conversion by printf, the spec is flags, width and precision
+	the length modifier is made from the argument
+	*/
+	inline bool printf_one(writer &out_, const char *spec_, size_t spec_size_, char conversion_, argument const &arg_, size_t size_)
+	{
+		char format_[32];
+		if (spec_size_ + 5 > sizeof(format_))
+			return false;
+		size_t k = 0;
+		format_[k++] = '%';
+		memcpy(format_ + k, spec_, spec_size_);
+		k += spec_size_;
+
+		for (int pass_ = 0; pass_ < 2; ++pass_)
+		{
+			const size_t free_ = out_.out.size() - out_.size;
+			char *target_ = out_.out.data() + out_.size;
+			int written_ = -1;
+			format_[k] = 0;
+			switch (conversion_)
+			{
+			case 'd':
+			case 'i':
+				memcpy(format_ + k, "ll", 2), format_[k + 2] = conversion_, format_[k + 3] = 0;
+				written_ = nonstd::snprintf(target_, free_, format_, as_signed(arg_, size_));
+				break;
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				memcpy(format_ + k, "ll", 2), format_[k + 2] = conversion_, format_[k + 3] = 0;
+				written_ = nonstd::snprintf(target_, free_, format_, as_unsigned(arg_, size_));
+				break;
+			case 'c':
+				format_[k] = 'c', format_[k + 1] = 0;
+				written_ = nonstd::snprintf(target_, free_, format_, (int)(unsigned char)as_unsigned(arg_, size_));
+				break;
+			case 's':
+				format_[k] = 's', format_[k + 1] = 0;
+				written_ = nonstd::snprintf(target_, free_, format_, arg_.s ? arg_.s : "(null)");
+				break;
+			case 'p':
+				format_[k] = 'p', format_[k + 1] = 0;
+				written_ = nonstd::snprintf(target_, free_, format_,
+					arg_.kind == argument::string_kind ? (const void *)arg_.s : arg_.p);
+				break;
+			default:
+				// the floating ones, matches() has seen to it
+				if (arg_.kind == argument::long_double_kind)
+				{
+					format_[k] = 'L', format_[k + 1] = conversion_, format_[k + 2] = 0;
+					written_ = nonstd::snprintf(target_, free_, format_, arg_.ld);
+				}
+				else
+				{
+					format_[k] = conversion_, format_[k + 1] = 0;
+					written_ = nonstd::snprintf(target_, free_, format_, arg_.d);
+				}
+				break;
+			}
+			if (written_ < 0)
+				return false;
+			if ((size_t)written_ < free_)
+			{
+				out_.size += (size_t)written_;
+				return true;
+			}
+			// the terminator too
+			out_.room((size_t)written_ + 1);
+		}
+		return false;
+	}
+
+	/*
+	into out_ from at_ on, zero terminated
+	size_ is the chars written, the terminator excluded
+	false if printf has to do it all
+	*/
+	inline bool format(DBJ_VECTOR<char> &out_, size_t at_, const char *format_,
+					   const argument *args_, size_t count_, size_t &size_)
+	{
+		writer out_writer_{out_, at_};
+		size_t next_ = 0;
+		const char *pos_ = format_;
+		while (*pos_)
+		{
+			const char *percent_ = strchr(pos_, '%');
+			if (percent_ == nullptr)
+			{
+				out_writer_.put(pos_, strlen(pos_));
+				break;
+			}
+			out_writer_.put(pos_, (size_t)(percent_ - pos_));
+
+			const char *spec_ = percent_ + 1;
+			if (*spec_ == '%')
+			{
+				out_writer_.put('%');
+				pos_ = spec_ + 1;
+				continue;
+			}
+
+			const char *next_char_ = spec_;
+			bool left_ = false, zeros_ = false, alternate_ = false;
+			char sign_ = 0;
+			for (;; ++next_char_)
+			{
+				if (*next_char_ == '-')
+					left_ = true;
+				else if (*next_char_ == '0')
+					zeros_ = true;
+				else if (*next_char_ == '#')
+					alternate_ = true;
+				else if (*next_char_ == '+')
+					sign_ = '+';
+				else if (*next_char_ == ' ')
+					sign_ = sign_ ? sign_ : ' ';
+				else
+					break;
+			}
+			zeros_ = zeros_ && !left_;
+			size_t width_ = 0;
+			for (; *next_char_ >= '0' && *next_char_ <= '9'; ++next_char_)
+				width_ = width_ * 10 + size_t(*next_char_ - '0');
+			int precision_ = -1;
+			if (*next_char_ == '.')
+			{
+				precision_ = 0;
+				for (++next_char_; *next_char_ >= '0' && *next_char_ <= '9'; ++next_char_)
+					precision_ = precision_ * 10 + (*next_char_ - '0');
+			}
+			if (*next_char_ == '*' || *next_char_ == '$')
+				return false;
+			const size_t spec_size_ = (size_t)(next_char_ - spec_);
+
+			const char *modifier_ = next_char_;
+			while (*next_char_ && strchr("hljztL", *next_char_))
+				++next_char_;
+			const size_t modifier_size_ = (size_t)(next_char_ - modifier_);
+			const char conversion_ = *next_char_;
+			if (conversion_ == 0 || next_ == count_ || !matches(conversion_, modifier_, modifier_size_, args_[next_]))
+				return false;
+			argument const &arg_ = args_[next_++];
+			pos_ = next_char_ + 1;
+
+			// hh and h cut the integer
+			size_t length_ = 0;
+			if (modifier_size_ > 0 && modifier_[0] == 'h')
+				length_ = modifier_size_ == 2 ? 1 : 2;
+			const size_t size_arg_ = length_ ? length_ : (is_integer(arg_) ? arg_.size : 8);
+			const size_t from_ = out_writer_.size;
+			char chars_[64];
+			std::to_chars_result done_{};
+
+			switch (conversion_)
+			{
+			case 'd':
+			case 'i':
+				if (alternate_ || precision_ >= 0)
+					break;
+				done_ = std::to_chars(chars_, chars_ + sizeof(chars_), as_signed(arg_, size_arg_));
+				out_writer_.put(chars_, (size_t)(done_.ptr - chars_));
+				out_writer_.pad(from_, sign_, left_, zeros_, width_);
+				continue;
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				if (alternate_ || precision_ >= 0)
+					break;
+				done_ = std::to_chars(chars_, chars_ + sizeof(chars_), as_unsigned(arg_, size_arg_),
+									  conversion_ == 'u' ? 10 : conversion_ == 'o' ? 8 : 16);
+				out_writer_.put(chars_, (size_t)(done_.ptr - chars_));
+				if (conversion_ == 'X')
+					out_writer_.upper(from_);
+				out_writer_.pad(from_, 0, left_, zeros_, width_);
+				continue;
+			case 'c':
+				if (zeros_)
+					break;
+				out_writer_.put((char)as_unsigned(arg_, 1));
+				out_writer_.pad(from_, 0, left_, false, width_);
+				continue;
+			case 's':
+				if (zeros_ || arg_.kind != argument::string_kind || arg_.s == nullptr)
+					break;
+				if (precision_ < 0)
+					out_writer_.put(arg_.s, strlen(arg_.s));
+				else
+					out_writer_.put(arg_.s, strnlen(arg_.s, (size_t)precision_));
+				out_writer_.pad(from_, 0, left_, false, width_);
+				continue;
+#if defined(__cpp_lib_to_chars)
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+			{
+				if (alternate_ || arg_.kind != argument::double_kind)
+					break;
+				const std::chars_format style_ = (conversion_ == 'f' || conversion_ == 'F') ? std::chars_format::fixed
+												 : (conversion_ == 'e' || conversion_ == 'E') ? std::chars_format::scientific
+																							   : std::chars_format::general;
+				// fixed can be long, 1e308 is 309 digits
+				char *target_ = out_writer_.room(320 + (size_t)precision_ * (precision_ > 0));
+				done_ = std::to_chars(target_, out_.data() + out_.size(), arg_.d, style_, precision_ < 0 ? 6 : precision_);
+				if (done_.ec != std::errc())
+					break;
+				out_writer_.size += (size_t)(done_.ptr - target_);
+				if (conversion_ == 'F' || conversion_ == 'E' || conversion_ == 'G')
+					out_writer_.upper(from_);
+				// no zeros before inf and nan
+				const char first_ = out_[from_ + (out_[from_] == '-')];
+				out_writer_.pad(from_, sign_, left_, zeros_ && first_ >= '0' && first_ <= '9', width_);
+				continue;
+			}
+#endif // __cpp_lib_to_chars
+			default:
+				break;
+			}
+
+			if (!printf_one(out_writer_, spec_, spec_size_, conversion_, arg_, size_arg_))
+				return false;
+		}
+
+		out_writer_.put('\0');
+		size_ = out_writer_.size - 1 - at_;
+		return true;
+	}
+
+	// of this thread, kept for the next format
+	inline DBJ_VECTOR<char> &scratch() noexcept
+	{
+		thread_local DBJ_VECTOR<char> scratch_(scratch_size);
+		return scratch_;
+	}
+} // namespace dbj::buffer_format
+
+#pragma endregion
+
 #pragma region buffer type and helper
 
 namespace dbj
@@ -156,8 +880,12 @@ namespace dbj
 		{
 			DBJ_ASSERT(sview_.size() > 0);
 			DBJ_ASSERT(DBJ_MAX_BUFER_SIZE >= sview_.size());
+#ifdef DBJ_BUFFER_UTF_BACKEND
+			return buffer_utf::wide_to_utf8(sview_.data(), sview_.size());
+#else
 			// zero terminate?
 			return type::w2n((wchar_t *)sview_.data());
+#endif
 		}
 
 		static DBJ_VECTOR<char> make(nonstd::basic_string_view<wchar_t> sview_)
@@ -168,6 +896,10 @@ namespace dbj
 			return type::w2n(sview_.data());
 		}
 
+		/*
+		printf like, in one pass, into the scratch of this thread
+		the result is exactly sized and zero terminated
+		*/
 		template <
 			typename... Args, size_t max_arguments = 255>
 		static value_type
@@ -175,17 +907,36 @@ namespace dbj
 		{
 			static_assert(sizeof...(args) < max_arguments, "\n\nmax 255 arguments allowed\n");
 			DBJ_ASSERT(format_);
-			// 1: what is the size required
-			size_t size = 1 + size_t(
-								  nonstd::snprintf(nullptr, 0, format_, args...));
-			DBJ_ASSERT(size > 0);
-			// 2: use it at runtime
-			value_type buf = make(size);
-			//
-			size = nonstd::snprintf(buf.data(), size, format_, args...);
-			DBJ_ASSERT(size > 0);
+			DBJ_VECTOR<char> &scratch_ = buffer_format::scratch();
+			const size_t size = format_to(scratch_, format_, args...);
+			return value_type(scratch_.data(), scratch_.data() + size + 1);
+		}
 
-			return buf;
+		/*
+		printf like, in one pass, into the caller buffer, from its start
+		buffer is resized if too small, never shrunk
+		returns the chars written, the zero terminator excluded
+		*/
+		template <
+			typename... Args, size_t max_arguments = 255>
+		static size_t
+		format_to(DBJ_VECTOR<char> &buffer_, char const *format_, Args... args) noexcept
+		{
+			static_assert(sizeof...(args) < max_arguments, "\n\nmax 255 arguments allowed\n");
+			static_assert(nonstd::is_same_v<char_type, char>, "char buffer please");
+			DBJ_ASSERT(format_);
+
+			const buffer_format::argument arguments_[sizeof...(args) + 1] = {buffer_format::make_argument(args)...};
+			size_t size = 0;
+			if (buffer_format::format(buffer_, 0, format_, arguments_, sizeof...(args), size))
+				return size;
+
+			// printf it is, twice
+			size = size_t(nonstd::snprintf(nullptr, 0, format_, args...));
+			if (buffer_.size() < size + 1)
+				buffer_.resize(size + 1);
+			nonstd::snprintf(buffer_.data(), size + 1, format_, args...);
+			return size;
 		}
 
 		// replace char with another char
@@ -217,21 +968,29 @@ namespace dbj
 		template <auto CODE_PAGE_T_P_ = CP_UTF8>
 		static DBJ_VECTOR<wchar_t> n2w(nonstd::string_view s)
 		{
+#ifdef DBJ_BUFFER_UTF_BACKEND
+			return buffer_utf::n2w<CODE_PAGE_T_P_, wchar_t>(s.data(), s.size());
+#else
 			const int slength = (int)s.size() + 1;
 			int len = MultiByteToWideChar(CODE_PAGE_T_P_, 0, s.data(), slength, 0, 0);
 			DBJ_VECTOR<wchar_t> rez(len, L'\0');
 			MultiByteToWideChar(CODE_PAGE_T_P_, 0, s.data(), slength, rez.data(), len);
 			return rez;
+#endif // ! DBJ_BUFFER_UTF_BACKEND
 		}
 		/*wide to narrow*/
 		template <auto CODE_PAGE_T_P_ = CP_UTF8>
 		static value_type w2n(nonstd::wstring_view s)
 		{
+#ifdef DBJ_BUFFER_UTF_BACKEND
+			return buffer_utf::w2n<CODE_PAGE_T_P_>(s.data(), s.size());
+#else
 			const int slength = (int)s.size() + 1;
 			int len = WideCharToMultiByte(CODE_PAGE_T_P_, 0, s.data(), slength, 0, 0, 0, 0);
 			value_type rez(len, '\0');
 			WideCharToMultiByte(CODE_PAGE_T_P_, 0, s.data(), slength, rez.data(), len, 0, 0);
 			return rez;
+#endif // ! DBJ_BUFFER_UTF_BACKEND
 		}
 	}; // buffer
 
@@ -261,4 +1020,161 @@ namespace dbj
 
 #pragma endregion
 
+#ifdef DBJ_BUFFER_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <wchar.h>
+#include <chrono>
+#include <string>
+
+/*
+first every format is compared with snprintf, flags, width, precision,
+length modifiers, inf and nan, and the ones left to printf: %S, %ls, %lc,
+'*', %N$ ... then the time per call, best of 5 runs, buffer::format vs
+the two pass snprintf it has replaced
+*/
+namespace dbj_buffer_test
+{
+	namespace nonstd = dbj::nonstd;
+
+	constexpr int calls_count = 200000;
+	constexpr int runs_count = 5;
+
+	inline int failed_ = 0;
+
+	// the old way, size first then print
+	template <typename... Args>
+	inline DBJ_VECTOR<char> two_pass(char const *format_, Args... args)
+	{
+		const size_t size_ = 1 + size_t(nonstd::snprintf(nullptr, 0, format_, args...));
+		DBJ_VECTOR<char> rez_(size_);
+		nonstd::snprintf(rez_.data(), size_, format_, args...);
+		return rez_;
+	}
+
+	template <typename... Args>
+	inline void check(char const *format_, Args... args)
+	{
+		const DBJ_VECTOR<char> expected_ = two_pass(format_, args...);
+		const DBJ_VECTOR<char> got_ = dbj::buffer<char>::format(format_, args...);
+		if (got_ != expected_)
+		{
+			printf("\"%s\" gives \"%s\", snprintf gives \"%s\"\n", format_, got_.data(), expected_.data());
+			++failed_;
+		}
+		// too small to start with
+		DBJ_VECTOR<char> to_(3, 'x');
+		const size_t size_ = dbj::buffer<char>::format_to(to_, format_, args...);
+		if (size_ + 1 != expected_.size() || strcmp(to_.data(), expected_.data()) != 0)
+		{
+			printf("\"%s\" format_to gives \"%s\", snprintf gives \"%s\"\n", format_, to_.data(), expected_.data());
+			++failed_;
+		}
+	}
+
+	inline volatile size_t sink_ = 0;
+
+	// nanoseconds per call, the best of the runs
+	template <typename F>
+	inline double per_call(F call_)
+	{
+		double best_ = 1e9;
+		for (int run_ = 0; run_ < runs_count; ++run_)
+		{
+			const auto start_ = std::chrono::steady_clock::now();
+			size_t sum_ = 0;
+			for (int k = 0; k < calls_count; ++k)
+				sum_ += call_(k);
+			const double took_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+			sink_ = sum_;
+			best_ = took_ < best_ ? took_ : best_;
+		}
+		return best_ / calls_count * 1e9;
+	}
+
+	inline void report(char const *prompt_, double old_, double new_)
+	{
+		printf("%-10s snprintf twice %7.1f ns, format %7.1f ns, x%.2f\n", prompt_, old_, new_, old_ / new_);
+	}
+
+	enum plain_enum
+	{
+		plain_seven = 7
+	};
+} // namespace dbj_buffer_test
+
+int main(void)
+{
+	using namespace dbj_buffer_test;
+	using dbj::buffer;
+
+	check("plain");
+	check("");
+	check("%%|a%%b%d", 5);
+	check("%d %i %u %x %X %o", -42, INT_MIN, 4000000000u, 0xdeadbeef, 0xabcdefu, 8);
+	check("%ld %lld %lu %llx %zu %zd", -1L, LLONG_MIN, ULONG_MAX, ULLONG_MAX, (size_t)123, (ptrdiff_t)-9);
+	check("%hhd %hhu %hd %hu %hhx %hhi", 300, 300, 70000, 70000, -1, 257);
+	check("%jd %td %zx", (intmax_t)-8, (ptrdiff_t)3, (size_t)-1);
+	check("%5d|%-5d|%05d|%+d|% d|%#x|%#o|%.3d|%8.3d|%.0d", 42, 42, 42, 42, 42, 255, 8, 7, 7, 0);
+	check("%-8x|%08X|% 05d|%-+6d|%1d|%- 5d|%-05d", 255, 255, -3, 4, -7, 3, 4);
+	check("%c%c%3c%-3c|%03c", 'a', 65, 'z', 'q', 'c');
+	check("%s|%.2s|%10s|%-10s|%.0s|%05s", "hello", "hello", "hi", "hi", "x", "s");
+	check("%f %F %e %E %g %G %a %A", 3.14159, 1e300, 0.000123, -2.5e-10, 1e-5, 1.5e20, 1.5, 0.1);
+	check("%.0f %.3f %.10f %.0e %.0g %.1g %.17g", 2.5, -0.0005, 1.0 / 3, 12345.0, 0.5, 0.05, 0.1);
+	check("%f %e %g %f %f", 1e308, 1e-320, 0.0, -0.0, 1.5f);
+	check("%f %F %g %010f", HUGE_VAL, -HUGE_VAL, nan(""), HUGE_VAL);
+	check("%10.3f|%-10.2e|%+g|%#g|%010.4f|%-010g|%+010.1e", 3.14159, 2.0, 1.0, 1.0, -3.5, 0.1, -1e10);
+	check("%Lf %Lg %.3Le %lf %lg", (long double)1.25, (long double)1e100, (long double)2, 2.5, 1e-7);
+	check("%p %p %p", (void *)0x1234, (void *)nullptr, "x");
+	check("%d %d %d %d", true, (short)-3, (char)'A', plain_seven);
+	// printf does all of these
+	check("%*d|%-*d|%.*f", 5, 42, 4, 1, 2, 3.14159);
+	check("%2$s %1$s", "a", "b");
+	check("%S|%ls|%5ls|%-6S|", L"wide", L"wide", L"ab", L"cd");
+	check("%lc|%C|%3lc", (wint_t)L'w', (wint_t)L'z', (wint_t)L'q');
+	const std::string long_(5000, 'y');
+	check("%s!%d", long_.c_str(), 1);
+
+	if (failed_)
+	{
+		printf("%d formats differ from snprintf\n", failed_);
+		return EXIT_FAILURE;
+	}
+	printf("all the formats match snprintf\n");
+
+	DBJ_VECTOR<char> to_;
+	report("log line",
+		   per_call([](int k)
+					{ return two_pass("%s [%d] %s: took %.3f ms, %zu bytes", "2026-10-17", k, "worker", k * 0.37, (size_t)k * 3).size(); }),
+		   per_call([](int k)
+					{ return buffer<char>::format("%s [%d] %s: took %.3f ms, %zu bytes", "2026-10-17", k, "worker", k * 0.37, (size_t)k * 3).size(); }));
+	report("format_to",
+		   per_call([](int k)
+					{ return two_pass("%s [%d] %s: took %.3f ms, %zu bytes", "2026-10-17", k, "worker", k * 0.37, (size_t)k * 3).size(); }),
+		   per_call([&](int k)
+					{ return buffer<char>::format_to(to_, "%s [%d] %s: took %.3f ms, %zu bytes", "2026-10-17", k, "worker", k * 0.37, (size_t)k * 3); }));
+	report("integers",
+		   per_call([](int k)
+					{ return two_pass("id=%d count=%u off=%lld flags=%x", k, k * 7u, (long long)k << 20, k).size(); }),
+		   per_call([](int k)
+					{ return buffer<char>::format("id=%d count=%u off=%lld flags=%x", k, k * 7u, (long long)k << 20, k).size(); }));
+	report("width",
+		   per_call([](int k)
+					{ return two_pass("%08x %5d %-10s|", k, k, "abc").size(); }),
+		   per_call([](int k)
+					{ return buffer<char>::format("%08x %5d %-10s|", k, k, "abc").size(); }));
+	report("floats",
+		   per_call([](int k)
+					{ return two_pass("v=%g w=%e", k * 1.1, k * 0.01).size(); }),
+		   per_call([](int k)
+					{ return buffer<char>::format("v=%g w=%e", k * 1.1, k * 0.01).size(); }));
+	return EXIT_SUCCESS;
+}
+
+#endif // DBJ_BUFFER_TEST
+
 #endif // DBJ_BUFFER_INC
\ No newline at end of file
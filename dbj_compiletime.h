@@ -392,6 +392,187 @@ namespace dbj::compiletime
 		return (v1 == v2) && (v2 == v3);
 	};
 
+	/*
+	----------------------------------------------------------------------------------------------------------------
+	Minimal perfect hash table of the string literals, made at compile time. CHD like.
+
+	Keys are hashed into buckets, a bucket is given a seed that sends all of its keys
+	to the free slots; the biggest buckets first. Slot of the key is found with one
+	hash of it and one integer mix with the seed of its bucket, and then compared
+	once. No heap, no collisions, N keys in N slots.
+
+		constexpr auto verbs_ = dbj::compiletime::make_perfect_hash("GET", "PUT", "POST", "DELETE");
+		static_assert(verbs_.find("POST") == 2);
+		static_assert(verbs_.find("PATCH") == verbs_.npos);
+
+		switch (verbs_.find(verb_)) { case 0: ... }
+
+	Index is the position of the key in the list. Keys must be different.
+
+	Same keys, or no seed found, do not compile when the table is constexpr, release builds
+	included. Made at run time the table is not valid and finds nothing; there, check it:
+
+		static_assert(verbs_.valid);
+	*/
+
+	// FNV-1a, constexpr and good enough for the short keys
+	constexpr inline uint64_t perfect_hash_key(std::string_view key_) noexcept
+	{
+		uint64_t hash_ = 0xCBF29CE484222325ULL;
+		for (char c_ : key_)
+		{
+			hash_ ^= uint8_t(c_);
+			hash_ *= 0x100000001B3ULL;
+		}
+		return hash_;
+	}
+
+	constexpr inline uint64_t perfect_hash_mix(uint64_t hash_, uint32_t seed_) noexcept
+	{
+		hash_ ^= uint64_t(seed_) * 0x9E3779B97F4A7C15ULL;
+		hash_ ^= hash_ >> 33;
+		hash_ *= 0xFF51AFD7ED558CCDULL;
+		hash_ ^= hash_ >> 33;
+		return hash_;
+	}
+
+	// not constexpr, thus the constexpr make() that calls it does not compile
+	inline void perfect_hash_failed(const char* why_) noexcept
+	{
+		(void)why_;
+		assert(false && "perfect_hash_table could not be made");
+	}
+
+	template <size_t N>
+	struct perfect_hash_table final
+	{
+		static_assert(N > 0, "perfect_hash_table of no keys");
+
+		constexpr inline static size_t npos = size_t(-1);
+		constexpr inline static size_t buckets = (N + 1) / 2;
+		// seed search stops here, that is not expected to happen
+		constexpr inline static uint32_t max_seed = 0xFFFF;
+
+		// in the order given
+		std::array<std::string_view, N> keys{};
+		std::array<uint32_t, buckets> seeds{};
+		// index of the key in the slot
+		std::array<uint32_t, N> slots{};
+		bool valid = false;
+
+		static constexpr size_t bucket_of(uint64_t hash_) noexcept { return size_t(hash_ >> 32) % buckets; }
+
+		static constexpr size_t slot_of(uint64_t hash_, uint32_t seed_) noexcept
+		{
+			return size_t(perfect_hash_mix(hash_, seed_) % N);
+		}
+
+		// index of the key or npos
+		constexpr size_t find(std::string_view key_) const noexcept
+		{
+			if (!valid)
+				return npos;
+			const uint64_t hash_ = perfect_hash_key(key_);
+			const uint32_t index_ = slots[slot_of(hash_, seeds[bucket_of(hash_)])];
+			return keys[index_] == key_ ? index_ : npos;
+		}
+
+		constexpr std::string_view key(size_t index_) const noexcept
+		{
+			assert(index_ < N);
+			return keys[index_];
+		}
+
+		constexpr size_t size() const noexcept { return N; }
+
+		constexpr static perfect_hash_table make(std::array<std::string_view, N> const& keys_) noexcept
+		{
+			perfect_hash_table table_{};
+			table_.keys = keys_;
+
+			std::array<uint64_t, N> hashes_{};
+			// keys of the bucket b are members_[first_[b] .. first_[b + 1])
+			std::array<size_t, buckets + 1> first_{};
+			std::array<size_t, N> members_{};
+			for (size_t k = 0; k < N; ++k)
+			{
+				hashes_[k] = perfect_hash_key(keys_[k]);
+				++first_[bucket_of(hashes_[k]) + 1];
+			}
+			size_t biggest_ = 0;
+			for (size_t b = 0; b < buckets; ++b)
+			{
+				biggest_ = first_[b + 1] > biggest_ ? first_[b + 1] : biggest_;
+				first_[b + 1] += first_[b];
+			}
+			std::array<size_t, buckets> filled_{};
+			for (size_t k = 0; k < N; ++k)
+			{
+				const size_t b = bucket_of(hashes_[k]);
+				// the same keys are in the same bucket
+				for (size_t m = first_[b]; m < first_[b] + filled_[b]; ++m)
+				{
+					if (keys_[members_[m]] == keys_[k])
+					{
+						perfect_hash_failed("perfect_hash_table: keys are not all different");
+						return table_;
+					}
+				}
+				members_[first_[b] + filled_[b]++] = k;
+			}
+
+			std::array<bool, N> taken_{};
+			std::array<size_t, N> tried_{};
+			for (size_t size_ = biggest_; size_ > 0; --size_)
+			{
+				for (size_t b = 0; b < buckets; ++b)
+				{
+					if (first_[b + 1] - first_[b] != size_)
+						continue;
+
+					uint32_t seed_ = 0;
+					for (;; ++seed_)
+					{
+						if (seed_ > max_seed)
+						{
+							perfect_hash_failed("perfect_hash_table: no seed found");
+							return table_;
+						}
+
+						size_t placed_ = 0;
+						for (; placed_ < size_; ++placed_)
+						{
+							const size_t slot_ = slot_of(hashes_[members_[first_[b] + placed_]], seed_);
+							bool free_ = !taken_[slot_];
+							for (size_t t = 0; t < placed_ && free_; ++t)
+								free_ = tried_[t] != slot_;
+							if (!free_)
+								break;
+							tried_[placed_] = slot_;
+						}
+						if (placed_ == size_)
+							break;
+					}
+
+					table_.seeds[b] = seed_;
+					for (size_t m = 0; m < size_; ++m)
+					{
+						taken_[tried_[m]] = true;
+						table_.slots[tried_[m]] = uint32_t(members_[first_[b] + m]);
+					}
+				}
+			}
+			table_.valid = true;
+			return table_;
+		}
+	};
+
+	template <typename... literal_types>
+	constexpr inline auto make_perfect_hash(literal_types const&... literals_) noexcept
+	{
+		return perfect_hash_table<sizeof...(literals_)>::make({ std::string_view(literals_)... });
+	}
+
 } // namespace dbj::compiletime
 
 #endif // !DBJ_COMPILE_TIME_H_
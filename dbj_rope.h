@@ -0,0 +1,698 @@
+#ifndef DBJ_ROPE_INC
+#define DBJ_ROPE_INC
+
+/*
+ (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+ Rope, for the large documents made by many appends. Appending to a
+ std::string or to the dbj::buffer copies all of it, from time to time;
+ the rope never does.
+
+ - concatenation, slicing and the char at the index are O(log n)
+ - the text is in chunks, chunk_size bytes each, shared and never changed
+ - the tree is a balanced (AVL) tree of reference counted nodes, shared
+   by the ropes made from one another; ropes are thus cheap to copy
+ - small appends are written into the room left in the last chunk,
+   if no other rope has done that already
+
+ flatten_into() copies all of it out, once. to_iovec() gives the chunks
+ to writev(), nothing is copied:
+
+	dbj::rope doc_;
+	doc_.append("<html>").append(body_).append("</html>");
+
+	dbj::rope_iovec vec_[64];
+	for (size_t done_ = 0; done_ < doc_.size();)
+	{
+		const size_t count_ = doc_.to_iovec(vec_, 64, done_);
+		done_ += (size_t)writev(fd_, vec_, (int)count_);
+	}
+
+ Ropes are values, a rope is used from one thread at the time. Ropes
+ sharing the chunks and the nodes can be used from different threads.
+
+ Random appends, concatenations, slices and iovecs vs std::string, and the
+ appends of many threads to the copies of one rope, are the DBJ_ROPE_TEST
+ block at the bottom
+
+	g++ -std=c++17 -O2 -pthread -DDBJ_ROPE_TEST -x c++ dbj_rope.h
+*/
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace dbj
+{
+#ifdef _WIN32
+	// as the POSIX one
+	struct rope_iovec final
+	{
+		void* iov_base;
+		size_t iov_len;
+	};
+#else
+	using rope_iovec = ::iovec;
+#endif
+
+	class rope final
+	{
+	public:
+		// bytes of one chunk, larger appends are split
+		constexpr inline static size_t chunk_size = 4096;
+
+		rope() noexcept = default;
+
+		explicit rope(std::string_view text) noexcept { append(text); }
+
+		rope(rope const& other_) noexcept : root(acquire_(other_.root)) {}
+
+		rope& operator=(rope const& other_) noexcept
+		{
+			node* old_ = root;
+			root = acquire_(other_.root);
+			release_(old_);
+			return *this;
+		}
+
+		rope(rope&& other_) noexcept : root(other_.root) { other_.root = nullptr; }
+
+		rope& operator=(rope&& other_) noexcept
+		{
+			std::swap(root, other_.root);
+			return *this;
+		}
+
+		~rope() noexcept { release_(root); }
+
+		size_t size() const noexcept { return root ? root->size : 0; }
+
+		bool empty() const noexcept { return root == nullptr; }
+
+		// O(log n)
+		char operator[](size_t index) const noexcept
+		{
+			assert(index < size());
+			const node* node_ = root;
+			while (node_->left)
+			{
+				if (index < node_->left->size)
+				{
+					node_ = node_->left;
+				}
+				else
+				{
+					index -= node_->left->size;
+					node_ = node_->right;
+				}
+			}
+			return node_->block->chars()[node_->offset + index];
+		}
+
+		// O(log n), no chars are copied
+		rope& append(rope const& other) noexcept
+		{
+			root = join_(root, acquire_(other.root));
+			return *this;
+		}
+
+		// O(log n) for one chunk of the text
+		rope& append(std::string_view text) noexcept
+		{
+			if (text.empty())
+				return *this;
+
+			// into the room of the last chunk
+			if (root)
+			{
+				const node* last_ = root;
+				while (last_->right)
+					last_ = last_->right;
+				chunk* block_ = last_->block;
+				size_t used_ = last_->offset + last_->size;
+				if (block_->capacity - used_ >= text.size()
+					&& block_->used.compare_exchange_strong(used_, used_ + text.size()))
+				{
+					memcpy(block_->chars() + used_, text.data(), text.size());
+					if (unique_last_(root))
+					{
+						// no other rope can see the change
+						for (node* node_ = root; node_; node_ = node_->right)
+							node_->size += text.size();
+						return *this;
+					}
+					node* grown_ = make_leaf_(acquire_(block_), last_->offset, last_->size + text.size());
+					node* old_ = root;
+					root = replace_last_(old_, grown_);
+					release_(old_);
+					return *this;
+				}
+			}
+
+			for (size_t done_ = 0; done_ < text.size(); done_ += chunk_size)
+			{
+				const size_t size_ = text.size() - done_ < chunk_size ? text.size() - done_ : chunk_size;
+				chunk* block_ = make_chunk_(chunk_size);
+				memcpy(block_->chars(), text.data() + done_, size_);
+				block_->used.store(size_, std::memory_order_relaxed);
+				root = join_(root, make_leaf_(block_, 0, size_));
+			}
+			return *this;
+		}
+
+		rope& operator+=(rope const& other) noexcept { return append(other); }
+		rope& operator+=(std::string_view text) noexcept { return append(text); }
+
+		// O(log n)
+		friend rope operator+(rope const& left, rope const& right) noexcept
+		{
+			rope result_(left);
+			result_.append(right);
+			return result_;
+		}
+
+		// count chars from pos, or less if there are no more, O(log n)
+		rope substr(size_t pos, size_t count = size_t(-1)) const noexcept
+		{
+			assert(pos <= size());
+			if (count > size() - pos)
+				count = size() - pos;
+
+			rope result_;
+			if (count > 0)
+				result_.root = slice_(root, pos, pos + count);
+			return result_;
+		}
+
+		// callback(std::string_view) for each piece from the byte pos on, in order
+		// callback returns false to stop
+		template<typename callback_type>
+		void for_each_piece(callback_type&& callback, size_t pos = 0) const
+		{
+			assert(pos <= size());
+			if (root && pos < root->size)
+				pieces_(root, pos, callback);
+		}
+
+		// linear, the buffer is at least size() chars
+		// returns the chars copied
+		size_t flatten_into(char* buffer, size_t buffer_size) const noexcept
+		{
+			assert(buffer || buffer_size == 0);
+			size_t done_ = 0;
+			for_each_piece([&](std::string_view piece_) {
+				const size_t size_ = piece_.size() < buffer_size - done_ ? piece_.size() : buffer_size - done_;
+				memcpy(buffer + done_, piece_.data(), size_);
+				done_ += size_;
+				return done_ < buffer_size;
+				});
+			return done_;
+		}
+
+		// buffer with resize() and data(), std::string or std::vector<char> for example
+		// size() chars, no zero after them; std::string has its own, for the
+		// dbj::buffer values, zero terminated, use flatten_into_terminated()
+		template<typename buffer_type>
+		void flatten_into(buffer_type& buffer) const
+		{
+			buffer.resize(size());
+			flatten_into(buffer.data(), size());
+		}
+
+		// size() chars and the zero, buffer.size() is size() + 1, as of dbj::buffer
+		template<typename buffer_type>
+		void flatten_into_terminated(buffer_type& buffer) const
+		{
+			buffer.resize(size() + 1);
+			flatten_into(buffer.data(), size());
+			buffer[size()] = 0;
+		}
+
+		// up to count pieces from the byte pos on
+		// returns the pieces filled, 0 when there is nothing from pos
+		size_t to_iovec(rope_iovec* vec, size_t count, size_t pos = 0) const noexcept
+		{
+			assert(vec || count == 0);
+			size_t done_ = 0;
+			if (count == 0)
+				return 0;
+			for_each_piece([&](std::string_view piece_) {
+				vec[done_].iov_base = const_cast<char*>(piece_.data());
+				vec[done_].iov_len = piece_.size();
+				return ++done_ < count;
+				}, pos);
+			return done_;
+		}
+
+	private:
+		// chars follow, the ones before used are never changed
+		struct chunk final
+		{
+			std::atomic<size_t> refs;
+			std::atomic<size_t> used;
+			size_t capacity;
+
+			char* chars() noexcept { return reinterpret_cast<char*>(this + 1); }
+		};
+
+		// leaf: left and right are null, size chars of the block from the offset
+		struct node final
+		{
+			std::atomic<size_t> refs;
+			size_t size;
+			size_t height;
+			node* left;
+			node* right;
+			chunk* block;
+			size_t offset;
+		};
+
+		node* root = nullptr;
+
+		static chunk* make_chunk_(size_t capacity_) noexcept
+		{
+			void* memory_ = ::operator new(sizeof(chunk) + capacity_);
+			chunk* block_ = new (memory_) chunk{};
+			block_->refs.store(1, std::memory_order_relaxed);
+			block_->capacity = capacity_;
+			return block_;
+		}
+
+		static chunk* acquire_(chunk* block_) noexcept
+		{
+			block_->refs.fetch_add(1, std::memory_order_relaxed);
+			return block_;
+		}
+
+		static node* acquire_(node* node_) noexcept
+		{
+			if (node_)
+				node_->refs.fetch_add(1, std::memory_order_relaxed);
+			return node_;
+		}
+
+		static void release_(chunk* block_) noexcept
+		{
+			if (block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				block_->~chunk();
+				::operator delete(block_);
+			}
+		}
+
+		// the depth is O(log n), recursion is fine
+		static void release_(node* node_) noexcept
+		{
+			if (node_ == nullptr || node_->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			if (node_->block)
+			{
+				release_(node_->block);
+			}
+			else
+			{
+				release_(node_->left);
+				release_(node_->right);
+			}
+			delete node_;
+		}
+
+		static size_t height_(const node* node_) noexcept { return node_ ? node_->height : 0; }
+
+		// takes the reference of the block
+		static node* make_leaf_(chunk* block_, size_t offset_, size_t size_) noexcept
+		{
+			assert(size_ > 0);
+			node* node_ = new node{};
+			node_->refs.store(1, std::memory_order_relaxed);
+			node_->size = size_;
+			node_->height = 1;
+			node_->block = block_;
+			node_->offset = offset_;
+			return node_;
+		}
+
+		// takes the references of both
+		static node* make_inner_(node* left_, node* right_) noexcept
+		{
+			assert(left_ && right_);
+			node* node_ = new node{};
+			node_->refs.store(1, std::memory_order_relaxed);
+			node_->size = left_->size + right_->size;
+			node_->height = 1 + (left_->height > right_->height ? left_->height : right_->height);
+			node_->left = left_;
+			node_->right = right_;
+			return node_;
+		}
+
+		// heights differ by 2 at the most, takes the references of both
+		static node* balance_(node* left_, node* right_) noexcept
+		{
+			if (height_(left_) > height_(right_) + 1)
+			{
+				node* result_ = nullptr;
+				if (height_(left_->left) >= height_(left_->right))
+				{
+					result_ = make_inner_(acquire_(left_->left),
+						make_inner_(acquire_(left_->right), right_));
+				}
+				else
+				{
+					node* middle_ = left_->right;
+					result_ = make_inner_(
+						make_inner_(acquire_(left_->left), acquire_(middle_->left)),
+						make_inner_(acquire_(middle_->right), right_));
+				}
+				release_(left_);
+				return result_;
+			}
+
+			if (height_(right_) > height_(left_) + 1)
+			{
+				node* result_ = nullptr;
+				if (height_(right_->right) >= height_(right_->left))
+				{
+					result_ = make_inner_(make_inner_(left_, acquire_(right_->left)),
+						acquire_(right_->right));
+				}
+				else
+				{
+					node* middle_ = right_->left;
+					result_ = make_inner_(
+						make_inner_(left_, acquire_(middle_->left)),
+						make_inner_(acquire_(middle_->right), acquire_(right_->right)));
+				}
+				release_(right_);
+				return result_;
+			}
+
+			return make_inner_(left_, right_);
+		}
+
+		// O(height difference), takes the references of both
+		static node* join_(node* left_, node* right_) noexcept
+		{
+			if (left_ == nullptr)
+				return right_;
+			if (right_ == nullptr)
+				return left_;
+
+			if (left_->height > right_->height + 1)
+			{
+				node* joined_ = join_(acquire_(left_->right), right_);
+				node* result_ = balance_(acquire_(left_->left), joined_);
+				release_(left_);
+				return result_;
+			}
+
+			if (right_->height > left_->height + 1)
+			{
+				node* joined_ = join_(left_, acquire_(right_->left));
+				node* result_ = balance_(joined_, acquire_(right_->right));
+				release_(right_);
+				return result_;
+			}
+
+			return make_inner_(left_, right_);
+		}
+
+		// chars from begin_ to end_ of the node, O(log n)
+		// borrows the node, the one returned is owned
+		static node* slice_(node* node_, size_t begin_, size_t end_) noexcept
+		{
+			assert(begin_ < end_ && end_ <= node_->size);
+			if (begin_ == 0 && end_ == node_->size)
+				return acquire_(node_);
+
+			if (node_->block)
+				return make_leaf_(acquire_(node_->block), node_->offset + begin_, end_ - begin_);
+
+			const size_t left_size_ = node_->left->size;
+			if (end_ <= left_size_)
+				return slice_(node_->left, begin_, end_);
+			if (begin_ >= left_size_)
+				return slice_(node_->right, begin_ - left_size_, end_ - left_size_);
+			return join_(slice_(node_->left, begin_, left_size_),
+				slice_(node_->right, 0, end_ - left_size_));
+		}
+
+		// nodes from this one to the last leaf are of this rope only
+		static bool unique_last_(const node* node_) noexcept
+		{
+			for (; node_; node_ = node_->right)
+				if (node_->refs.load(std::memory_order_acquire) != 1)
+					return false;
+			return true;
+		}
+
+		// the same tree with the last leaf replaced, the new path is made
+		// borrows the node, takes the reference of the leaf
+		static node* replace_last_(node* node_, node* leaf_) noexcept
+		{
+			if (node_->block)
+				return leaf_;
+			return make_inner_(acquire_(node_->left), replace_last_(node_->right, leaf_));
+		}
+
+		template<typename callback_type>
+		static bool pieces_(const node* node_, size_t pos_, callback_type& callback_)
+		{
+			if (node_->block)
+				return callback_(std::string_view(node_->block->chars() + node_->offset + pos_, node_->size - pos_));
+
+			if (pos_ < node_->left->size)
+			{
+				if (!pieces_(node_->left, pos_, callback_))
+					return false;
+				return pieces_(node_->right, 0, callback_);
+			}
+			return pieces_(node_->right, pos_ - node_->left->size, callback_);
+		}
+	}; // rope
+
+} // namespace dbj
+
+#ifdef DBJ_ROPE_TEST
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ a few ropes and a std::string each, random operations on both:
+ small and large appends, copies, concatenations and slices; the ropes
+ share the nodes, the chunks and the room at the chunk ends
+ after each, the rope is read by [], for_each_piece, flatten_into and
+ to_iovec, from random positions, and compared with its std::string
+ then the copies of one rope, appended to at once, on many threads
+*/
+namespace dbj_rope_test
+{
+	constexpr size_t rope_count = 8;
+	constexpr size_t operation_count = 20000;
+	constexpr size_t max_size = 1 << 16;
+	constexpr unsigned threads_count = 8;
+
+	inline std::string make_text(std::mt19937& random_, size_t size_)
+	{
+		std::string text_(size_, ' ');
+		for (char& char_ : text_)
+			char_ = char('a' + random_() % 26);
+		return text_;
+	}
+
+	inline bool same(dbj::rope const& rope_, std::string const& text_, std::mt19937& random_)
+	{
+		if (rope_.size() != text_.size() || rope_.empty() != text_.empty())
+			return false;
+
+		std::string flat_;
+		rope_.flatten_into(flat_);
+		if (flat_ != text_)
+			return false;
+
+		std::vector<char> terminated_(3, 'x');
+		rope_.flatten_into_terminated(terminated_);
+		if (terminated_.size() != text_.size() + 1 || terminated_.back() != 0 ||
+			std::string(terminated_.data()) != text_)
+			return false;
+
+		for (int k = 0; k < 8 && !text_.empty(); ++k)
+		{
+			const size_t index_ = random_() % text_.size();
+			if (rope_[index_] != text_[index_])
+				return false;
+		}
+
+		const size_t pos_ = text_.empty() ? 0 : random_() % (text_.size() + 1);
+		std::string pieces_;
+		rope_.for_each_piece([&](std::string_view piece_) {
+			pieces_.append(piece_);
+			return true;
+			}, pos_);
+		if (pieces_ != text_.substr(pos_))
+			return false;
+
+		// a few pieces at the time, as writev() takes them
+		std::string written_;
+		dbj::rope_iovec vec_[3];
+		for (size_t done_ = pos_; done_ < text_.size();)
+		{
+			const size_t count_ = rope_.to_iovec(vec_, 3, done_);
+			if (count_ == 0)
+				return false;
+			for (size_t k = 0; k < count_; ++k)
+			{
+				written_.append(static_cast<const char*>(vec_[k].iov_base), vec_[k].iov_len);
+				done_ += vec_[k].iov_len;
+			}
+		}
+		if (written_ != text_.substr(pos_) || rope_.to_iovec(vec_, 3, text_.size()) != 0)
+			return false;
+
+		// the first chars only
+		char small_[10];
+		const size_t copied_ = rope_.flatten_into(small_, sizeof(small_));
+		return copied_ == (text_.size() < sizeof(small_) ? text_.size() : sizeof(small_)) &&
+			memcmp(small_, text_.data(), copied_) == 0;
+	}
+
+	inline bool random_operations()
+	{
+		std::mt19937 random_(24);
+		std::vector<dbj::rope> ropes_(rope_count);
+		std::vector<std::string> texts_(rope_count);
+
+		for (size_t operation_ = 0; operation_ < operation_count; ++operation_)
+		{
+			const size_t i = random_() % rope_count, j = random_() % rope_count, k = random_() % rope_count;
+			const unsigned dice_ = random_() % 100;
+			if (dice_ < 40)
+			{
+				const std::string text_ = make_text(random_, random_() % 32);
+				ropes_[i].append(text_);
+				texts_[i] += text_;
+			}
+			else if (dice_ < 45)
+			{
+				const std::string text_ = make_text(random_, dbj::rope::chunk_size + random_() % (3 * dbj::rope::chunk_size));
+				ropes_[i] += text_;
+				texts_[i] += text_;
+			}
+			else if (dice_ < 60)
+			{
+				ropes_[i] = ropes_[j];
+				texts_[i] = texts_[j];
+			}
+			else if (dice_ < 72)
+			{
+				ropes_[i].append(ropes_[j]);
+				texts_[i] += texts_[j];
+			}
+			else if (dice_ < 80)
+			{
+				ropes_[i] = ropes_[j] + ropes_[k];
+				texts_[i] = texts_[j] + texts_[k];
+			}
+			else if (dice_ < 95)
+			{
+				const size_t pos_ = random_() % (texts_[j].size() + 1);
+				const size_t count_ = random_() % (texts_[j].size() + 8);
+				ropes_[i] = ropes_[j].substr(pos_, count_);
+				texts_[i] = texts_[j].substr(pos_, count_);
+			}
+			else
+			{
+				ropes_[i] = dbj::rope(texts_[j]);
+				texts_[i] = texts_[j];
+			}
+
+			if (texts_[i].size() > max_size)
+			{
+				ropes_[i] = ropes_[i].substr(texts_[i].size() - max_size / 2);
+				texts_[i] = texts_[i].substr(texts_[i].size() - max_size / 2);
+			}
+
+			if (!same(ropes_[i], texts_[i], random_))
+			{
+				printf("operation %zu, dice %u: the rope differs from the std::string\n", operation_, dice_);
+				return false;
+			}
+			// the ones sharing with it are not changed
+			if (!same(ropes_[j], texts_[j], random_))
+			{
+				printf("operation %zu, dice %u: the other rope has changed\n", operation_, dice_);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// the copies of one rope, each appended to; the first one claims the room of the last chunk
+	inline bool shared_tail()
+	{
+		const dbj::rope base_("shared tail");
+		dbj::rope first_ = base_, second_ = base_;
+		first_.append("+first");
+		second_.append("+second");
+		std::string flat_;
+		base_.flatten_into(flat_);
+		if (flat_ != "shared tail")
+			return false;
+		first_.flatten_into(flat_);
+		if (flat_ != "shared tail+first")
+			return false;
+		second_.flatten_into(flat_);
+		if (flat_ != "shared tail+second")
+			return false;
+
+		// all at once
+		std::vector<std::string> results_(threads_count);
+		std::vector<std::thread> threads_;
+		for (unsigned t = 0; t < threads_count; ++t)
+			threads_.emplace_back([&, t] {
+				dbj::rope mine_ = base_;
+				const std::string text_(1, char('A' + t));
+				for (int k = 0; k < 1000; ++k)
+					mine_.append(text_);
+				mine_.flatten_into(results_[t]);
+				});
+		for (std::thread& thread_ : threads_)
+			thread_.join();
+		for (unsigned t = 0; t < threads_count; ++t)
+			if (results_[t] != "shared tail" + std::string(1000, char('A' + t)))
+				return false;
+		base_.flatten_into(flat_);
+		return flat_ == "shared tail";
+	}
+} // namespace dbj_rope_test
+
+int main(void)
+{
+	using namespace dbj_rope_test;
+
+	if (!random_operations())
+		return EXIT_FAILURE;
+	if (!shared_tail())
+	{
+		printf("the appends to the shared tail are seen by the other ropes\n");
+		return EXIT_FAILURE;
+	}
+	printf("%zu random operations and the shared tail appends match std::string\n", operation_count);
+	return EXIT_SUCCESS;
+}
+
+#endif // DBJ_ROPE_TEST
+
+#endif // DBJ_ROPE_INC
@@ -28,6 +28,9 @@
  // demo and benchmarking
  // https://godbolt.org/z/PsKT19
 
+ // scaling from 100 to 1M strings, vs std::unordered_map, is the DBJ_USTRINGS_TEST block at the bottom
+ // g++ -std=c++17 -O2 -DNDEBUG -DDBJ_USTRINGS_TEST -x c++ dbj_ustrings.h
+
 #undef DBJ_NSPACE_BEGIN
 #define DBJ_NSPACE_BEGIN \
 	namespace dbj        \
@@ -37,6 +40,9 @@
 #define DBJ_NSPACE_END } /*dbj*/
 
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <string_view>
 #include <vector>
 #include <algorithm>
@@ -45,6 +51,24 @@
 #include <functional>
 #include <string_view>
 
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <span>
+#define DBJ_USTRINGS_SPAN 1
+#endif
+
+#ifdef DBJ_USTRINGS_PREFIX
+#include "dbj_ustrings_prefix.h"
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define DBJ_USTRINGS_PREFETCH(p_) _mm_prefetch((const char*)(p_), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define DBJ_USTRINGS_PREFETCH(p_) __builtin_prefetch(p_)
+#else
+#define DBJ_USTRINGS_PREFETCH(p_) (void)(p_)
+#endif
+
 #undef DBJ_FAST_FAIL
 #define DBJ_FAST_FAIL exit(EXIT_FAILURE)
 
@@ -181,6 +205,80 @@ namespace {
 	};
 }
 
+/*
+ hash of the ustrings pools, 8 chars at once, no branches but the length ones
+ std::hash of the MS STL is FNV-1a, one char at once
+
+ many() hashes several texts; the hash of one text depends on nothing else
+ thus the cpu works on the next ones while the previous are not done
+ NOTE: hashes do depend on the endianness
+*/
+struct ustrings_hash final
+{
+	size_t operator()(std::string_view text_) const noexcept
+	{
+		return size_t(finish_(start_(text_.size()), text_, 0));
+	}
+
+	static void many(const std::string_view* texts_, size_t count_, size_t* hashes_) noexcept
+	{
+		for (size_t k = 0; k < count_; ++k)
+			hashes_[k] = size_t(finish_(start_(texts_[k].size()), texts_[k], 0));
+	}
+
+private:
+	constexpr inline static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+	constexpr inline static uint64_t multiplier = 0xBF58476D1CE4E5B9ULL;
+	constexpr inline static uint64_t final_multiplier = 0x94D049BB133111EBULL;
+
+	static uint64_t start_(size_t size_) noexcept { return seed ^ (uint64_t(size_) * multiplier); }
+
+	static uint64_t mix_(uint64_t hash_, uint64_t word_) noexcept
+	{
+		hash_ = (hash_ ^ word_) * multiplier;
+		return hash_ ^ (hash_ >> 29);
+	}
+
+	static uint64_t word_(const char* chars_) noexcept
+	{
+		uint64_t word_{};
+		memcpy(&word_, chars_, sizeof(word_));
+		return word_;
+	}
+
+	static uint32_t half_(const char* chars_) noexcept
+	{
+		uint32_t half_{};
+		memcpy(&half_, chars_, sizeof(half_));
+		return half_;
+	}
+
+	// last size_ % 8 chars; in the loads that overlap, never past the end
+	// the size is in the seed thus that is not ambiguous
+	static uint64_t tail_(const char* chars_, size_t size_) noexcept
+	{
+		if (size_ >= 8)
+			return word_(chars_ + size_ - 8);
+		if (size_ >= 4)
+			return (uint64_t(half_(chars_)) << 32) | half_(chars_ + size_ - 4);
+		return (uint64_t(uint8_t(chars_[0])) << 16) | (uint64_t(uint8_t(chars_[size_ / 2])) << 8) | uint8_t(chars_[size_ - 1]);
+	}
+
+	// the rest from the done_ char
+	static uint64_t finish_(uint64_t hash_, std::string_view text_, size_t done_) noexcept
+	{
+		for (; done_ + 8 <= text_.size(); done_ += 8)
+			hash_ = mix_(hash_, word_(text_.data() + done_));
+
+		if (done_ < text_.size())
+			hash_ = mix_(hash_, tail_(text_.data(), text_.size()));
+
+		hash_ ^= hash_ >> 32;
+		hash_ *= final_multiplier;
+		return hash_ ^ (hash_ >> 29);
+	}
+}; // ustrings_hash
+
 // contains hash/string pair and method for making it
 struct hash_uniqptr_node final : no_copy_no_move
 {
@@ -202,7 +300,7 @@ struct hash_uniqptr_node final : no_copy_no_move
 
 	static pair make(const char* cp_, size_t hash_done_before_ = 0U) noexcept
 	{
-		static std::hash<std::string_view> hash_{};
+		static ustrings_hash hash_{};
 
 		assert(cp_);
 
@@ -215,15 +313,428 @@ struct hash_uniqptr_node final : no_copy_no_move
 
 		return  std::make_pair(hash_value_, std::move(str_ptr_));
 	}
+
+	// text_ does not have to be zero terminated
+	static pair make(std::string_view text_, size_t hash_done_before_ = 0U) noexcept
+	{
+		static ustrings_hash hash_{};
+
+		// we do not allow empty texts
+		assert(false == text_.empty());
+
+		string_ptr str_ptr_(new char[text_.size() + 1]);
+		memcpy(str_ptr_.get(), text_.data(), text_.size());
+		str_ptr_[text_.size()] = '\0';
+
+		size_t hash_value_ = (hash_done_before_ > 0
+			? hash_done_before_
+			: hash_(text_));
+
+		return  std::make_pair(hash_value_, std::move(str_ptr_));
+	}
+
+	// removed node is the empty pair, its view is empty with nullptr data
+	static std::string_view view(pair const& node_) noexcept
+	{
+		if (!node_.second)
+			return std::string_view();
+		return std::string_view(node_.second.get());
+	}
+
+	// per pool storage, nothing to keep here
+	// each string is its own allocation
+	struct storage final
+	{
+		pair make(const char* cp_, size_t hash_done_before_ = 0U) noexcept
+		{
+			return type::make(cp_, hash_done_before_);
+		}
+
+		pair make(std::string_view text_, size_t hash_done_before_ = 0U) noexcept
+		{
+			return type::make(text_, hash_done_before_);
+		}
+
+		void clear() noexcept {}
+	};
 }; // node
 
+/*
+ hash/string_view pair, the chars are in the large append only chunks
+ of the per pool storage; one allocation per chunk not per string
+
+ views are stable, chunks are never moved or reallocated
+ removed strings are not given back, all the chunks are freed at once on clear
+ and when the pool is destroyed; that is O(chunks)
+*/
+struct hash_arena_node final
+{
+	using pair = std::pair<size_t, std::string_view>;
+	using type = hash_arena_node;
+	using hash_type = size_t;
+	using string_type = std::string_view;
+
+	// not the no_copy_no_move base, that one is in the anonymous namespace
+	hash_arena_node(hash_arena_node const&) = delete;
+	hash_arena_node& operator=(hash_arena_node const&) = delete;
+	hash_arena_node(hash_arena_node&&) = delete;
+	hash_arena_node& operator=(hash_arena_node&&) = delete;
+
+	// chars, strings longer than this are given a chunk of their own
+	constexpr inline static size_t chunk_size = 0xFFFF;
+
+	static std::string_view view(pair const& node_) noexcept
+	{
+		return node_.second;
+	}
+
+	struct storage final
+	{
+		std::vector<std::unique_ptr<char[]>> chunks{};
+		char* next = nullptr;
+		size_t room = 0;
+
+		// zero terminated copy of the cp_ in the current chunk
+		pair make(const char* cp_, size_t hash_done_before_ = 0U) noexcept
+		{
+			assert(cp_);
+			return make(std::string_view(cp_, strnlen(cp_, dbj::strnlen_max_size)), hash_done_before_);
+		}
+
+		// text_ does not have to be zero terminated, the copy is
+		pair make(std::string_view text_, size_t hash_done_before_ = 0U) noexcept
+		{
+			static ustrings_hash hash_{};
+
+			// we do not allow empty texts
+			assert(false == text_.empty());
+
+			char* chars_ = allocate(text_.size() + 1);
+			memcpy(chars_, text_.data(), text_.size());
+			chars_[text_.size()] = '\0';
+
+			const std::string_view view_(chars_, text_.size());
+			// hash will be calculated if not done before
+			size_t hash_value_ = (hash_done_before_ > 0
+				? hash_done_before_
+				: hash_(view_));
+
+			return std::make_pair(hash_value_, view_);
+		}
+
+		void clear() noexcept
+		{
+			chunks.clear();
+			next = nullptr;
+			room = 0;
+		}
+
+	private:
+		char* allocate(size_t size_) noexcept
+		{
+			if (size_ > room)
+			{
+				// the big one does not spoil the room left in the current chunk
+				if (size_ > chunk_size)
+				{
+					chunks.emplace_back(new char[size_]);
+					return chunks.back().get();
+				}
+				chunks.emplace_back(new char[chunk_size]);
+				next = chunks.back().get();
+				room = chunk_size;
+			}
+			char* rezult_ = next;
+			next += size_;
+			room -= size_;
+			return rezult_;
+		}
+	};
+}; // arena node
+
+/*
+open addressing index of the ustrings nodes, "Swiss table" lite
+one control byte per slot: empty, deleted or the low 7 bits of the hash
+slot holds the position of the node; linear probing
+
+there is always at least one empty slot so the probing always ends
+*/
+struct ustrings_index final
+{
+	using position_type = uint32_t;
+
+	constexpr inline static size_t npos = size_t(-1);
+	constexpr inline static size_t min_capacity = 16;
+
+	constexpr inline static uint8_t empty_slot = 0x80;
+	constexpr inline static uint8_t deleted_slot = 0xFE;
+
+	std::vector<uint8_t> control;
+	std::vector<position_type> positions;
+	// full and deleted slots
+	size_t used = 0;
+	// full slots
+	size_t count = 0;
+	// where the next compact() starts
+	size_t sweep = 0;
+
+	static uint8_t tag(size_t hash_) noexcept { return uint8_t(hash_ & 0x7F); }
+
+	size_t home(size_t hash_) const noexcept { return (hash_ >> 7) & (control.size() - 1); }
+
+	void clear() noexcept
+	{
+		control.clear();
+		positions.clear();
+		used = count = sweep = 0;
+	}
+
+	// deleted slots
+	size_t tombstones() const noexcept { return used - count; }
+
+	// slot holding the position for which match_(position) is true, or npos
+	template <typename match_type>
+	size_t find(size_t hash_, match_type&& match_) const noexcept
+	{
+		size_t probes_ = 0;
+		return find(hash_, match_, probes_);
+	}
+
+	// probes_ is the number of slots looked at
+	template <typename match_type>
+	size_t find(size_t hash_, match_type&& match_, size_t& probes_) const noexcept
+	{
+		probes_ = 0;
+		if (control.empty())
+			return npos;
+
+		const size_t mask_ = control.size() - 1;
+		const uint8_t tag_ = tag(hash_);
+		for (size_t slot_ = home(hash_);; slot_ = (slot_ + 1) & mask_)
+		{
+			++probes_;
+			const uint8_t control_ = control[slot_];
+			if (control_ == empty_slot)
+				return npos;
+			if (control_ == tag_ && match_(positions[slot_]))
+				return slot_;
+		}
+	}
+
+	// first slot of the same tag, maybe of the same hash; or npos
+	size_t candidate(size_t hash_) const noexcept
+	{
+		if (control.empty())
+			return npos;
+
+		const size_t mask_ = control.size() - 1;
+		const uint8_t tag_ = tag(hash_);
+		for (size_t slot_ = home(hash_);; slot_ = (slot_ + 1) & mask_)
+		{
+			const uint8_t control_ = control[slot_];
+			if (control_ == empty_slot)
+				return npos;
+			if (control_ == tag_)
+				return slot_;
+		}
+	}
+
+	// hash_of_(position) gives the hash of the node at position, for rehashing
+	// the caller has made sure position is not already in
+	template <typename hash_of_type>
+	void insert(size_t hash_, position_type position_, hash_of_type&& hash_of_) noexcept
+	{
+		// max load is 7/8, deleted slots included
+		if ((used + 1) * 8 > control.size() * 7)
+			rehash(count + 1, hash_of_);
+
+		const size_t mask_ = control.size() - 1;
+		size_t slot_ = home(hash_);
+		while (control[slot_] != empty_slot && control[slot_] != deleted_slot)
+			slot_ = (slot_ + 1) & mask_;
+
+		used += control[slot_] == empty_slot;
+		control[slot_] = tag(hash_);
+		positions[slot_] = position_;
+		++count;
+	}
+
+	void erase(size_t slot_) noexcept
+	{
+		assert(slot_ < control.size() && control[slot_] != empty_slot && control[slot_] != deleted_slot);
+		const size_t mask_ = control.size() - 1;
+		// no probe sequence goes through it if the next one is empty
+		if (control[(slot_ + 1) & mask_] == empty_slot)
+		{
+			control[slot_] = empty_slot;
+			--used;
+		}
+		else
+		{
+			control[slot_] = deleted_slot;
+		}
+		--count;
+	}
+
+	/*
+	 removal of the deleted slots, in steps; one step looks at no more than
+	 budget_ slots, from where the previous one has stopped
+
+	 deleted slot is given the next one of its cluster that may be there,
+	 without the probing for it passing an empty slot; or it becomes empty
+	 if followed by the empty one. each move leaves the index as it should be,
+	 thus the step can stop anywhere
+
+	 return true if there are deleted slots left
+	*/
+	template <typename hash_of_type>
+	bool compact(size_t budget_, hash_of_type&& hash_of_) noexcept
+	{
+		if (control.empty())
+			return false;
+
+		const size_t mask_ = control.size() - 1;
+		while (budget_ > 0 && used > count)
+		{
+			size_t hole_ = sweep;
+			sweep = (sweep + 1) & mask_;
+			--budget_;
+			if (control[hole_] != deleted_slot)
+				continue;
+
+			for (size_t next_ = (hole_ + 1) & mask_; budget_ > 0; next_ = (next_ + 1) & mask_)
+			{
+				--budget_;
+				const uint8_t control_ = control[next_];
+				if (control_ == empty_slot)
+				{
+					// no probing passes the deleted slots just before the empty one
+					control[hole_] = empty_slot;
+					--used;
+					for (hole_ = (hole_ - 1) & mask_; budget_ > 0 && control[hole_] == deleted_slot; hole_ = (hole_ - 1) & mask_)
+					{
+						--budget_;
+						control[hole_] = empty_slot;
+						--used;
+					}
+					break;
+				}
+				if (control_ == deleted_slot)
+					continue;
+
+				// the hole is not before the home slot of the next one
+				const size_t home_ = home(hash_of_(positions[next_]));
+				if (((next_ - home_) & mask_) >= ((next_ - hole_) & mask_))
+				{
+					control[hole_] = control_;
+					positions[hole_] = positions[next_];
+					control[next_] = deleted_slot;
+					hole_ = next_;
+				}
+			}
+		}
+		return used > count;
+	}
+
+	// rebuild for at least count_ positions, deleted slots are gone
+	template <typename hash_of_type>
+	void rehash(size_t count_, hash_of_type&& hash_of_) noexcept
+	{
+		size_t capacity_ = min_capacity;
+		while (capacity_ * 7 < count_ * 8 * 2)
+			capacity_ *= 2;
+
+		std::vector<uint8_t> control_(capacity_, empty_slot);
+		std::vector<position_type> positions_(capacity_);
+		const size_t mask_ = capacity_ - 1;
+
+		for (size_t k = 0; k < control.size(); ++k)
+		{
+			if (control[k] == empty_slot || control[k] == deleted_slot)
+				continue;
+			size_t slot_ = (hash_of_(positions[k]) >> 7) & mask_;
+			while (control_[slot_] != empty_slot)
+				slot_ = (slot_ + 1) & mask_;
+			control_[slot_] = control[k];
+			positions_[slot_] = positions[k];
+		}
+
+		control.swap(control_);
+		positions.swap(positions_);
+		used = count;
+		sweep = 0;
+	}
+
+	// index of positions 0 .. count_ - 1
+	template <typename hash_of_type>
+	void rebuild(size_t count_, hash_of_type&& hash_of_) noexcept
+	{
+		clear();
+		rehash(count_, hash_of_);
+		for (size_t k = 0; k < count_; ++k)
+			insert(hash_of_(position_type(k)), position_type(k), hash_of_);
+	}
+}; // ustrings_index
+
+// fragmentation of the ustrings pool
+struct ustrings_stats final
+{
+	// strings in the pool
+	size_t live;
+	// ids of the removed strings, waiting to be used again
+	size_t free_ids;
+	// deleted index slots, waiting to be compacted
+	size_t tombstones;
+	size_t index_capacity;
+
+	// of the used index slots, 0 .. 1
+	double tombstone_ratio() const noexcept
+	{
+		return (live + tombstones) == 0 ? 0.0 : double(tombstones) / double(live + tombstones);
+	}
+};
+
+#ifdef DBJ_USTRINGS_STATS
+// counters of the ustrings pool
+// to be sized and tuned from the real data, the min/max capacity included
+struct ustrings_counters final
+{
+	constexpr inline static size_t probe_buckets = 8;
+
+	size_t hits;
+	size_t misses;
+	size_t removes;
+	// index slots looked at by the assign: 1, 2, 3, 4, 5-8, 9-16, 17-32, 33 and more
+	size_t probes[probe_buckets];
+	// chars of the strings in the pool, zero terminators included
+	size_t char_bytes;
+	// capacity of nodes, index and free ids
+	size_t node_bytes;
+	size_t size;
+	size_t peak_size;
+
+	static size_t probe_bucket(size_t probes_) noexcept
+	{
+		if (probes_ <= 4)
+			return probes_ == 0 ? 0 : probes_ - 1;
+		size_t bucket_ = 2;
+		for (size_t p = probes_ - 1; p > 1; p >>= 1)
+			++bucket_;
+		return bucket_ < probe_buckets ? bucket_ : probe_buckets - 1;
+	}
+};
+#endif // DBJ_USTRINGS_STATS
+
 // A storage of unique strings. as vector of nodes
+// with the open addressing index of them
+// position of the node is the 32 bit id of the string, removed nodes are left empty
+// and their ids are given to the next strings assigned
 template<typename node_type_arg>
 struct ustrings final
 {
 	// note these are not per instance
-	// and are highly speculative
-	constexpr inline static size_t max_capacity = 0xFFFF;
+	// ids are 32 bit, npos is not one of them
+	constexpr inline static size_t max_capacity = size_t(ustrings_index::position_type(-1)) - 1;
 
 	// we start from min capacity
 	// meaning we have pre allocated the min_capacity
@@ -237,6 +748,30 @@ struct ustrings final
 	// note: this is per instance
 	value_type strings{ min_capacity };
 
+	// positions in strings, by hash
+	ustrings_index index{};
+
+	// where the node_type keeps the chars
+	typename node_type::storage store{};
+
+	// ids of the removed nodes
+	std::vector<ustrings_index::position_type> free_ids{};
+
+	// index is compacted when more than 1/compact_ratio of its slots are deleted
+	constexpr inline static size_t compact_ratio = 16;
+	// that is done in steps, one per assign or remove, each looks at no more than this many slots
+	constexpr inline static size_t compact_step = 32;
+
+#ifdef DBJ_USTRINGS_STATS
+	// just counters, per instance as the pool is
+	ustrings_counters counted{};
+#endif
+
+#ifdef DBJ_USTRINGS_PREFIX
+	// the same strings in the lexical order
+	ustrings_prefix_index prefixes{};
+#endif
+
 	ustrings() noexcept : strings()
 	{
 		assert(strings.size() == 0);
@@ -252,61 +787,216 @@ struct ustrings final
 
 	~ustrings() noexcept { strings.clear(); }
 
-	void clear() noexcept { strings.clear(); }
+	void clear() noexcept
+	{
+		strings.clear(); index.clear(); store.clear(); free_ids.clear();
+#ifdef DBJ_USTRINGS_STATS
+		counted.char_bytes = 0;
+#endif
+#ifdef DBJ_USTRINGS_PREFIX
+		prefixes.clear();
+#endif
+	}
 
 	// yes. having methods as friend functions speeds things up; somewhat.
 
+	// dense symbol id, the position in strings
+	using id_type = ustrings_index::position_type;
+	constexpr inline static id_type npos = id_type(-1);
+
+	// texts assigned by one assign_many step
+	constexpr inline static size_t batch_size = 16;
+
 	// assign if not found
-	// return size_t hash
-	static size_t assign(type& usstore_, const char* text) noexcept
+	// return the id of the text
+	// on average O(1), the text is compared when the hash is found
+	static id_type assign(type& usstore_, const char* text) noexcept
 	{
-		static dbj::string_ptr null_;
-
 		assert(text);
 
-		static std::hash< std::string_view > hash_;
-		auto next_hash_ = hash_(text);
+		static ustrings_hash hash_;
+		const std::string_view text_(text);
+		return assign_(usstore_, text_, hash_(text_));
+	}
+
+	/*
+	 assign each of the texts, ids[k] is the id of the texts[k]
+	 in steps of batch_size texts: hashed together, their index slots are
+	 prefetched, then the nodes they point to, and then they are assigned
+	 one by one; memory is thus read in parallel for all of them
+
+	 texts do not have to be zero terminated
+	*/
+	static void assign_many(type& usstore_, const std::string_view* texts, size_t count, id_type* ids) noexcept
+	{
+		assert(texts || count == 0);
+		assert(ids || count == 0);
 
-		for (auto&& hs_pair_ : usstore_.strings)
+		size_t hashes_[batch_size];
+		for (size_t done_ = 0; done_ < count; done_ += batch_size)
 		{
-			assert(hs_pair_.first > 0);
+			const size_t size_ = std::min(batch_size, count - done_);
+			ustrings_hash::many(texts + done_, size_, hashes_);
 
-			if (next_hash_ == hs_pair_.first)
+			if (!usstore_.index.control.empty())
 			{
-				return hs_pair_.first;
+				for (size_t k = 0; k < size_; ++k)
+				{
+					const size_t home_ = usstore_.index.home(hashes_[k]);
+					DBJ_USTRINGS_PREFETCH(usstore_.index.control.data() + home_);
+					DBJ_USTRINGS_PREFETCH(usstore_.index.positions.data() + home_);
+				}
+
+				for (size_t k = 0; k < size_; ++k)
+				{
+					const size_t slot_ = usstore_.index.candidate(hashes_[k]);
+					if (slot_ != ustrings_index::npos)
+						DBJ_USTRINGS_PREFETCH(usstore_.strings.data() + usstore_.index.positions[slot_]);
+				}
 			}
+
+			for (size_t k = 0; k < size_; ++k)
+				ids[done_ + k] = assign_(usstore_, texts[done_ + k], hashes_[k]);
 		}
+	}
+
+#ifdef DBJ_USTRINGS_SPAN
+	// ids must not be smaller than texts
+	static void assign_many(type& usstore_, std::span<const std::string_view> texts, std::span<id_type> ids) noexcept
+	{
+		assert(ids.size() >= texts.size());
+		assign_many(usstore_, texts.data(), texts.size(), ids.data());
+	}
+#endif // DBJ_USTRINGS_SPAN
+
+	// id of the text or npos if not found
+	static id_type find(type const& usstore_, const char* text) noexcept
+	{
+		assert(text);
+
+		static ustrings_hash hash_;
+		const std::string_view text_(text);
+		const size_t slot_ = find_(usstore_, hash_(text_), text_);
+		if (slot_ == ustrings_index::npos)
+			return npos;
+		return usstore_.index.positions[slot_];
+	}
+
+	// the stored text or nullptr if not found
+	static const char* lookup(type const& usstore_, const char* text) noexcept
+	{
+		const id_type id_ = find(usstore_, text);
+		if (id_ == npos)
+			return nullptr;
+		return node_type::view(usstore_.strings[id_]).data();
+	}
+
+	// O(1), empty view with nullptr data for the removed id
+	static std::string_view view(type const& usstore_, id_type id_) noexcept
+	{
+		assert(id_ < usstore_.strings.size());
+		return node_type::view(usstore_.strings[id_]);
+	}
+
+	static size_t hash(type const& usstore_, id_type id_) noexcept
+	{
+		assert(id_ < usstore_.strings.size());
+		return usstore_.strings[id_].first;
+	}
+
+	// number of strings in the pool, ids of the removed ones excluded
+	static size_t count(type const& usstore_) noexcept
+	{
+		return usstore_.index.count;
+	}
 
-		usstore_.strings.push_back(node_type::make(text, next_hash_));
+	static ustrings_stats stats(type const& usstore_) noexcept
+	{
+		return ustrings_stats{ usstore_.index.count, usstore_.free_ids.size(),
+			usstore_.index.tombstones(), usstore_.index.control.size() };
+	}
+
+#ifdef DBJ_USTRINGS_STATS
+	static ustrings_counters counters(type const& usstore_) noexcept
+	{
+		ustrings_counters counters_ = usstore_.counted;
+		counters_.node_bytes = usstore_.strings.capacity() * sizeof(typename node_type::pair)
+			+ usstore_.index.control.capacity() * sizeof(uint8_t)
+			+ usstore_.index.positions.capacity() * sizeof(ustrings_index::position_type)
+			+ usstore_.free_ids.capacity() * sizeof(id_type);
+		counters_.size = usstore_.index.count;
+		return counters_;
+	}
 
-		// for the time being we will check the upper limit breach
-		// only in debug builds
-		assert(usstore_.strings.size() <= max_capacity);
+	// all but the ones of the strings in the pool
+	static void reset_counters(type& usstore_) noexcept
+	{
+		const size_t char_bytes_ = usstore_.counted.char_bytes;
+		usstore_.counted = ustrings_counters{};
+		usstore_.counted.char_bytes = char_bytes_;
+		usstore_.counted.peak_size = usstore_.index.count;
+	}
+#endif // DBJ_USTRINGS_STATS
+
+#ifdef DBJ_USTRINGS_PREFIX
+	// callback(id, text) for each string starting with the prefix, in the lexical order
+	// callback returns false to stop
+	// O(prefix size) to the first one
+	template<typename callback_type>
+	static void for_each_prefixed(type const& usstore_, std::string_view prefix, callback_type&& callback)
+	{
+		usstore_.prefixes.for_each(prefix, [&](std::string_view text_, id_type id_) {
+			return callback(id_, text_);
+			});
+	}
 
-		return next_hash_;
+	// id of the longest string the text starts with, npos if none
+	// O(text size)
+	static id_type longest_prefix(type const& usstore_, std::string_view text) noexcept
+	{
+		return usstore_.prefixes.longest_prefix(text);
 	}
+#endif // DBJ_USTRINGS_PREFIX
 
-	// remove if hash found and return true
+	// remove if id found and return true
 	// otherwise return false
-	static bool remove(type& usstore_, size_t needle_) noexcept
+	// the node is left empty, ids of the others do not change
+	// NOTE: the id will be given to some string assigned later
+	static bool remove(type& usstore_, id_type id_) noexcept
 	{
-		// this is fast and works on vectors
-		auto index_ = 0U;
-		const auto begin_ = usstore_.strings.begin();
-		for (auto&& hs_pair_ : usstore_.strings)
-		{
-			if (needle_ == hs_pair_.first)
-			{
-				usstore_.strings.erase(begin_ + index_);
-				return true;
-			}
-			index_ += 1;
-		}
-		return false;
+		if (id_ >= usstore_.strings.size() || node_type::view(usstore_.strings[id_]).data() == nullptr)
+			return false;
+
+		const size_t slot_ = usstore_.index.find(usstore_.strings[id_].first,
+			[&](ustrings_index::position_type position_) { return position_ == id_; });
+		assert(slot_ != ustrings_index::npos);
+
+		usstore_.index.erase(slot_);
+#ifdef DBJ_USTRINGS_STATS
+		usstore_.counted.removes += 1;
+		usstore_.counted.char_bytes -= node_type::view(usstore_.strings[id_]).size() + 1;
+#endif
+#ifdef DBJ_USTRINGS_PREFIX
+		usstore_.prefixes.erase(node_type::view(usstore_.strings[id_]));
+#endif
+		usstore_.strings[id_] = typename node_type::pair{};
+		usstore_.free_ids.push_back(id_);
+		compact_(usstore_);
+		return true;
 	}
 
+	// drops the removed nodes and sorts
+	// NOTE: ids are changed
 	static void sort_by_hash(type& usstore_) noexcept
 	{
+		usstore_.free_ids.clear();
+		usstore_.strings.erase(
+			std::remove_if(usstore_.strings.begin(), usstore_.strings.end(),
+				[](typename node_type::pair const& node_) noexcept {
+					return node_type::view(node_).data() == nullptr;
+				}),
+			usstore_.strings.end());
+
 		std::sort(usstore_.strings.begin(), usstore_.strings.end(),
 			[](
 				typename node_type::pair const& left_,
@@ -314,12 +1004,94 @@ struct ustrings final
 			{
 				return left_.first < right_.first;
 			});
+		// positions have changed
+		usstore_.index.rebuild(usstore_.strings.size(), hash_of_(usstore_));
+#ifdef DBJ_USTRINGS_PREFIX
+		usstore_.prefixes.clear();
+		for (size_t k = 0; k < usstore_.strings.size(); ++k)
+			usstore_.prefixes.insert(node_type::view(usstore_.strings[k]), id_type(k));
+#endif
+	}
+
+private:
+	static auto hash_of_(type const& usstore_) noexcept
+	{
+		return [&usstore_](ustrings_index::position_type position_) noexcept {
+			return usstore_.strings[position_].first;
+		};
+	}
+
+	static id_type assign_(type& usstore_, std::string_view text_, size_t hash_) noexcept
+	{
+		size_t probes_ = 0;
+		const size_t slot_ = find_(usstore_, hash_, text_, probes_);
+#ifdef DBJ_USTRINGS_STATS
+		usstore_.counted.probes[ustrings_counters::probe_bucket(probes_)] += 1;
+		if (slot_ != ustrings_index::npos)
+			usstore_.counted.hits += 1;
+		else
+			usstore_.counted.misses += 1;
+#endif
+		if (slot_ != ustrings_index::npos)
+			return usstore_.index.positions[slot_];
+
+		id_type id_{};
+		if (usstore_.free_ids.empty())
+		{
+			// out of ids, in release builds too
+			if (usstore_.strings.size() >= max_capacity)
+			{
+				assert(false && "ustrings: no more ids");
+				DBJ_FAST_FAIL;
+			}
+			id_ = id_type(usstore_.strings.size());
+			usstore_.strings.push_back(usstore_.store.make(text_, hash_));
+		}
+		else
+		{
+			id_ = usstore_.free_ids.back();
+			usstore_.free_ids.pop_back();
+			usstore_.strings[id_] = usstore_.store.make(text_, hash_);
+		}
+		usstore_.index.insert(hash_, id_, hash_of_(usstore_));
+		compact_(usstore_);
+#ifdef DBJ_USTRINGS_PREFIX
+		usstore_.prefixes.insert(node_type::view(usstore_.strings[id_]), id_);
+#endif
+#ifdef DBJ_USTRINGS_STATS
+		usstore_.counted.char_bytes += text_.size() + 1;
+		usstore_.counted.peak_size = std::max(usstore_.counted.peak_size, usstore_.index.count);
+#endif
+
+		return id_;
+	}
+
+	static void compact_(type& usstore_) noexcept
+	{
+		if (usstore_.index.tombstones() * compact_ratio > usstore_.index.control.size())
+			usstore_.index.compact(compact_step, hash_of_(usstore_));
+	}
+
+	// index slot of the node with the same hash and the same text
+	static size_t find_(type const& usstore_, size_t hash_, std::string_view text_) noexcept
+	{
+		size_t probes_ = 0;
+		return find_(usstore_, hash_, text_, probes_);
+	}
+
+	static size_t find_(type const& usstore_, size_t hash_, std::string_view text_, size_t& probes_) noexcept
+	{
+		return usstore_.index.find(hash_, [&](ustrings_index::position_type position_) {
+			auto const& node_ = usstore_.strings[position_];
+			return node_.first == hash_ && node_type::view(node_) == text_;
+			}, probes_);
 	}
 
 }; // ustrings
 
 
 using ustring_pool_using_uniq_ptr = ustrings<hash_uniqptr_node>;
+using ustring_pool_using_arena = ustrings<hash_arena_node>;
 
 DBJ_NSPACE_END
 
@@ -327,6 +1099,123 @@ DBJ_NSPACE_END
 #undef DBJ_NSPACE_BEGIN
 #undef DBJ_NSPACE_END
 #undef DBJ_IS_EMPTY
+#undef DBJ_USTRINGS_PREFETCH
+
+#ifdef DBJ_USTRINGS_TEST
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+/*
+ N distinct keys of 8 to 32 chars, N from 100 to 1M
+ per call: assign of the new ones, assign of the ones in, remove of all
+ the pool of each node type and std::unordered_map<std::string, id>
+*/
+namespace dbj_ustrings_test {
+
+	using id_type = dbj::ustring_pool_using_arena::id_type;
+
+	inline volatile size_t sink_ = 0;
+
+	inline std::vector<std::string> make_keys(size_t count_)
+	{
+		std::mt19937_64 random_(count_);
+		std::vector<std::string> keys_(count_);
+		for (size_t k = 0; k < count_; ++k)
+		{
+			keys_[k] = "key_" + std::to_string(k) + "_";
+			const size_t size_ = 8 + random_() % 25;
+			while (keys_[k].size() < size_)
+				keys_[k] += char('a' + random_() % 26);
+		}
+		std::shuffle(keys_.begin(), keys_.end(), random_);
+		return keys_;
+	}
+
+	struct timing final
+	{
+		double insert, hit, remove;
+	};
+
+	// ns per call
+	template <typename F>
+	double per_call(size_t count_, F work_)
+	{
+		const auto start_ = std::chrono::steady_clock::now();
+		work_();
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count() / double(count_);
+	}
+
+	template <typename pool_type>
+	timing measure_pool(std::vector<std::string> const& keys_)
+	{
+		pool_type pool_;
+		std::vector<id_type> ids_(keys_.size());
+		timing rez_{};
+		rez_.insert = per_call(keys_.size(), [&] {
+			for (size_t k = 0; k < keys_.size(); ++k)
+				ids_[k] = pool_type::assign(pool_, keys_[k].c_str());
+			});
+		if (pool_type::count(pool_) != keys_.size())
+		{
+			printf("%zu keys, %zu in the pool\n", keys_.size(), pool_type::count(pool_));
+			exit(EXIT_FAILURE);
+		}
+		rez_.hit = per_call(keys_.size(), [&] {
+			for (size_t k = 0; k < keys_.size(); ++k)
+				sink_ = sink_ + (pool_type::assign(pool_, keys_[k].c_str()) == ids_[k]);
+			});
+		rez_.remove = per_call(keys_.size(), [&] {
+			for (size_t k = 0; k < keys_.size(); ++k)
+				sink_ = sink_ + pool_type::remove(pool_, ids_[k]);
+			});
+		return rez_;
+	}
+
+	inline timing measure_map(std::vector<std::string> const& keys_)
+	{
+		std::unordered_map<std::string, id_type> map_;
+		timing rez_{};
+		rez_.insert = per_call(keys_.size(), [&] {
+			for (size_t k = 0; k < keys_.size(); ++k)
+				map_.try_emplace(keys_[k], id_type(map_.size()));
+			});
+		rez_.hit = per_call(keys_.size(), [&] {
+			for (size_t k = 0; k < keys_.size(); ++k)
+				sink_ = sink_ + map_.try_emplace(keys_[k], id_type(map_.size())).first->second;
+			});
+		rez_.remove = per_call(keys_.size(), [&] {
+			for (size_t k = 0; k < keys_.size(); ++k)
+				sink_ = sink_ + map_.erase(keys_[k]);
+			});
+		return rez_;
+	}
+
+	inline void report(const char* prompt_, timing const& timing_)
+	{
+		printf("  %-22s insert %7.1f ns, hit %7.1f ns, remove %7.1f ns\n", prompt_, timing_.insert, timing_.hit, timing_.remove);
+	}
+} // dbj_ustrings_test
+
+int main(void)
+{
+	using namespace dbj_ustrings_test;
+
+	for (size_t count_ : { size_t(100), size_t(1000), size_t(10000), size_t(100000), size_t(1000000) })
+	{
+		const std::vector<std::string> keys_ = make_keys(count_);
+		printf("%zu strings\n", count_);
+		report("ustrings, arena", measure_pool<dbj::ustring_pool_using_arena>(keys_));
+		report("ustrings, unique_ptr", measure_pool<dbj::ustring_pool_using_uniq_ptr>(keys_));
+		report("std::unordered_map", measure_map(keys_));
+	}
+	return 0;
+}
+
+#endif // DBJ_USTRINGS_TEST
 
 #endif // DBJ_USTRINGS_INC
 
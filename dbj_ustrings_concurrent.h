@@ -0,0 +1,330 @@
+#ifndef DBJ_USTRINGS_CONCURRENT_INC
+#define DBJ_USTRINGS_CONCURRENT_INC
+
+/*
+ (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+ Interning pool for many threads. dbj::ustrings is not synchronized, one
+ lock around it serializes all the threads; this one is split into shards
+ by hash, each shard has its own lock, index and chars.
+
+ - finding the string already in the pool does not lock
+ - inserting locks only the shard of the string
+ - each shard is on its own cache lines
+
+ Interned strings are never removed, they all go away with the pool.
+ Returned string views are stable, and the same text is always the same
+ view data pointer; thus comparing the pointers is comparing the texts.
+
+	static dbj::ustrings_concurrent<> pool_;
+	// from any thread
+	std::string_view name_ = dbj::ustrings_concurrent<>::assign(pool_, "name");
+
+ Throughput from 1 to 32 threads vs one lock around dbj::ustrings is the
+ DBJ_USTRINGS_CONCURRENT_TEST block at the bottom
+
+	g++ -std=c++17 -O2 -pthread -DDBJ_USTRINGS_CONCURRENT_TEST -x c++ dbj_ustrings_concurrent.h
+*/
+
+#include "dbj_ustrings.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace dbj
+{
+	// shard_count must be a power of 2
+	template<size_t shard_count = 64>
+	struct ustrings_concurrent final
+	{
+		static_assert(shard_count > 0 && (shard_count & (shard_count - 1)) == 0,
+			"shard_count must be a power of 2");
+
+		constexpr inline static size_t cache_line = 64;
+		constexpr inline static size_t min_capacity = 64;
+
+		using type = ustrings_concurrent;
+
+		ustrings_concurrent() noexcept = default;
+
+		// ustrings_concurrent objects can be neither copied nor moved
+		ustrings_concurrent(const ustrings_concurrent&) = delete;
+		ustrings_concurrent& operator=(const ustrings_concurrent&) = delete;
+		ustrings_concurrent(ustrings_concurrent&&) = delete;
+		ustrings_concurrent& operator=(ustrings_concurrent&&) = delete;
+
+		// assign if not found, from any thread
+		// return the interned text
+		static std::string_view assign(type& pool_, const char* text) noexcept
+		{
+			assert(text);
+
+			static ustrings_hash hash_;
+			const std::string_view text_(text);
+			const size_t hash_value_ = hash_(text_);
+			shard& shard_ = pool_.shards[hash_value_ & (shard_count - 1)];
+
+			// no lock if found
+			if (const entry* found_ = find_(shard_.current.load(std::memory_order_acquire), hash_value_, text_))
+				return found_->text;
+
+			std::lock_guard<std::mutex> lock_(shard_.lock);
+
+			// someone might have been faster
+			table* table_ = shard_.current.load(std::memory_order_relaxed);
+			if (const entry* found_ = find_(table_, hash_value_, text_))
+				return found_->text;
+
+			const size_t count_ = shard_.count.load(std::memory_order_relaxed);
+			if (table_ == nullptr || (count_ + 1) * 8 > (table_->mask + 1) * 7)
+				table_ = grow_(shard_, count_ + 1);
+
+			// all of the text, as hashed
+			auto node_ = shard_.chars.make(text_, hash_value_);
+			shard_.entries.push_back(entry{ node_.first, node_.second });
+			const entry* entry_ = &shard_.entries.back();
+
+			publish_(*table_, entry_);
+			shard_.count.store(count_ + 1, std::memory_order_relaxed);
+
+			return entry_->text;
+		}
+
+		// the interned text, empty view with nullptr data if not found
+		static std::string_view find(type const& pool_, const char* text) noexcept
+		{
+			assert(text);
+
+			static ustrings_hash hash_;
+			const std::string_view text_(text);
+			const size_t hash_value_ = hash_(text_);
+			shard const& shard_ = pool_.shards[hash_value_ & (shard_count - 1)];
+
+			if (const entry* found_ = find_(shard_.current.load(std::memory_order_acquire), hash_value_, text_))
+				return found_->text;
+			return std::string_view();
+		}
+
+		// might be behind the inserts in progress
+		static size_t count(type const& pool_) noexcept
+		{
+			size_t count_ = 0;
+			for (shard const& shard_ : pool_.shards)
+				count_ += shard_.count.load(std::memory_order_relaxed);
+			return count_;
+		}
+
+	private:
+		struct entry final
+		{
+			size_t hash;
+			std::string_view text;
+		};
+
+		// open addressing, linear probing
+		// one byte per slot, 0 is empty, else a few bits of the hash
+		// thus probing does not touch the entries of the other strings
+		struct table final
+		{
+			size_t mask;
+			std::unique_ptr<std::atomic<uint8_t>[]> tags;
+			std::unique_ptr<const entry* []> slots;
+		};
+
+		static uint8_t tag_(size_t hash_) noexcept
+		{
+			return uint8_t((hash_ >> (sizeof(size_t) * 8 - 8)) | 1);
+		}
+
+		// entry is complete and in its slot before the readers can see the tag
+		static void publish_(table& table_, const entry* entry_) noexcept
+		{
+			size_t slot_ = (entry_->hash / shard_count) & table_.mask;
+			while (table_.tags[slot_].load(std::memory_order_relaxed) != 0)
+				slot_ = (slot_ + 1) & table_.mask;
+			table_.slots[slot_] = entry_;
+			table_.tags[slot_].store(tag_(entry_->hash), std::memory_order_release);
+		}
+
+		struct alignas(cache_line) shard final
+		{
+			std::atomic<table*> current{ nullptr };
+			std::atomic<size_t> count{ 0 };
+			std::mutex lock{};
+			// chars of the strings, views are stable
+			hash_arena_node::storage chars{};
+			// push_back on deque does not move the elements
+			std::deque<entry> entries{};
+			// the current one and the ones the readers might still be using
+			std::vector<std::unique_ptr<table>> tables{};
+		};
+
+		shard shards[shard_count]{};
+
+		static const entry* find_(const table* table_, size_t hash_, std::string_view text_) noexcept
+		{
+			if (table_ == nullptr)
+				return nullptr;
+
+			const uint8_t want_ = tag_(hash_);
+			for (size_t slot_ = (hash_ / shard_count) & table_->mask;; slot_ = (slot_ + 1) & table_->mask)
+			{
+				const uint8_t tag_ = table_->tags[slot_].load(std::memory_order_acquire);
+				if (tag_ == 0)
+					return nullptr;
+				if (tag_ != want_)
+					continue;
+				const entry* entry_ = table_->slots[slot_];
+				if (entry_->hash == hash_ && entry_->text == text_)
+					return entry_;
+			}
+		}
+
+		// under the shard lock
+		// new table for at least count_ entries is published,
+		// old tables are kept until the pool is gone
+		static table* grow_(shard& shard_, size_t count_) noexcept
+		{
+			size_t capacity_ = min_capacity;
+			while (capacity_ * 7 < count_ * 8 * 2)
+				capacity_ *= 2;
+
+			auto table_ = std::make_unique<table>();
+			table_->mask = capacity_ - 1;
+			table_->tags.reset(new std::atomic<uint8_t>[capacity_]());
+			table_->slots.reset(new const entry* [capacity_]());
+
+			// not seen by the readers yet
+			for (entry const& entry_ : shard_.entries)
+				publish_(*table_, &entry_);
+
+			table* published_ = table_.get();
+			shard_.tables.push_back(std::move(table_));
+			shard_.current.store(published_, std::memory_order_release);
+			return published_;
+		}
+	}; // ustrings_concurrent
+
+} // namespace dbj
+
+#ifdef DBJ_USTRINGS_CONCURRENT_TEST
+
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <thread>
+
+/*
+ 50k identifiers, each thread goes through all of them from its own
+ offset, in its own order; the first ones to come are inserts, most are hits
+ then the hits only, into the full pools
+ the sharded pool vs one std::mutex around ustring_pool_using_arena
+*/
+namespace dbj_ustrings_concurrent_test {
+
+	using sharded_pool = dbj::ustrings_concurrent<>;
+	using locked_pool = dbj::ustring_pool_using_arena;
+
+	constexpr size_t key_count = 50000;
+	constexpr size_t operation_count = 800000;
+
+	inline std::vector<std::string> make_keys()
+	{
+		std::vector<std::string> keys_(key_count);
+		for (size_t k = 0; k < key_count; ++k)
+			keys_[k] = "identifier_" + std::to_string(k * 2654435761u);
+		return keys_;
+	}
+
+	// operation_count in total, on threads_count threads; Mops/s
+	template <typename F>
+	double run(std::vector<std::string> const& keys_, unsigned threads_count_, F&& intern_)
+	{
+		std::vector<std::thread> threads_;
+		const size_t per_thread_ = operation_count / threads_count_;
+		const auto start_ = std::chrono::steady_clock::now();
+		for (unsigned t = 0; t < threads_count_; ++t)
+			threads_.emplace_back([&, t] {
+				for (size_t k = 0; k < per_thread_; ++k)
+					intern_(keys_[(k * 2654435761u + t * 7919) % keys_.size()].c_str());
+				});
+		for (std::thread& thread_ : threads_)
+			thread_.join();
+		const double took_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+		return double(per_thread_ * threads_count_) / took_ / 1e6;
+	}
+
+	// the same text is the same pointer, from any thread
+	inline bool check(std::vector<std::string> const& keys_)
+	{
+		auto pool_ = std::make_unique<sharded_pool>();
+		constexpr unsigned threads_count_ = 8;
+		std::vector<std::vector<const char*>> seen_(threads_count_, std::vector<const char*>(keys_.size()));
+		std::vector<std::thread> threads_;
+		for (unsigned t = 0; t < threads_count_; ++t)
+			threads_.emplace_back([&, t] {
+				for (size_t k = 0; k < keys_.size(); ++k)
+				{
+					const size_t key_ = (k + t * 977) % keys_.size();
+					const std::string_view text_ = sharded_pool::assign(*pool_, keys_[key_].c_str());
+					seen_[t][key_] = text_ == keys_[key_] ? text_.data() : nullptr;
+				}
+				});
+		for (std::thread& thread_ : threads_)
+			thread_.join();
+		for (unsigned t = 0; t < threads_count_; ++t)
+			if (seen_[t] != seen_[0] || std::count(seen_[t].begin(), seen_[t].end(), nullptr) != 0)
+				return false;
+
+		// longer than the chunks of the chars
+		const std::string long_(70000, 'x');
+		const std::string_view first_ = sharded_pool::assign(*pool_, long_.c_str());
+		const std::string_view second_ = sharded_pool::assign(*pool_, long_.c_str());
+		return first_ == long_ && first_.data() == second_.data() &&
+			sharded_pool::count(*pool_) == keys_.size() + 1 &&
+			sharded_pool::find(*pool_, "not in").data() == nullptr;
+	}
+} // dbj_ustrings_concurrent_test
+
+int main(void)
+{
+	using namespace dbj_ustrings_concurrent_test;
+
+	const std::vector<std::string> keys_ = make_keys();
+	if (!check(keys_))
+	{
+		printf("the same text is not the same view\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%u hardware threads, %zu keys, %zu operations\n",
+		std::thread::hardware_concurrency(), key_count, operation_count);
+	for (unsigned threads_count_ : { 1u, 2u, 4u, 8u, 16u, 32u })
+	{
+		auto sharded_ = std::make_unique<sharded_pool>();
+		locked_pool locked_;
+		std::mutex lock_;
+		const double locked_mixed_ = run(keys_, threads_count_, [&](const char* text_) {
+			std::lock_guard<std::mutex> guard_(lock_);
+			locked_pool::assign(locked_, text_);
+			});
+		const double sharded_mixed_ = run(keys_, threads_count_, [&](const char* text_) {
+			sharded_pool::assign(*sharded_, text_);
+			});
+		const double locked_hits_ = run(keys_, threads_count_, [&](const char* text_) {
+			std::lock_guard<std::mutex> guard_(lock_);
+			locked_pool::assign(locked_, text_);
+			});
+		const double sharded_hits_ = run(keys_, threads_count_, [&](const char* text_) {
+			sharded_pool::assign(*sharded_, text_);
+			});
+		printf("%2u threads, Mops/s  inserts and hits: one lock %6.2f, sharded %6.2f   hits: one lock %6.2f, sharded %6.2f\n",
+			threads_count_, locked_mixed_, sharded_mixed_, locked_hits_, sharded_hits_);
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif // DBJ_USTRINGS_CONCURRENT_TEST
+
+#endif // DBJ_USTRINGS_CONCURRENT_INC
@@ -0,0 +1,722 @@
+#ifndef DBJ_USTRINGS_PREFIX_INC
+#define DBJ_USTRINGS_PREFIX_INC
+
+/*
+ (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+ Prefix index of the interned strings, adaptive radix tree (ART)
+ https://db.in.tum.de/~leis/papers/ART.pdf
+
+ dbj::ustrings keeps its strings in the order of assignment and finds them
+ by hash; all the strings with some prefix are thus found by looking at all
+ of them. This one keeps them in the lexical (unsigned char) order:
+
+ - all the strings with the prefix, in order, O(prefix size) to the first one
+ - the longest string the text starts with, O(text size)
+
+ Inner nodes have 4, 16, 48 or 256 children, as many as needed; a chain of
+ single children is one node with a prefix. A key that ends where others
+ go on is the "terminal" of that node.
+
+ Keys are not copied, they are views of the stable chars of the pool and must
+ outlive their place in the index.
+
+ With DBJ_USTRINGS_PREFIX defined dbj::ustrings keeps one of these and
+ updates it on assign and on remove.
+*/
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+namespace dbj
+{
+	struct ustrings_prefix_index final
+	{
+		using id_type = uint32_t;
+		constexpr inline static id_type npos = id_type(-1);
+
+		// prefix bytes kept in the node, the rest of the longer ones is read from a key below
+		constexpr inline static size_t max_prefix = 10;
+
+		// keys in the index
+		size_t count = 0;
+
+		ustrings_prefix_index() noexcept = default;
+
+		ustrings_prefix_index(const ustrings_prefix_index&) = delete;
+		ustrings_prefix_index& operator=(const ustrings_prefix_index&) = delete;
+
+		ustrings_prefix_index(ustrings_prefix_index&& other_) noexcept
+			: count(other_.count), root(other_.root)
+		{
+			other_.count = 0;
+			other_.root = nullptr;
+		}
+
+		ustrings_prefix_index& operator=(ustrings_prefix_index&& other_) noexcept
+		{
+			if (this != &other_)
+			{
+				clear();
+				std::swap(count, other_.count);
+				std::swap(root, other_.root);
+			}
+			return *this;
+		}
+
+		~ustrings_prefix_index() noexcept { clear(); }
+
+		void clear() noexcept
+		{
+			if (root == nullptr)
+				return;
+			// no recursion, keys can be as long as the pool allows
+			std::vector<node*> nodes_{ root };
+			while (!nodes_.empty())
+			{
+				node* node_ = nodes_.back();
+				nodes_.pop_back();
+				if (node_->kind != leaf_kind)
+				{
+					inner* inner_ = static_cast<inner*>(node_);
+					if (inner_->terminal)
+						nodes_.push_back(inner_->terminal);
+					for_each_child_(inner_, [&](uint8_t, node* child_) { nodes_.push_back(child_); });
+				}
+				free_(node_);
+			}
+			root = nullptr;
+			count = 0;
+		}
+
+		// false if the key is already in
+		bool insert(std::string_view key, id_type id) noexcept
+		{
+			leaf* leaf_ = new leaf{};
+			leaf_->kind = leaf_kind;
+			leaf_->key = key;
+			leaf_->id = id;
+
+			node** ref_ = &root;
+			size_t depth_ = 0;
+			for (;;)
+			{
+				if (*ref_ == nullptr)
+				{
+					*ref_ = leaf_;
+					break;
+				}
+
+				if ((*ref_)->kind == leaf_kind)
+				{
+					leaf* other_ = static_cast<leaf*>(*ref_);
+					if (other_->key == key)
+					{
+						delete leaf_;
+						return false;
+					}
+					// new node where the two keys part
+					const size_t limit_ = std::min(key.size(), other_->key.size());
+					size_t same_ = depth_;
+					while (same_ < limit_ && key[same_] == other_->key[same_])
+						++same_;
+
+					node* node_ = make_<node4>(node4_kind);
+					set_prefix_(static_cast<inner*>(node_), key, depth_, same_ - depth_);
+					place_(node_, other_, same_);
+					place_(node_, leaf_, same_);
+					*ref_ = node_;
+					break;
+				}
+
+				inner* inner_ = static_cast<inner*>(*ref_);
+				const size_t same_ = prefix_match_(inner_, key, depth_);
+				if (same_ < inner_->prefix_size)
+				{
+					// new node where the key leaves the prefix, the old one hangs on it
+					const std::string_view below_ = any_leaf_(inner_)->key;
+					node* node_ = make_<node4>(node4_kind);
+					set_prefix_(static_cast<inner*>(node_), key, depth_, same_);
+					add_child_(node_, uint8_t(below_[depth_ + same_]), inner_);
+					set_prefix_(inner_, below_, depth_ + same_ + 1, inner_->prefix_size - same_ - 1);
+					place_(node_, leaf_, depth_ + same_);
+					*ref_ = node_;
+					break;
+				}
+
+				depth_ += inner_->prefix_size;
+				if (depth_ == key.size())
+				{
+					if (inner_->terminal)
+					{
+						delete leaf_;
+						return false;
+					}
+					inner_->terminal = leaf_;
+					break;
+				}
+
+				node** child_ = child_ref_(inner_, uint8_t(key[depth_]));
+				if (child_ == nullptr)
+				{
+					add_child_(*ref_, uint8_t(key[depth_]), leaf_);
+					break;
+				}
+				ref_ = child_;
+				depth_ += 1;
+			}
+
+			count += 1;
+			return true;
+		}
+
+		// false if the key is not in
+		bool erase(std::string_view key) noexcept
+		{
+			node** ref_ = &root;
+			node** parent_ = nullptr;
+			size_t parent_depth_ = 0;
+			size_t depth_ = 0;
+			for (;;)
+			{
+				if (*ref_ == nullptr)
+					return false;
+
+				if ((*ref_)->kind == leaf_kind)
+				{
+					if (static_cast<leaf*>(*ref_)->key != key)
+						return false;
+					free_(*ref_);
+					if (parent_ == nullptr)
+						*ref_ = nullptr;
+					else
+						remove_child_(*parent_, uint8_t(key[depth_ - 1]), parent_depth_);
+					break;
+				}
+
+				inner* inner_ = static_cast<inner*>(*ref_);
+				if (prefix_match_(inner_, key, depth_) < inner_->prefix_size)
+					return false;
+
+				const size_t node_depth_ = depth_;
+				depth_ += inner_->prefix_size;
+				if (depth_ == key.size())
+				{
+					if (inner_->terminal == nullptr)
+						return false;
+					free_(inner_->terminal);
+					inner_->terminal = nullptr;
+					shrink_(*ref_, node_depth_);
+					break;
+				}
+
+				node** child_ = child_ref_(inner_, uint8_t(key[depth_]));
+				if (child_ == nullptr)
+					return false;
+				parent_ = ref_;
+				parent_depth_ = node_depth_;
+				ref_ = child_;
+				depth_ += 1;
+			}
+
+			count -= 1;
+			return true;
+		}
+
+		// id of the key or npos
+		id_type find(std::string_view key) const noexcept
+		{
+			const node* node_ = root;
+			size_t depth_ = 0;
+			while (node_)
+			{
+				if (node_->kind == leaf_kind)
+				{
+					const leaf* leaf_ = static_cast<const leaf*>(node_);
+					return leaf_->key == key ? leaf_->id : npos;
+				}
+
+				const inner* inner_ = static_cast<const inner*>(node_);
+				if (prefix_match_(inner_, key, depth_) < inner_->prefix_size)
+					return npos;
+				depth_ += inner_->prefix_size;
+				if (depth_ == key.size())
+					return inner_->terminal ? inner_->terminal->id : npos;
+				node_ = child_(inner_, uint8_t(key[depth_]));
+				depth_ += 1;
+			}
+			return npos;
+		}
+
+		// id of the longest key the text starts with, npos if none
+		id_type longest_prefix(std::string_view text) const noexcept
+		{
+			id_type found_ = npos;
+			const node* node_ = root;
+			size_t depth_ = 0;
+			while (node_)
+			{
+				if (node_->kind == leaf_kind)
+				{
+					const leaf* leaf_ = static_cast<const leaf*>(node_);
+					if (text.substr(0, leaf_->key.size()) == leaf_->key)
+						found_ = leaf_->id;
+					break;
+				}
+
+				const inner* inner_ = static_cast<const inner*>(node_);
+				if (prefix_match_(inner_, text, depth_) < inner_->prefix_size)
+					break;
+				depth_ += inner_->prefix_size;
+				// all the bytes before depth_ are matched
+				if (inner_->terminal)
+					found_ = inner_->terminal->id;
+				if (depth_ == text.size())
+					break;
+				node_ = child_(inner_, uint8_t(text[depth_]));
+				depth_ += 1;
+			}
+			return found_;
+		}
+
+		// callback(key, id) for each key starting with the prefix, in the lexical order
+		// callback returns false to stop
+		template<typename callback_type>
+		void for_each(std::string_view prefix, callback_type&& callback) const
+		{
+			const node* node_ = root;
+			size_t depth_ = 0;
+			while (node_)
+			{
+				if (node_->kind == leaf_kind)
+				{
+					const leaf* leaf_ = static_cast<const leaf*>(node_);
+					if (leaf_->key.substr(0, prefix.size()) == prefix)
+						callback(leaf_->key, leaf_->id);
+					return;
+				}
+
+				const inner* inner_ = static_cast<const inner*>(node_);
+				const size_t same_ = prefix_match_(inner_, prefix, depth_);
+				// prefix ends in or right after the prefix of the node
+				if (depth_ + same_ == prefix.size())
+					break;
+				if (same_ < inner_->prefix_size)
+					return;
+				depth_ += inner_->prefix_size;
+				node_ = child_(inner_, uint8_t(prefix[depth_]));
+				depth_ += 1;
+			}
+			if (node_ == nullptr)
+				return;
+
+			// all of it, terminal before the children, children by their byte
+			std::vector<const node*> nodes_{ node_ };
+			while (!nodes_.empty())
+			{
+				const node* next_ = nodes_.back();
+				nodes_.pop_back();
+				if (next_->kind == leaf_kind)
+				{
+					const leaf* leaf_ = static_cast<const leaf*>(next_);
+					if (!callback(leaf_->key, leaf_->id))
+						return;
+					continue;
+				}
+
+				const inner* inner_ = static_cast<const inner*>(next_);
+				const size_t first_ = nodes_.size();
+				for_each_child_(inner_, [&](uint8_t, const node* child_) { nodes_.push_back(child_); });
+				std::reverse(nodes_.begin() + first_, nodes_.end());
+				if (inner_->terminal)
+					nodes_.push_back(inner_->terminal);
+			}
+		}
+
+	private:
+		enum kind_type : uint8_t { leaf_kind, node4_kind, node16_kind, node48_kind, node256_kind };
+
+		struct node
+		{
+			kind_type kind;
+		};
+
+		struct leaf final : node
+		{
+			std::string_view key;
+			id_type id;
+		};
+
+		struct inner : node
+		{
+			// children, the terminal excluded
+			uint16_t count;
+			// bytes all the keys below have in common after the byte this node hangs on
+			uint32_t prefix_size;
+			uint8_t prefix[max_prefix];
+			// the key ending after the prefix
+			leaf* terminal;
+		};
+
+		// keys are sorted
+		struct node4 final : inner
+		{
+			uint8_t keys[4];
+			node* children[4];
+		};
+
+		struct node16 final : inner
+		{
+			uint8_t keys[16];
+			node* children[16];
+		};
+
+		// slot of the child by the byte, 0 is none, else slot + 1
+		struct node48 final : inner
+		{
+			uint8_t slots[256];
+			node* children[48];
+		};
+
+		struct node256 final : inner
+		{
+			node* children[256];
+		};
+
+		node* root = nullptr;
+
+		template<typename node_type>
+		static node_type* make_(kind_type kind_) noexcept
+		{
+			node_type* node_ = new node_type{};
+			node_->kind = kind_;
+			return node_;
+		}
+
+		static void free_(node* node_) noexcept
+		{
+			switch (node_->kind)
+			{
+			case leaf_kind: delete static_cast<leaf*>(node_); break;
+			case node4_kind: delete static_cast<node4*>(node_); break;
+			case node16_kind: delete static_cast<node16*>(node_); break;
+			case node48_kind: delete static_cast<node48*>(node_); break;
+			default: delete static_cast<node256*>(node_); break;
+			}
+		}
+
+		static void set_prefix_(inner* inner_, std::string_view key_, size_t depth_, size_t size_) noexcept
+		{
+			inner_->prefix_size = uint32_t(size_);
+			const size_t kept_ = std::min(size_, max_prefix);
+			for (size_t k = 0; k < kept_; ++k)
+				inner_->prefix[k] = uint8_t(key_[depth_ + k]);
+		}
+
+		// there is always one, inner nodes have at least two keys below
+		static const leaf* any_leaf_(const node* node_) noexcept
+		{
+			while (node_->kind != leaf_kind)
+			{
+				const inner* inner_ = static_cast<const inner*>(node_);
+				if (inner_->terminal)
+					return inner_->terminal;
+				const node* first_ = nullptr;
+				for_each_child_(inner_, [&](uint8_t, const node* child_) { if (!first_) first_ = child_; });
+				node_ = first_;
+			}
+			return static_cast<const leaf*>(node_);
+		}
+
+		// prefix bytes of the node equal to the key bytes from depth_ on,
+		// not more than the key has
+		static size_t prefix_match_(const inner* inner_, std::string_view key_, size_t depth_) noexcept
+		{
+			const size_t size_ = std::min(size_t(inner_->prefix_size), key_.size() - depth_);
+			const size_t kept_ = std::min(size_, max_prefix);
+			size_t k = 0;
+			for (; k < kept_; ++k)
+				if (inner_->prefix[k] != uint8_t(key_[depth_ + k]))
+					return k;
+			if (size_ > max_prefix)
+			{
+				const std::string_view below_ = any_leaf_(inner_)->key;
+				for (; k < size_; ++k)
+					if (below_[depth_ + k] != key_[depth_ + k])
+						return k;
+			}
+			return k;
+		}
+
+		static node** child_ref_(inner* inner_, uint8_t byte_) noexcept
+		{
+			switch (inner_->kind)
+			{
+			case node4_kind:
+			{
+				node4* node_ = static_cast<node4*>(inner_);
+				for (size_t k = 0; k < node_->count; ++k)
+					if (node_->keys[k] == byte_)
+						return node_->children + k;
+				return nullptr;
+			}
+			case node16_kind:
+			{
+				node16* node_ = static_cast<node16*>(inner_);
+				for (size_t k = 0; k < node_->count; ++k)
+					if (node_->keys[k] == byte_)
+						return node_->children + k;
+				return nullptr;
+			}
+			case node48_kind:
+			{
+				node48* node_ = static_cast<node48*>(inner_);
+				return node_->slots[byte_] ? node_->children + node_->slots[byte_] - 1 : nullptr;
+			}
+			default:
+			{
+				node256* node_ = static_cast<node256*>(inner_);
+				return node_->children[byte_] ? node_->children + byte_ : nullptr;
+			}
+			}
+		}
+
+		static const node* child_(const inner* inner_, uint8_t byte_) noexcept
+		{
+			node** child_ = child_ref_(const_cast<inner*>(inner_), byte_);
+			return child_ ? *child_ : nullptr;
+		}
+
+		// callback_(byte, child) in the byte order
+		template<typename inner_type, typename callback_type>
+		static void for_each_child_(inner_type* inner_, callback_type&& callback_) noexcept
+		{
+			switch (inner_->kind)
+			{
+			case node4_kind:
+			{
+				auto node_ = static_cast<node4*>(const_cast<inner*>(static_cast<const inner*>(inner_)));
+				for (size_t k = 0; k < node_->count; ++k)
+					callback_(node_->keys[k], node_->children[k]);
+				break;
+			}
+			case node16_kind:
+			{
+				auto node_ = static_cast<node16*>(const_cast<inner*>(static_cast<const inner*>(inner_)));
+				for (size_t k = 0; k < node_->count; ++k)
+					callback_(node_->keys[k], node_->children[k]);
+				break;
+			}
+			case node48_kind:
+			{
+				auto node_ = static_cast<node48*>(const_cast<inner*>(static_cast<const inner*>(inner_)));
+				for (size_t b = 0; b < 256; ++b)
+					if (node_->slots[b])
+						callback_(uint8_t(b), node_->children[node_->slots[b] - 1]);
+				break;
+			}
+			default:
+			{
+				auto node_ = static_cast<node256*>(const_cast<inner*>(static_cast<const inner*>(inner_)));
+				for (size_t b = 0; b < 256; ++b)
+					if (node_->children[b])
+						callback_(uint8_t(b), node_->children[b]);
+				break;
+			}
+			}
+		}
+
+		// the same children in the node of the other kind, the old node is freed
+		static inner* resize_(inner* from_, kind_type kind_) noexcept
+		{
+			inner* to_ = nullptr;
+			switch (kind_)
+			{
+			case node4_kind: to_ = make_<node4>(kind_); break;
+			case node16_kind: to_ = make_<node16>(kind_); break;
+			case node48_kind: to_ = make_<node48>(kind_); break;
+			default: to_ = make_<node256>(kind_); break;
+			}
+			to_->prefix_size = from_->prefix_size;
+			std::memcpy(to_->prefix, from_->prefix, max_prefix);
+			to_->terminal = from_->terminal;
+			// in the byte order, thus appended
+			for_each_child_(from_, [&](uint8_t byte_, node* child_) { append_(to_, byte_, child_); });
+			free_(from_);
+			return to_;
+		}
+
+		// there is room, byte_ is bigger than the ones in the small nodes
+		static void append_(inner* inner_, uint8_t byte_, node* child_) noexcept
+		{
+			switch (inner_->kind)
+			{
+			case node4_kind:
+				static_cast<node4*>(inner_)->keys[inner_->count] = byte_;
+				static_cast<node4*>(inner_)->children[inner_->count] = child_;
+				break;
+			case node16_kind:
+				static_cast<node16*>(inner_)->keys[inner_->count] = byte_;
+				static_cast<node16*>(inner_)->children[inner_->count] = child_;
+				break;
+			case node48_kind:
+				static_cast<node48*>(inner_)->slots[byte_] = uint8_t(inner_->count + 1);
+				static_cast<node48*>(inner_)->children[inner_->count] = child_;
+				break;
+			default:
+				static_cast<node256*>(inner_)->children[byte_] = child_;
+				break;
+			}
+			inner_->count += 1;
+		}
+
+		template<typename small_type>
+		static void insert_sorted_(small_type* node_, uint8_t byte_, node* child_) noexcept
+		{
+			size_t at_ = node_->count;
+			for (; at_ > 0 && node_->keys[at_ - 1] > byte_; --at_)
+			{
+				node_->keys[at_] = node_->keys[at_ - 1];
+				node_->children[at_] = node_->children[at_ - 1];
+			}
+			node_->keys[at_] = byte_;
+			node_->children[at_] = child_;
+			node_->count += 1;
+		}
+
+		template<typename small_type>
+		static void remove_sorted_(small_type* node_, uint8_t byte_) noexcept
+		{
+			size_t at_ = 0;
+			while (node_->keys[at_] != byte_)
+				++at_;
+			for (; at_ + 1 < node_->count; ++at_)
+			{
+				node_->keys[at_] = node_->keys[at_ + 1];
+				node_->children[at_] = node_->children[at_ + 1];
+			}
+			node_->count -= 1;
+		}
+
+		// ref_ is the inner node, it is replaced by the bigger one if full
+		static void add_child_(node*& ref_, uint8_t byte_, node* child_) noexcept
+		{
+			inner* inner_ = static_cast<inner*>(ref_);
+			switch (inner_->kind)
+			{
+			case node4_kind:
+				if (inner_->count < 4)
+					return insert_sorted_(static_cast<node4*>(inner_), byte_, child_);
+				ref_ = resize_(inner_, node16_kind);
+				return add_child_(ref_, byte_, child_);
+			case node16_kind:
+				if (inner_->count < 16)
+					return insert_sorted_(static_cast<node16*>(inner_), byte_, child_);
+				ref_ = resize_(inner_, node48_kind);
+				return add_child_(ref_, byte_, child_);
+			case node48_kind:
+				if (inner_->count < 48)
+					break;
+				ref_ = resize_(inner_, node256_kind);
+				return add_child_(ref_, byte_, child_);
+			default:
+				break;
+			}
+
+			if (inner_->kind == node48_kind)
+			{
+				// slots of the removed children are empty
+				node48* node_ = static_cast<node48*>(inner_);
+				size_t slot_ = 0;
+				while (node_->children[slot_])
+					++slot_;
+				node_->slots[byte_] = uint8_t(slot_ + 1);
+				node_->children[slot_] = child_;
+				node_->count += 1;
+			}
+			else
+			{
+				static_cast<node256*>(inner_)->children[byte_] = child_;
+				inner_->count += 1;
+			}
+		}
+
+		// ref_ is the inner node at depth_
+		static void remove_child_(node*& ref_, uint8_t byte_, size_t depth_) noexcept
+		{
+			inner* inner_ = static_cast<inner*>(ref_);
+			switch (inner_->kind)
+			{
+			case node4_kind: remove_sorted_(static_cast<node4*>(inner_), byte_); break;
+			case node16_kind: remove_sorted_(static_cast<node16*>(inner_), byte_); break;
+			case node48_kind:
+			{
+				node48* node_ = static_cast<node48*>(inner_);
+				node_->children[node_->slots[byte_] - 1] = nullptr;
+				node_->slots[byte_] = 0;
+				node_->count -= 1;
+				break;
+			}
+			default:
+				static_cast<node256*>(inner_)->children[byte_] = nullptr;
+				inner_->count -= 1;
+				break;
+			}
+			shrink_(ref_, depth_);
+		}
+
+		// one key less below the inner node at depth_, there is at least one left
+		// node with one key below is replaced by it, the others get smaller if they can
+		static void shrink_(node*& ref_, size_t depth_) noexcept
+		{
+			inner* inner_ = static_cast<inner*>(ref_);
+			if (inner_->count == 0)
+			{
+				assert(inner_->terminal);
+				ref_ = inner_->terminal;
+				free_(inner_);
+				return;
+			}
+
+			if (inner_->count == 1 && inner_->terminal == nullptr)
+			{
+				node* child_ = nullptr;
+				for_each_child_(inner_, [&](uint8_t, node* only_) { child_ = only_; });
+				if (child_->kind != leaf_kind)
+				{
+					// prefixes are joined, with the byte between
+					inner* below_ = static_cast<inner*>(child_);
+					const size_t size_ = inner_->prefix_size + 1 + below_->prefix_size;
+					set_prefix_(below_, any_leaf_(below_)->key, depth_, size_);
+				}
+				ref_ = child_;
+				free_(inner_);
+				return;
+			}
+
+			switch (inner_->kind)
+			{
+			case node16_kind: if (inner_->count <= 3) ref_ = resize_(inner_, node4_kind); break;
+			case node48_kind: if (inner_->count <= 12) ref_ = resize_(inner_, node16_kind); break;
+			case node256_kind: if (inner_->count <= 36) ref_ = resize_(inner_, node48_kind); break;
+			default: break;
+			}
+		}
+
+		// the key ends at depth_ or goes on with its byte there
+		static void place_(node* node_, leaf* leaf_, size_t depth_) noexcept
+		{
+			if (leaf_->key.size() == depth_)
+				static_cast<inner*>(node_)->terminal = leaf_;
+			else
+				add_child_(node_, uint8_t(leaf_->key[depth_]), leaf_);
+		}
+	}; // ustrings_prefix_index
+
+} // namespace dbj
+
+#endif // DBJ_USTRINGS_PREFIX_INC
@@ -0,0 +1,689 @@
+#ifndef DBJ_USTRINGS_SNAPSHOT_INC
+#define DBJ_USTRINGS_SNAPSHOT_INC
+
+/*
+ (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+ ustrings pool saved in a file, to be mapped back into memory instead of
+ interning the same strings again on each start.
+
+ File is position independent, there are no pointers in it, just offsets:
+
+	header
+	entries    hash, chars offset and size, one per id
+	index      open addressing table of id + 1, 0 is empty
+	chars      zero terminated strings
+
+ Opening is one mapping, a header check and one pass over the entries and
+ the index, so a damaged file can not make the lookups read past the
+ mapping. Nothing is allocated, nothing is hashed.
+
+	dbj::ustrings_save(pool_, "known.ustrings");
+	...
+	dbj::ustrings_layered<dbj::hash_arena_node> strings_;
+	if (!decltype(strings_)::open(strings_, "known.ustrings")) ...
+	auto id_ = decltype(strings_)::assign(strings_, "new or known");
+
+ Ids of the saved pool are kept, removed ones included. Hashes are of the
+ ustrings_hash, files made with a different one are refused. Offsets are
+ 32 bit, pools of more than 4GB of chars are not saved.
+
+ Save, open and the layered assign, the damaged files refused, and the open
+ vs interning again, are the DBJ_USTRINGS_SNAPSHOT_TEST block at the bottom
+
+	g++ -std=c++17 -O2 -DDBJ_USTRINGS_SNAPSHOT_TEST -x c++ dbj_ustrings_snapshot.h
+*/
+
+#include "dbj_ustrings.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#include "dbj_windows_include.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dbj
+{
+	struct ustrings_snapshot_header final
+	{
+		constexpr inline static char magic_value[8] = { 'D', 'B', 'J', 'U', 'S', 'T', 'R', 'S' };
+		constexpr inline static uint32_t version_value = 2;
+
+		char magic[8];
+		uint32_t version;
+		uint32_t count;
+		// hash of the check_text, to know it is the same hash
+		uint64_t check;
+		uint64_t index_capacity;
+		uint64_t entries_offset;
+		uint64_t index_offset;
+		uint64_t chars_offset;
+		uint64_t chars_size;
+		uint64_t file_size;
+
+		constexpr inline static std::string_view check_text = "dbj::ustrings";
+
+		static uint64_t check_hash() noexcept
+		{
+			return uint64_t(ustrings_hash{}(check_text));
+		}
+	};
+
+	struct ustrings_snapshot_entry final
+	{
+		uint64_t hash;
+		uint32_t offset; // in chars
+		uint32_t size;   // 0 is the removed one
+	};
+
+	// write the pool into the file at path
+	// return false if that could not be done, or if the chars do not fit the 32 bit offsets
+	template<typename node_type_arg>
+	inline bool ustrings_save(ustrings<node_type_arg> const& pool_, const char* path) noexcept
+	{
+		using pool_type = ustrings<node_type_arg>;
+		assert(path);
+
+		const size_t count_ = pool_.strings.size();
+		std::vector<ustrings_snapshot_entry> entries_(count_);
+		std::vector<char> chars_;
+
+		size_t capacity_ = 16;
+		while (capacity_ < count_ * 2)
+			capacity_ *= 2;
+		std::vector<uint32_t> index_(capacity_, 0);
+		const size_t mask_ = capacity_ - 1;
+
+		for (size_t id_ = 0; id_ < count_; ++id_)
+		{
+			const std::string_view text_ = pool_type::view(pool_, typename pool_type::id_type(id_));
+			if (text_.data() == nullptr)
+			{
+				entries_[id_] = ustrings_snapshot_entry{ 0, 0, 0 };
+				continue;
+			}
+			// offset and size of this one, and the terminator, must fit
+			if (text_.size() >= size_t(UINT32_MAX) - chars_.size())
+				return false;
+			const size_t hash_ = pool_type::hash(pool_, typename pool_type::id_type(id_));
+			entries_[id_] = ustrings_snapshot_entry{ uint64_t(hash_), uint32_t(chars_.size()), uint32_t(text_.size()) };
+			chars_.insert(chars_.end(), text_.begin(), text_.end());
+			chars_.push_back('\0');
+
+			size_t slot_ = (hash_ >> 7) & mask_;
+			while (index_[slot_] != 0)
+				slot_ = (slot_ + 1) & mask_;
+			index_[slot_] = uint32_t(id_ + 1);
+		}
+
+		ustrings_snapshot_header header_{};
+		memcpy(header_.magic, ustrings_snapshot_header::magic_value, sizeof(header_.magic));
+		header_.version = ustrings_snapshot_header::version_value;
+		header_.count = uint32_t(count_);
+		header_.check = ustrings_snapshot_header::check_hash();
+		header_.index_capacity = capacity_;
+		header_.entries_offset = sizeof(header_);
+		header_.index_offset = header_.entries_offset + count_ * sizeof(ustrings_snapshot_entry);
+		header_.chars_offset = header_.index_offset + capacity_ * sizeof(uint32_t);
+		header_.chars_size = chars_.size();
+		header_.file_size = header_.chars_offset + chars_.size();
+
+		FILE* file_ = fopen(path, "wb");
+		if (file_ == nullptr)
+			return false;
+
+		bool done_ = fwrite(&header_, sizeof(header_), 1, file_) == 1
+			&& fwrite(entries_.data(), sizeof(ustrings_snapshot_entry), count_, file_) == count_
+			&& fwrite(index_.data(), sizeof(uint32_t), capacity_, file_) == capacity_
+			&& fwrite(chars_.data(), 1, chars_.size(), file_) == chars_.size();
+
+		done_ = (fclose(file_) == 0) && done_;
+		return done_;
+	}
+
+	// read only, memory mapped ustrings file
+	struct ustrings_snapshot final
+	{
+		using type = ustrings_snapshot;
+		using id_type = ustrings_index::position_type;
+		constexpr inline static id_type npos = id_type(-1);
+
+		ustrings_snapshot() noexcept = default;
+
+		// ustrings_snapshot objects can not be copied.
+		ustrings_snapshot(const ustrings_snapshot&) = delete;
+		ustrings_snapshot& operator=(const ustrings_snapshot&) = delete;
+
+		ustrings_snapshot(ustrings_snapshot&& other_) noexcept { swap_(other_); }
+		ustrings_snapshot& operator=(ustrings_snapshot&& other_) noexcept
+		{
+			if (this != &other_)
+			{
+				close(*this);
+				swap_(other_);
+			}
+			return *this;
+		}
+
+		~ustrings_snapshot() noexcept { close(*this); }
+
+		// map the file made by ustrings_save
+		// return false if that could not be done or if it is not that file
+		static bool open(type& snap_, const char* path) noexcept
+		{
+			assert(path);
+			close(snap_);
+			if (!map_(snap_, path))
+				return false;
+
+			if (!check_(snap_))
+			{
+				close(snap_);
+				return false;
+			}
+			return true;
+		}
+
+		static void close(type& snap_) noexcept
+		{
+			if (snap_.base_ != nullptr)
+				unmap_(snap_);
+			snap_.base_ = nullptr;
+			snap_.size_ = 0;
+		}
+
+		static bool is_open(type const& snap_) noexcept { return snap_.base_ != nullptr; }
+
+		// ids are 0 .. count - 1, removed ones included
+		static size_t count(type const& snap_) noexcept
+		{
+			return snap_.base_ ? header_(snap_).count : 0;
+		}
+
+		// id of the text or npos if not found
+		static id_type find(type const& snap_, std::string_view text_) noexcept
+		{
+			if (snap_.base_ == nullptr)
+				return npos;
+
+			static ustrings_hash hash_;
+			const uint64_t hash_value_ = uint64_t(hash_(text_));
+			const ustrings_snapshot_header& header_ = type::header_(snap_);
+			const uint32_t* index_ = at_<uint32_t>(snap_, header_.index_offset);
+			const ustrings_snapshot_entry* entries_ = at_<ustrings_snapshot_entry>(snap_, header_.entries_offset);
+			const size_t mask_ = size_t(header_.index_capacity - 1);
+
+			for (size_t slot_ = size_t(hash_value_ >> 7) & mask_;; slot_ = (slot_ + 1) & mask_)
+			{
+				const uint32_t id_ = index_[slot_];
+				if (id_ == 0)
+					return npos;
+				const ustrings_snapshot_entry& entry_ = entries_[id_ - 1];
+				if (entry_.hash == hash_value_ && entry_.size == text_.size()
+					&& memcmp(at_<char>(snap_, header_.chars_offset + entry_.offset), text_.data(), text_.size()) == 0)
+					return id_type(id_ - 1);
+			}
+		}
+
+		// O(1), empty view with nullptr data for the removed id
+		static std::string_view view(type const& snap_, id_type id_) noexcept
+		{
+			assert(id_ < count(snap_));
+			const ustrings_snapshot_header& header_ = type::header_(snap_);
+			const ustrings_snapshot_entry& entry_ = at_<ustrings_snapshot_entry>(snap_, header_.entries_offset)[id_];
+			if (entry_.size == 0)
+				return std::string_view();
+			return std::string_view(at_<char>(snap_, header_.chars_offset + entry_.offset), entry_.size);
+		}
+
+		static size_t hash(type const& snap_, id_type id_) noexcept
+		{
+			assert(id_ < count(snap_));
+			return size_t(at_<ustrings_snapshot_entry>(snap_, header_(snap_).entries_offset)[id_].hash);
+		}
+
+	private:
+		const char* base_ = nullptr;
+		size_t size_ = 0;
+#ifdef _WIN32
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+#endif
+
+		template<typename T>
+		static const T* at_(type const& snap_, uint64_t offset_) noexcept
+		{
+			return reinterpret_cast<const T*>(snap_.base_ + offset_);
+		}
+
+		static const ustrings_snapshot_header& header_(type const& snap_) noexcept
+		{
+			return *at_<ustrings_snapshot_header>(snap_, 0);
+		}
+
+		// the header, then each entry and each index slot, once
+		// find() and view() do not check anything
+		static bool check_(type const& snap_) noexcept
+		{
+			if (snap_.size_ < sizeof(ustrings_snapshot_header))
+				return false;
+
+			const ustrings_snapshot_header& header_ = type::header_(snap_);
+			if (memcmp(header_.magic, ustrings_snapshot_header::magic_value, sizeof(header_.magic)) != 0
+				|| header_.version != ustrings_snapshot_header::version_value
+				|| header_.check != ustrings_snapshot_header::check_hash()
+				|| header_.file_size != snap_.size_)
+				return false;
+
+			// no overflow below, all are smaller than the file
+			const uint64_t capacity_ = header_.index_capacity;
+			if (capacity_ < 16 || (capacity_ & (capacity_ - 1)) != 0 || capacity_ <= header_.count
+				|| capacity_ > snap_.size_ / sizeof(uint32_t) || header_.chars_size > snap_.size_
+				|| header_.entries_offset != sizeof(ustrings_snapshot_header)
+				|| header_.index_offset != header_.entries_offset + header_.count * sizeof(ustrings_snapshot_entry)
+				|| header_.chars_offset != header_.index_offset + capacity_ * sizeof(uint32_t)
+				|| header_.chars_offset + header_.chars_size != header_.file_size)
+				return false;
+
+			// texts are inside the chars and zero terminated
+			const ustrings_snapshot_entry* entries_ = at_<ustrings_snapshot_entry>(snap_, header_.entries_offset);
+			const char* chars_ = at_<char>(snap_, header_.chars_offset);
+			for (uint32_t k = 0; k < header_.count; ++k)
+			{
+				const ustrings_snapshot_entry& entry_ = entries_[k];
+				if (entry_.size == 0)
+					continue;
+				if (uint64_t(entry_.offset) + entry_.size >= header_.chars_size || chars_[entry_.offset + uint64_t(entry_.size)] != '\0')
+					return false;
+			}
+
+			// ids of the texts, and at least one empty slot, thus find() ends
+			const uint32_t* index_ = at_<uint32_t>(snap_, header_.index_offset);
+			bool empty_ = false;
+			for (uint64_t k = 0; k < capacity_; ++k)
+			{
+				if (index_[k] == 0)
+					empty_ = true;
+				else if (index_[k] > header_.count || entries_[index_[k] - 1].size == 0)
+					return false;
+			}
+			return empty_;
+		}
+
+		void swap_(ustrings_snapshot& other_) noexcept
+		{
+			std::swap(base_, other_.base_);
+			std::swap(size_, other_.size_);
+#ifdef _WIN32
+			std::swap(file_, other_.file_);
+			std::swap(mapping_, other_.mapping_);
+#endif
+		}
+
+#ifdef _WIN32
+		static bool map_(type& snap_, const char* path) noexcept
+		{
+			snap_.file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (snap_.file_ == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER size_{};
+			if (GetFileSizeEx(snap_.file_, &size_) && size_.QuadPart > 0)
+				snap_.mapping_ = CreateFileMappingA(snap_.file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+			if (snap_.mapping_ != nullptr)
+				snap_.base_ = static_cast<const char*>(MapViewOfFile(snap_.mapping_, FILE_MAP_READ, 0, 0, 0));
+
+			if (snap_.base_ == nullptr)
+			{
+				unmap_(snap_);
+				return false;
+			}
+			snap_.size_ = size_t(size_.QuadPart);
+			return true;
+		}
+
+		static void unmap_(type& snap_) noexcept
+		{
+			if (snap_.base_ != nullptr)
+				UnmapViewOfFile(snap_.base_);
+			if (snap_.mapping_ != nullptr)
+				CloseHandle(snap_.mapping_);
+			if (snap_.file_ != INVALID_HANDLE_VALUE)
+				CloseHandle(snap_.file_);
+			snap_.mapping_ = nullptr;
+			snap_.file_ = INVALID_HANDLE_VALUE;
+		}
+#else
+		static bool map_(type& snap_, const char* path) noexcept
+		{
+			const int file_ = ::open(path, O_RDONLY);
+			if (file_ < 0)
+				return false;
+
+			struct stat stat_ {};
+			void* base_ = MAP_FAILED;
+			if (fstat(file_, &stat_) == 0 && stat_.st_size > 0)
+				base_ = mmap(nullptr, size_t(stat_.st_size), PROT_READ, MAP_PRIVATE, file_, 0);
+			// mapping stays after the close
+			::close(file_);
+
+			if (base_ == MAP_FAILED)
+				return false;
+			snap_.base_ = static_cast<const char*>(base_);
+			snap_.size_ = size_t(stat_.st_size);
+			return true;
+		}
+
+		static void unmap_(type& snap_) noexcept
+		{
+			munmap(const_cast<char*>(snap_.base_), snap_.size_);
+		}
+#endif
+	}; // ustrings_snapshot
+
+	/*
+	 mapped snapshot as the read only base with the ustrings pool on top
+	 ids of the base are 0 .. base count - 1, the ones of the pool follow
+	*/
+	template<typename node_type_arg>
+	struct ustrings_layered final
+	{
+		using type = ustrings_layered;
+		using pool_type = ustrings<node_type_arg>;
+		using id_type = typename pool_type::id_type;
+		constexpr inline static id_type npos = pool_type::npos;
+
+		ustrings_snapshot base{};
+		pool_type overlay{};
+
+		// the overlay is cleared, its ids would not be right any more
+		static bool open(type& layers_, const char* path) noexcept
+		{
+			layers_.overlay.clear();
+			return ustrings_snapshot::open(layers_.base, path);
+		}
+
+		// assign to the overlay if not found in the base
+		static id_type assign(type& layers_, const char* text) noexcept
+		{
+			assert(text);
+			const id_type id_ = ustrings_snapshot::find(layers_.base, text);
+			if (id_ != ustrings_snapshot::npos)
+				return id_;
+			return id_type(ustrings_snapshot::count(layers_.base) + pool_type::assign(layers_.overlay, text));
+		}
+
+		// id of the text or npos if not found
+		static id_type find(type const& layers_, const char* text) noexcept
+		{
+			assert(text);
+			const id_type id_ = ustrings_snapshot::find(layers_.base, text);
+			if (id_ != ustrings_snapshot::npos)
+				return id_;
+			const id_type overlay_id_ = pool_type::find(layers_.overlay, text);
+			if (overlay_id_ == pool_type::npos)
+				return npos;
+			return id_type(ustrings_snapshot::count(layers_.base) + overlay_id_);
+		}
+
+		// O(1)
+		static std::string_view view(type const& layers_, id_type id_) noexcept
+		{
+			const size_t base_count_ = ustrings_snapshot::count(layers_.base);
+			if (id_ < base_count_)
+				return ustrings_snapshot::view(layers_.base, id_);
+			return pool_type::view(layers_.overlay, id_type(id_ - base_count_));
+		}
+
+		// the base is read only, only the overlay ids can be removed
+		static bool remove(type& layers_, id_type id_) noexcept
+		{
+			const size_t base_count_ = ustrings_snapshot::count(layers_.base);
+			if (id_ < base_count_)
+				return false;
+			return pool_type::remove(layers_.overlay, id_type(id_ - base_count_));
+		}
+	}; // ustrings_layered
+
+} // namespace dbj
+
+#ifdef DBJ_USTRINGS_SNAPSHOT_TEST
+
+#include <cstddef>
+#include <chrono>
+#include <string>
+
+/*
+ a pool of 100k identifiers, two of them removed, saved and opened as
+ the base of the layered pool; ids, views and finds must be as of the
+ pool saved, new texts go to the overlay
+ then the file is truncated, or damaged in the header, the entries, the
+ index or the chars, and each of these must be refused by open()
+*/
+namespace dbj_ustrings_snapshot_test
+{
+	using pool_type = dbj::ustring_pool_using_arena;
+	using layered_type = dbj::ustrings_layered<dbj::hash_arena_node>;
+	using snapshot_type = dbj::ustrings_snapshot;
+	using header_type = dbj::ustrings_snapshot_header;
+
+	constexpr size_t key_count = 100000;
+	constexpr const char* path = "dbj_ustrings_snapshot_test.ustrings";
+	constexpr const char* damaged_path = "dbj_ustrings_snapshot_test_damaged.ustrings";
+	constexpr size_t removed_ids[] = { 5, 17 };
+
+	inline std::vector<std::string> make_keys()
+	{
+		std::vector<std::string> keys_(key_count);
+		for (size_t k = 0; k < key_count; ++k)
+			keys_[k] = "identifier_" + std::to_string(k * 2654435761u);
+		return keys_;
+	}
+
+	inline bool is_removed(size_t id_)
+	{
+		for (size_t removed_ : removed_ids)
+			if (id_ == removed_)
+				return true;
+		return false;
+	}
+
+	inline std::vector<char> read_file(const char* path_)
+	{
+		std::vector<char> bytes_;
+		if (FILE* file_ = fopen(path_, "rb"))
+		{
+			char block_[4096];
+			for (size_t got_; (got_ = fread(block_, 1, sizeof(block_), file_)) > 0;)
+				bytes_.insert(bytes_.end(), block_, block_ + got_);
+			fclose(file_);
+		}
+		return bytes_;
+	}
+
+	inline bool write_file(const char* path_, std::vector<char> const& bytes_)
+	{
+		FILE* file_ = fopen(path_, "wb");
+		if (file_ == nullptr)
+			return false;
+		const bool done_ = fwrite(bytes_.data(), 1, bytes_.size(), file_) == bytes_.size();
+		return (fclose(file_) == 0) && done_;
+	}
+
+	template<typename T>
+	inline void poke(std::vector<char>& bytes_, size_t offset_, T value_)
+	{
+		memcpy(bytes_.data() + offset_, &value_, sizeof(value_));
+	}
+
+	template<typename T>
+	inline T peek(std::vector<char> const& bytes_, size_t offset_)
+	{
+		T value_{};
+		memcpy(&value_, bytes_.data() + offset_, sizeof(value_));
+		return value_;
+	}
+
+	inline bool round_trip(std::vector<std::string> const& keys_)
+	{
+		{
+			pool_type pool_;
+			for (std::string const& key_ : keys_)
+				pool_type::assign(pool_, key_.c_str());
+			for (size_t removed_ : removed_ids)
+				pool_type::remove(pool_, pool_type::id_type(removed_));
+			if (!dbj::ustrings_save(pool_, path))
+				return false;
+		}
+
+		layered_type layers_;
+		if (!layered_type::open(layers_, path) || snapshot_type::count(layers_.base) != keys_.size())
+			return false;
+
+		for (size_t id_ = 0; id_ < keys_.size(); ++id_)
+		{
+			const layered_type::id_type found_ = layered_type::find(layers_, keys_[id_].c_str());
+			const std::string_view view_ = layered_type::view(layers_, layered_type::id_type(id_));
+			if (is_removed(id_))
+			{
+				if (found_ != layered_type::npos || view_.data() != nullptr)
+					return false;
+			}
+			else if (found_ != id_ || view_ != keys_[id_] || view_.data()[view_.size()] != '\0')
+			{
+				return false;
+			}
+		}
+
+		// known ones are in the base, new ones go after it
+		const layered_type::id_type new_ = layered_type::assign(layers_, "not saved");
+		return layered_type::assign(layers_, keys_[3].c_str()) == 3 &&
+			new_ == keys_.size() && layered_type::assign(layers_, "not saved") == new_ &&
+			layered_type::view(layers_, new_) == "not saved" &&
+			layered_type::find(layers_, "not saved") == new_ &&
+			!layered_type::remove(layers_, 3) && layered_type::remove(layers_, new_) &&
+			layered_type::find(layers_, "not saved") == layered_type::npos;
+	}
+
+	// damage_(bytes) is applied to the good file, open() must refuse the result
+	template<typename F>
+	inline bool refused(const char* prompt_, std::vector<char> const& good_, F damage_)
+	{
+		std::vector<char> bytes_ = good_;
+		damage_(bytes_);
+		snapshot_type snap_;
+		if (!write_file(damaged_path, bytes_) || snapshot_type::open(snap_, damaged_path))
+		{
+			printf("%s: damaged file is not refused\n", prompt_);
+			return false;
+		}
+		return !snapshot_type::is_open(snap_);
+	}
+
+	inline bool damaged_files()
+	{
+		const std::vector<char> good_ = read_file(path);
+		const header_type header_ = peek<header_type>(good_, 0);
+		const size_t entry_ = size_t(header_.entries_offset) + 7 * sizeof(dbj::ustrings_snapshot_entry);
+		const size_t removed_entry_ = size_t(header_.entries_offset) + removed_ids[0] * sizeof(dbj::ustrings_snapshot_entry);
+
+		// the used slot and the empty slot of the index
+		size_t used_slot_ = 0, empty_slot_ = 0;
+		for (size_t k = 0; k < header_.index_capacity; ++k)
+		{
+			const size_t offset_ = size_t(header_.index_offset) + k * sizeof(uint32_t);
+			(peek<uint32_t>(good_, offset_) ? used_slot_ : empty_slot_) = offset_;
+		}
+
+		snapshot_type snap_;
+		if (!snapshot_type::open(snap_, path) || snapshot_type::open(snap_, "no such file"))
+		{
+			printf("the good file is refused, or the missing one is not\n");
+			return false;
+		}
+
+		return refused("empty", good_, [](std::vector<char>& bytes_) { bytes_.clear(); }) &&
+			refused("shorter than the header", good_, [](std::vector<char>& bytes_) { bytes_.resize(sizeof(header_type) - 1); }) &&
+			refused("truncated", good_, [](std::vector<char>& bytes_) { bytes_.pop_back(); }) &&
+			refused("longer", good_, [](std::vector<char>& bytes_) { bytes_.push_back('\0'); }) &&
+			refused("magic", good_, [](std::vector<char>& bytes_) { bytes_[0] = 'X'; }) &&
+			refused("version", good_, [](std::vector<char>& bytes_) {
+				poke(bytes_, offsetof(header_type, version), header_type::version_value + 1); }) &&
+			refused("other hash", good_, [](std::vector<char>& bytes_) {
+				poke(bytes_, offsetof(header_type, check), header_type::check_hash() + 1); }) &&
+			refused("count", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, offsetof(header_type, count), header_.count + 1); }) &&
+			refused("index capacity", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, offsetof(header_type, index_capacity), header_.index_capacity / 2); }) &&
+			refused("chars size", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, offsetof(header_type, chars_size), header_.chars_size - 1); }) &&
+			refused("entry outside the chars", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, entry_ + offsetof(dbj::ustrings_snapshot_entry, offset), uint32_t(header_.chars_size)); }) &&
+			refused("entry size", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, entry_ + offsetof(dbj::ustrings_snapshot_entry, size), uint32_t(-1)); }) &&
+			refused("terminator", good_, [&](std::vector<char>& bytes_) { bytes_.back() = 'X'; }) &&
+			refused("index past the count", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, used_slot_, uint32_t(header_.count + 1)); }) &&
+			refused("index of the removed", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, empty_slot_, uint32_t(removed_ids[0] + 1)); }) &&
+			refused("removed made live", good_, [&](std::vector<char>& bytes_) {
+				poke(bytes_, removed_entry_ + offsetof(dbj::ustrings_snapshot_entry, size), uint32_t(1)); }) &&
+			refused("index full", good_, [&](std::vector<char>& bytes_) {
+				for (size_t k = 0; k < header_.index_capacity; ++k)
+				{
+					const size_t offset_ = size_t(header_.index_offset) + k * sizeof(uint32_t);
+					if (peek<uint32_t>(bytes_, offset_) == 0)
+						poke(bytes_, offset_, uint32_t(1));
+				} });
+	}
+} // namespace dbj_ustrings_snapshot_test
+
+int main(void)
+{
+	using namespace dbj_ustrings_snapshot_test;
+
+	const std::vector<std::string> keys_ = make_keys();
+	const bool round_trip_ = round_trip(keys_);
+	const bool damaged_ = round_trip_ && damaged_files();
+	remove(damaged_path);
+	if (!round_trip_)
+	{
+		printf("ids or views of the opened file are not the ones saved\n");
+		remove(path);
+		return EXIT_FAILURE;
+	}
+	if (!damaged_)
+	{
+		remove(path);
+		return EXIT_FAILURE;
+	}
+
+	const auto start_ = std::chrono::steady_clock::now();
+	layered_type layers_;
+	const bool opened_ = layered_type::open(layers_, path);
+	const auto opened_at_ = std::chrono::steady_clock::now();
+	{
+		pool_type pool_;
+		for (std::string const& key_ : keys_)
+			pool_type::assign(pool_, key_.c_str());
+	}
+	const auto interned_at_ = std::chrono::steady_clock::now();
+	remove(path);
+
+	printf("%zu ids kept, damaged files refused\n", keys_.size());
+	printf("open %.3f ms vs interning again %.3f ms\n",
+		std::chrono::duration<double, std::milli>(opened_at_ - start_).count(),
+		std::chrono::duration<double, std::milli>(interned_at_ - opened_at_).count());
+	return opened_ ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // DBJ_USTRINGS_SNAPSHOT_TEST
+
+#endif // DBJ_USTRINGS_SNAPSHOT_INC
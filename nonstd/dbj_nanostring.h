@@ -3,24 +3,49 @@
 
 // -std=c++17 -fno-exceptions -fno-rtti
 /*
-https://godbolt.org/z/hczjYz
+dbj::basic_strng<N> keeps at least N chars in itself, no heap alloc
+dbj::strng is basic_strng<23>, 32 bytes as std::string is, 31 chars inline
 
-testing dbj strng 
-Loop count  0xFFFF
-Small size: 1024
-Large size: 15360
+The last byte is the kind and the size: for the small ones it is
+small_size_ - size, thus it is also the zero terminator when the strng
+is full. Copies and moves of the small ones are one memcpy of the
+fixed size, moves of the large ones too.
 
-small dbj::strng      		0.111 sec,  111 dbj's
-LARGE dbj::strng      		0.120 sec,  120 dbj's
-LARGE std::string     		0.009 sec,  9 dbj's
-LARGE std::vector<char>  	0.013 sec,  13 dbj's
+It is also a builder: append, push_back, resize, reserve and format_to
+grow the large ones geometrically, by realloc. Over max_size_ or out
+of memory the process ends, as there are no exceptions.
 
-Basically this is bollocks ... dbj::strng is desperately slow
-and not very functional. This is left in as a monument to vanity 
+Chars of the large ones come from the allocator, the second template
+argument; strng_heap by default, malloc/realloc/free. With a
+strng_arena_allocator they come from the strng_arena, all given back at
+once by strng_arena::reset(), per request for example:
 
-If you need a string just use std::string, of course always build 
-with no exceptions and no RTTI ...
-Do you really think you can beat std::string in that scenario?
+	dbj::strng_arena arena_;
+	dbj::arena_strng line_(dbj::strng_arena_allocator{ arena_ });
+	// ... all the strngs of the request
+	arena_.reset();
+
+make() zeroes or fills, make_for_overwrite() does not touch the chars.
+
+Benchmark is the DBJSTRING_TEST block at the bottom
+
+g++ -std=c++17 -O2 -fno-exceptions -fno-rtti -DDBJSTRING_TEST -x c++ dbj_nanostring.h
+
+g++ 12, libstdc++, 0xFFFFF times: make, copy, move both into the vector
+
+small   (12 chars)    dbj::strng              0.016 sec, std::string 0.028 sec
+medium  (60 chars)    dbj::basic_strng<64>    0.018 sec, std::string 0.053 sec
+medium  (60 chars)    dbj::basic_strng<254>   0.025 sec, std::string 0.055 sec
+LARGE   (15360 chars) dbj::strng              0.422 sec, std::string 0.417 sec
+
+append("key=value") and push_back(';'), 0xFFFFF times in total
+3 pieces   dbj::strng   0.007 sec, std::string 0.029 sec
+100 pieces dbj::strng   0.010 sec, std::string 0.016 sec
+
+0xFFFFF strngs of 1000 chars, 64 per request, make_for_overwrite
+calloc       0.088 sec
+malloc       0.075 sec
+strng_arena  0.042 sec
 */
 
 
@@ -34,6 +59,7 @@ Do you really think you can beat std::string in that scenario?
 #include <stdlib.h>
 #include <stdbool.h>
 #include <malloc.h>
+#include <stdint.h>
 #include <string.h>
 #include <string_view>
 #include <string>
@@ -43,89 +69,317 @@ Do you really think you can beat std::string in that scenario?
 #define DBJ_ASSERT assert
 #define DBJ_REPEAT(N) for (size_t dbj_repeat_counter_ = 0; dbj_repeat_counter_ < static_cast<size_t>(N); ++dbj_repeat_counter_)
 
-#define DBJ_CALLOC(T_, S_) (T_*)calloc(S_, sizeof(T_))
+#define DBJ_MALLOC(T_, S_) (T_*)malloc((S_) * sizeof(T_))
 #define DBJ_FREE(P_) free(P_)
 #define DBJ_PRINT(...) printf("\n"),printf(__VA_ARGS__)
 
+// no exceptions; out of memory or over the max size is the end
+#define DBJ_STRNG_FAIL(MSG_) (errno = ENOMEM, perror("dbj  strng " MSG_), exit(EXIT_FAILURE))
+
 namespace dbj {
+
+	/// ------------------------------------------
+	/// allocators of the dbj strng chars
+	/// nullptr when out of memory, chars are not zeroed
+	/// reallocate keeps old_size_ chars
+	/// not final, strng inherits its allocator, to take no room when empty
+
+	struct strng_heap {
+		char* allocate(size_t size_) noexcept {
+			return DBJ_MALLOC(char, size_);
+		}
+		char* reallocate(char* chars_, size_t /*old_size_*/, size_t size_) noexcept {
+			return static_cast<char*>(realloc(chars_, size_));
+		}
+		void deallocate(char* chars_, size_t /*size_*/) noexcept {
+			DBJ_FREE(chars_);
+		}
+	};
+
+	///
+	/// bump allocator, chars are given back all at once
+	/// by reset(), kept for the next use, or by release()
+	/// only the last allocation is given back on its own, or grown in place
+	///
+	class strng_arena final {
+	public:
+		/// a block holds the largest strng
+		constexpr static size_t block_size_ = 0xFFFF + 1;
+
+		strng_arena() noexcept = default;
+		strng_arena(strng_arena const&) = delete;
+		strng_arena& operator = (strng_arena const&) = delete;
+		strng_arena(strng_arena&&) = delete;
+		strng_arena& operator = (strng_arena&&) = delete;
+
+		~strng_arena() { release(); }
+
+		char* allocate(size_t size_) noexcept {
+			if (current_ == nullptr || current_->size - used_ < size_)
+			{
+				if (!next_block_(size_))
+					return nullptr;
+			}
+			char* chars_ = current_->chars() + used_;
+			used_ += size_;
+			last_ = chars_;
+			return chars_;
+		}
+
+		char* reallocate(char* chars_, size_t old_size_, size_t size_) noexcept {
+			if (chars_ == last_ && current_->size - (used_ - old_size_) >= size_)
+			{
+				used_ = used_ - old_size_ + size_;
+				return chars_;
+			}
+			char* moved_ = allocate(size_);
+			if (moved_)
+				memcpy(moved_, chars_, old_size_ < size_ ? old_size_ : size_);
+			return moved_;
+		}
+
+		void deallocate(char* chars_, size_t size_) noexcept {
+			if (chars_ == last_)
+			{
+				used_ -= size_;
+				last_ = nullptr;
+			}
+		}
+
+		/// all the chars given are gone, blocks are kept
+		void reset() noexcept {
+			current_ = first_;
+			used_ = 0;
+			last_ = nullptr;
+		}
+
+		/// blocks are freed too
+		void release() noexcept {
+			while (first_)
+			{
+				block* next_ = first_->next;
+				DBJ_FREE(first_);
+				first_ = next_;
+			}
+			current_ = nullptr;
+			used_ = 0;
+			last_ = nullptr;
+		}
+
+	private:
+		/// chars follow
+		struct block final {
+			block* next;
+			size_t size;
+			char* chars() noexcept { return reinterpret_cast<char*>(this + 1); }
+		};
+
+		block* first_{};
+		block* current_{};
+		size_t used_{};
+		char* last_{};
+
+		/// the next one kept by reset() if big enough, else a new one after the current
+		bool next_block_(size_t size_) noexcept {
+			if (current_ && current_->next && current_->next->size >= size_)
+			{
+				current_ = current_->next;
+				used_ = 0;
+				return true;
+			}
+			const size_t block_size_arg_ = size_ > block_size_ ? size_ : block_size_;
+			block* block_ = static_cast<block*>(malloc(sizeof(block) + block_size_arg_));
+			if (block_ == nullptr)
+				return false;
+			block_->size = block_size_arg_;
+			if (current_)
+			{
+				block_->next = current_->next;
+				current_->next = block_;
+			}
+			else
+			{
+				block_->next = first_;
+				first_ = block_;
+			}
+			current_ = block_;
+			used_ = 0;
+			return true;
+		}
+	};
+
+	/// the strng_arena of the strng, the arena outlives its strngs
+	struct strng_arena_allocator {
+		strng_arena* arena;
+
+		explicit strng_arena_allocator(strng_arena& arena_) noexcept : arena(&arena_) {}
+
+		char* allocate(size_t size_) noexcept {
+			return arena->allocate(size_);
+		}
+		char* reallocate(char* chars_, size_t old_size_, size_t size_) noexcept {
+			return arena->reallocate(chars_, old_size_, size_);
+		}
+		void deallocate(char* chars_, size_t size_) noexcept {
+			arena->deallocate(chars_, size_);
+		}
+	};
+
 	///
 	/// nano but fully functional strng
 	/// (name is deliberate; not to clash with 'string'
-	/// optimized for sizes up to strng::small_size_
-	/// 
-	class strng final {
+	/// no heap alloc for up to small_size_ chars
+	///
+	/// small_capacity_arg is the least number of chars kept inline;
+	/// the object is never smaller than the heap pointer, size and capacity
+	/// of the large ones, and all of it but the last byte is used
+	///
+	/// allocator_arg is kept in the object, strng_heap takes no room
+	///
+	template <size_t small_capacity_arg = 23, typename allocator_arg = strng_heap>
+	class basic_strng final : private allocator_arg {
+
+		struct large_type final {
+			char* data;
+			size_t size;
+			size_t capacity;
+		};
+
+		static_assert(small_capacity_arg <= 254,
+			"the last byte holds the free inline chars, 255 is the large tag");
+
+		constexpr static size_t align_ = alignof(large_type);
+		constexpr static size_t least_ = small_capacity_arg + 1 > sizeof(large_type) + 1
+			? small_capacity_arg + 1 : sizeof(large_type) + 1;
+
 	public:
+		/// bytes of the object
+		constexpr static size_t storage_size_ = (least_ + align_ - 1) / align_ * align_;
 		/// no heap alloc for up to small size
-		constexpr static auto small_size_ = 1024;
-		constexpr static auto max_size_ = 0xFFFF;
+		constexpr static size_t small_size_ = storage_size_ - 1 < 254 ? storage_size_ - 1 : 254;
+		constexpr static size_t max_size_ = 0xFFFF;
+		/// the large capacity grows at least by this factor
+		constexpr static size_t growth_factor_ = 2;
+
+		using allocator_type = allocator_arg;
+
 	private:
+		constexpr static unsigned char large_tag_ = 0xFF;
 
-		// NOTE! this is size that user has used
-		// for constructing
-		mutable size_t size{};
+		alignas(large_type) char data_[storage_size_];
 
-		enum class kind_tag { small, large };
-		mutable kind_tag data_kind_;
+		unsigned char tag_() const noexcept {
+			return static_cast<unsigned char>(data_[storage_size_ - 1]);
+		}
+
+		large_type get_large_() const noexcept {
+			large_type large_{};
+			memcpy(&large_, data_, sizeof(large_type));
+			return large_;
+		}
 
-		mutable union {
-			char* large;
-			char small[strng::small_size_]{ 0 };
-		} data_;
+		void set_large_(large_type const& large_) noexcept {
+			memcpy(data_, &large_, sizeof(large_type));
+			data_[storage_size_ - 1] = static_cast<char>(large_tag_);
+		}
+
+		/// chars are already in
+		/// when full the size byte is the terminator
+		void set_small_(size_t size_) noexcept {
+			assert(size_ <= small_size_);
+			data_[size_] = 0;
+			data_[storage_size_ - 1] = static_cast<char>(small_size_ - size_);
+		}
+
+		/// chars are already in
+		void set_size_(size_t size_) noexcept {
+			if (is_small())
+				return set_small_(size_);
+			large_type large_ = get_large_();
+			assert(size_ <= large_.capacity);
+			large_.size = size_;
+			large_.data[size_] = 0;
+			set_large_(large_);
+		}
 
 		/// ------------------------------------------
-		/// Notice we do not touch this->size here
-		char* make_data(size_t size_arg_) const noexcept {
+		/// room for size_arg_ chars and the terminator,
+		/// chars are not set
+		char* make_data(size_t size_arg_) noexcept {
 
-			if (size_arg_ < small_size_)
+			if (size_arg_ <= small_size_)
 			{
-				this->data_kind_ = kind_tag::small;
-				return data_.small;
+				set_small_(size_arg_);
+				return data_;
 			}
 
-			// on greedy size we return nullptr
 			if (size_arg_ > max_size_)
-			{
-#ifndef NDEBUG
-				errno = ENOMEM;
-				perror("dbj  strng size too large");
-#endif
-				return nullptr;
-			}
+				DBJ_STRNG_FAIL("size over max_size_");
+
+			char* large_ = allocator_().allocate(size_arg_ + 1);
+			if (large_ == nullptr)
+				DBJ_STRNG_FAIL("allocation failed");
 
-			data_.large = DBJ_CALLOC(char, size_arg_);
-			// on greedy size we return nullptr
-			if (data_.large == nullptr)
+			large_[size_arg_] = 0;
+			set_large_(large_type{ large_, size_arg_, size_arg_ });
+			return large_;
+		}
+
+		/// ------------------------------------------
+		/// room for capacity_ chars, the first size_ are kept
+		/// size is not changed
+		void grow_to_(size_t capacity_, size_t size_) noexcept {
+
+			if (capacity_ > max_size_)
+				DBJ_STRNG_FAIL("size over max_size_");
+
+			if (is_large())
 			{
-#ifndef NDEBUG
-				errno = ENOMEM;
-				perror("dbj  calloc() failed");
-#endif
-				return nullptr;
+				large_type large_ = get_large_();
+				char* grown_ = allocator_().reallocate(large_.data, large_.capacity + 1, capacity_ + 1);
+				if (grown_ == nullptr)
+					DBJ_STRNG_FAIL("reallocation failed");
+				large_.data = grown_;
+				large_.capacity = capacity_;
+				set_large_(large_);
+				return;
 			}
-			this->data_kind_ = kind_tag::large;
-			return data_.large;
+
+			char* large_ = allocator_().allocate(capacity_ + 1);
+			if (large_ == nullptr)
+				DBJ_STRNG_FAIL("allocation failed");
+			memcpy(large_, data_, size_);
+			large_[size_] = 0;
+			set_large_(large_type{ large_, size_, capacity_ });
 		}
+
+		/// room for wanted_ chars, geometric growth
+		void grow_for_(size_t wanted_, size_t size_) noexcept {
+
+			const size_t capacity_ = capacity();
+			if (wanted_ <= capacity_)
+				return;
+			size_t next_ = capacity_ * growth_factor_;
+			if (next_ > max_size_)
+				next_ = max_size_;
+			grow_to_(next_ < wanted_ ? wanted_ : next_, size_);
+		}
+
 		/// ------------------------------------------
-		/// Notice we do not touch this->size here
-		void free_data() {
-			if (data_kind_ == kind_tag::large)
+		void free_data() noexcept {
+			if (is_large())
 			{
-				if (data_.large) {
-					DBJ_FREE(data_.large);
-					data_.large = nullptr;
-				}
-			}
-#ifndef NDEBUG
-			else {
-				memset(data_.small, 0, sizeof( data_.small ));
+				const large_type large_ = get_large_();
+				allocator_().deallocate(large_.data, large_.capacity + 1);
 			}
-#endif // !NDEBUG
 		}
 
-		explicit strng(size_t s_)
-			: size(size_t(s_))
+		allocator_type& allocator_() noexcept { return *this; }
+
+		basic_strng(size_t s_, allocator_type const& allocator_arg_) noexcept
+			: allocator_type(allocator_arg_)
 		{
-			make_data(size);
+			make_data(s_);
 		}
 
 	public:
@@ -134,92 +388,221 @@ namespace dbj {
 Need to understand "copy and swap idiom"?
 Start here: https://stackoverflow.com/a/3279550
 */
-   friend void swap(strng& first, strng& second) // nothrow
-    {
-        // enable ADL (not necessary in our case, but good practice)
-        using std::swap;
-
-        // by swapping the members of two objects,
-        // the two objects are effectively swapped
-        swap(first.size, second.size);
-        swap(first.data_kind_, second.data_kind_);
-        swap(first.data_, second.data_);
-    }
-
-		volatile bool is_large() volatile const noexcept {
-			return this->data_kind_ == kind_tag::large;
+		friend void swap(basic_strng& first, basic_strng& second) noexcept
+		{
+			// the chars go with their allocator
+			using std::swap;
+			swap(first.allocator_(), second.allocator_());
+			// both kinds are just bytes
+			char temp_[storage_size_];
+			memcpy(temp_, first.data_, storage_size_);
+			memcpy(first.data_, second.data_, storage_size_);
+			memcpy(second.data_, temp_, storage_size_);
+		}
+
+		bool is_large() const noexcept {
+			return tag_() == large_tag_;
 		};
 
-		volatile bool is_small() volatile const noexcept {
-			return this->data_kind_ == kind_tag::small;
+		bool is_small() const noexcept {
+			return tag_() != large_tag_;
 		};
 
-		char* data() const {
-			if (data_kind_ == kind_tag::large)
-				return data_.large;
-			return data_.small;
+		char* data() noexcept {
+			if (is_large())
+				return get_large_().data;
+			return data_;
+		}
+
+		const char* data() const noexcept {
+			if (is_large())
+				return get_large_().data;
+			return data_;
+		}
+
+		const char* c_str() const noexcept { return data(); }
+
+		size_t size() const noexcept {
+			if (is_large())
+				return get_large_().size;
+			return small_size_ - tag_();
+		}
+
+		bool empty() const noexcept { return size() == 0; }
+
+		/// chars there is room for, without a heap alloc
+		size_t capacity() const noexcept {
+			if (is_large())
+				return get_large_().capacity;
+			return small_size_;
 		}
 
+		std::string_view view() const noexcept { return { data(), size() }; }
+
+		allocator_type const& get_allocator() const noexcept { return *this; }
+
 		// default ctor
-		strng() noexcept 
-		: size(0), data_kind_( kind_tag::small ), data_{0}
-		{};
-		// no copy
-		strng(strng const&) = delete;
-		strng& operator = (strng const&) = delete;
-
-		// yes move
-		strng(strng&& other_) noexcept
-			: strng()
-			// size(other_.size),
-			// data_kind_(other_.data_kind_)
+		explicit basic_strng(allocator_type const& allocator_arg_ = allocator_type()) noexcept
+			: allocator_type(allocator_arg_)
+		{
+			set_small_(0);
+		}
+
+		explicit basic_strng(std::string_view text_, allocator_type const& allocator_arg_ = allocator_type()) noexcept
+			: allocator_type(allocator_arg_)
+		{
+			memcpy(make_data(text_.size()), text_.data(), text_.size());
+		}
+
+		// small ones are copied as they are
+		// with the allocator of other_
+		basic_strng(basic_strng const& other_) noexcept
+			: allocator_type(other_.get_allocator())
+		{
+			if (other_.is_small())
+			{
+				memcpy(data_, other_.data_, storage_size_);
+				return;
+			}
+			const large_type large_ = other_.get_large_();
+			memcpy(make_data(large_.size), large_.data, large_.size);
+		}
+
+		basic_strng& operator = (basic_strng const& other_) noexcept
+		{
+			if (this != &other_)
+			{
+				basic_strng copy_(other_);
+				swap(*this, copy_);
+			}
+			return *this;
+		}
+
+		// both kinds are moved as bytes, with the allocator, other_ is left empty
+		basic_strng(basic_strng&& other_) noexcept
+			: allocator_type(other_.get_allocator())
 		{
-			swap(*this, other_ );
-			// if (this->is_large()) {
-			// 	this->data_.large = other_.data_.large;
-			// 	other_.data_.large = nullptr;
-			// }
-			// else {
-			// 	errno_t memrez_ =
-			// 		memcpy_s(this->data_.small, strng::small_size_,
-			// 			other_.data_.small, strng::small_size_);
-			// 	if (memrez_ != 0) {
-			// 		perror(__FILE__ "\n\nmemcpy_s() failed?");
-			// 		exit(errno);
-			// 	}
-			// }
-			// other_.size = 0;
-		}
-
-		strng& operator = (strng&& other_) noexcept
+			memcpy(data_, other_.data_, storage_size_);
+			other_.set_small_(0);
+		}
+
+		basic_strng& operator = (basic_strng&& other_) noexcept
 		{
-            swap(*this, other_);
+			if (this != &other_)
+			{
+				free_data();
+				allocator_() = other_.get_allocator();
+				memcpy(data_, other_.data_, storage_size_);
+				other_.set_small_(0);
+			}
 			return *this;
 		}
 
-		~strng() {
+		~basic_strng() {
 			free_data();
 		}
 
-		/// strng can be made only here
+		/// ------------------------------------------
+		/// building
+
+		/// capacity stays
+		void clear() noexcept { set_size_(0); }
+
+		/// room for capacity_ chars, exactly
+		void reserve(size_t capacity_) noexcept {
+			if (capacity_ > capacity())
+				grow_to_(capacity_, size());
+		}
+
+		/// new chars are the filler
+		void resize(size_t size_arg_, char filler_ = 0) noexcept {
+			const size_t size_ = size();
+			if (size_arg_ > size_)
+			{
+				grow_for_(size_arg_, size_);
+				memset(data() + size_, filler_, size_arg_ - size_);
+			}
+			set_size_(size_arg_);
+		}
+
+		basic_strng& push_back(char char_) noexcept {
+			const size_t size_ = size();
+			grow_for_(size_ + 1, size_);
+			data()[size_] = char_;
+			set_size_(size_ + 1);
+			return *this;
+		}
+
+		/// text_ can be a part of this strng
+		basic_strng& append(std::string_view text_) noexcept {
+			const size_t size_ = size();
+			const uintptr_t begin_ = reinterpret_cast<uintptr_t>(data());
+			const uintptr_t from_ = reinterpret_cast<uintptr_t>(text_.data());
+			const bool inside_ = from_ >= begin_ && from_ < begin_ + size_;
+
+			grow_for_(size_ + text_.size(), size_);
+			char* chars_ = data();
+			memcpy(chars_ + size_, inside_ ? chars_ + (from_ - begin_) : text_.data(), text_.size());
+			set_size_(size_ + text_.size());
+			return *this;
+		}
+
+		/// snprintf appended, in place
+		/// formatted once if there is the room, else twice
+		template <
+			typename... Args, size_t max_arguments = 255>
+		basic_strng& format_to(char const* format_, Args... args) noexcept
+		{
+			static_assert(sizeof...(args) < max_arguments, "\n\nmax 255 arguments allowed\n");
+			DBJ_ASSERT(format_);
+
+			const size_t size_ = size();
+			const size_t room_ = capacity() - size_;
+			// terminator of the full small one is the size byte, set_size_ sets it back
+			const int wanted_ = snprintf(data() + size_, room_ + 1, format_, args...);
+			if (wanted_ < 0)
+			{
+				set_size_(size_);
+				return *this;
+			}
+			if (size_t(wanted_) > room_)
+			{
+				grow_for_(size_ + size_t(wanted_), size_);
+				snprintf(data() + size_, size_t(wanted_) + 1, format_, args...);
+			}
+			set_size_(size_ + size_t(wanted_));
+			return *this;
+		}
+
+		/// strng of the size can be made only here
 		/// use callback if provided
-		/// fill with filer char, if provided
+		/// fill with filer char, if provided, else with zeros
 		/// rule no 1: one function should do one thing. yes I know...
-		static strng make
-		(size_t size_arg_, void (*cback)(const char*) = nullptr, const signed char filler_ = 0)
+		static basic_strng make
+		(size_t size_arg_, void (*cback)(const char*) = nullptr, const signed char filler_ = 0,
+			allocator_type const& allocator_arg_ = allocator_type())
 		{
-			strng buf{ size_arg_ };
-			if (filler_) memset(buf.data(), filler_, sizeof(buf.size));
+			basic_strng buf{ size_arg_, allocator_arg_ };
+			memset(buf.data(), filler_, buf.size());
 
 			if (cback) cback(buf.data());
 
 			return buf;
 		}
+
+		/// chars are not set, they are to be written over
+		static basic_strng make_for_overwrite
+		(size_t size_arg_, allocator_type const& allocator_arg_ = allocator_type())
+		{
+			return basic_strng{ size_arg_, allocator_arg_ };
+		}
 	};
+
+	using strng = basic_strng<>;
+	using arena_strng = basic_strng<23, strng_arena_allocator>;
 } // dbj
 
 
-#define DBJSTRING_TEST
 #ifdef DBJSTRING_TEST
 
 #define VT_ESC "\x1b["
@@ -232,98 +615,193 @@ Start here: https://stackoverflow.com/a/3279550
 #define VT_RED VT_ESC "31m"
 #define VT_MAGENTA VT_ESC "35m"
 
-#ifndef _WIN32
-
-#include <unistd.h>
-unsigned int sleep(unsigned int seconds);
-#define SLEEP sleep
-#else
-
-extern "C" {
-	__declspec(dllimport) void __stdcall Sleep(_In_ unsigned long /*dwMilliseconds*/);
-} // "C"
-
-#define SLEEP sleep
-
-#endif
 /*
-this delivers:
-Stack cookie instrumentation code detected a stack-based buffer overrun.
-
-info here:
-https://kallanreed.wordpress.com/2015/02/14/disabling-the-stack-cookie-generation-in-visual-studio-2013/
+the same work for dbj strng and std::string
+make one from the text, copy it, move both into the vector
+clock() is coarse; loop count is thus large
 */
-int main (void) 
-{
+namespace dbj_strng_test {
+
+	constexpr auto loop_count = 0xFFFFF;
+
+	// what the optimizer can not see through
+	static volatile size_t sink_ = 0;
+
+	template <typename string_type>
+	void hammer(std::string_view text_, std::vector<string_type>& out_)
+	{
+		DBJ_REPEAT(loop_count) {
+			out_.clear();
+			string_type made_(text_);
+			string_type copy_(made_);
+			out_.push_back(std::move(made_));
+			out_.push_back(std::move(copy_));
+			sink_ = sink_ + out_.back().size();
+		}
+	}
+
+	template <typename string_type>
+	float measure(const char* prompt_, std::string_view text_)
+	{
+		std::vector<string_type> out_;
+		out_.reserve(2);
+		volatile clock_t time_point_ = clock();
+		hammer<string_type>(text_, out_);
+		float rez = (float)(clock() - time_point_) / CLOCKS_PER_SEC;
+		DBJ_PRINT("%-28s " VT_YELLOW " %.3f sec, " VT_RESET " %.0f dbj's", prompt_, rez, 1000 * rez);
+		return rez;
+	}
+
+	/// log line like, one small piece at the time
+	template <typename string_type>
+	float measure_builder(const char* prompt_, size_t pieces_)
+	{
+		volatile clock_t time_point_ = clock();
+		DBJ_REPEAT(loop_count / pieces_) {
+			string_type line_;
+			DBJ_REPEAT(pieces_) {
+				line_.append(std::string_view("key=value"));
+				line_.push_back(';');
+			}
+			sink_ = sink_ + line_.size();
+		}
+		float rez = (float)(clock() - time_point_) / CLOCKS_PER_SEC;
+		DBJ_PRINT("%-28s " VT_YELLOW " %.3f sec, " VT_RESET " %.0f dbj's", prompt_, rez, 1000 * rez);
+		return rez;
+	}
+
+	/// as the old strng did
+	struct calloc_heap : dbj::strng_heap {
+		char* allocate(size_t size_) noexcept {
+			return static_cast<char*>(calloc(size_, 1));
+		}
+	};
 
+	/// requests of strngs_per_request large strngs, living until the request is done
+	template <typename strng_type, typename make_type, typename done_type>
+	float measure_requests(const char* prompt_, std::string_view text_, make_type make_, done_type done_)
+	{
+		constexpr size_t strngs_per_request = 64;
+		std::vector<strng_type> live_;
+		live_.reserve(strngs_per_request);
+		volatile clock_t time_point_ = clock();
+		DBJ_REPEAT(0xFFFFF / strngs_per_request) {
+			DBJ_REPEAT(strngs_per_request) {
+				strng_type made_ = make_(text_.size());
+				memcpy(made_.data(), text_.data(), text_.size());
+				live_.push_back(std::move(made_));
+			}
+			sink_ = sink_ + live_.back().size();
+			live_.clear();
+			done_();
+		}
+		float rez = (float)(clock() - time_point_) / CLOCKS_PER_SEC;
+		DBJ_PRINT("%-28s " VT_YELLOW " %.3f sec, " VT_RESET " %.0f dbj's", prompt_, rez, 1000 * rez);
+		return rez;
+	}
+
+	template <typename strng_type>
+	void compare(const char* strng_prompt_, std::string_view text_)
+	{
+		DBJ_PRINT(VT_CYAN "%zu chars, inline up to %zu, sizeof %zu" VT_RESET,
+			text_.size(), strng_type::small_size_, sizeof(strng_type));
+		const float dbj_ = measure<strng_type>(strng_prompt_, text_);
+		const float std_ = measure<std::string>("std::string", text_);
+		DBJ_PRINT("%-28s  %s %.2f" VT_RESET, "dbj strng / std::string",
+			dbj_ <= std_ ? VT_GREEN : VT_RED, std_ > 0 ? dbj_ / std_ : 0.0f);
+	}
+} // dbj_strng_test
+
+int main (void)
+{
 		using dbj::strng;
-
-		constexpr auto loop_count = 0xFFFF;
+		using namespace dbj_strng_test;
 
 		DBJ_PRINT("%s", " ");
 		DBJ_PRINT( VT_GREEN "%s" VT_RESET, "testing dbj strng ");
 		DBJ_PRINT("Loop count " VT_MAGENTA " 0x%X" VT_RESET, loop_count);
-		/// ---------------------------------------------------------------------
-		auto driver = [&](auto prompt_, auto specimen)
+
+		const std::string small_(12, '?');
+		const std::string medium_(60, '?');
+		const std::string large_(1024 * 0xF, '?');
+
 		{
-			volatile clock_t time_point_ = clock();
-			specimen();
-			float rez = (float)(clock() - time_point_) / CLOCKS_PER_SEC;
-			DBJ_PRINT("%-20s " VT_YELLOW " %.3f sec, " VT_RESET " %.0f dbj's", prompt_, rez, 1000 * rez);
-		};
+			strng s1(small_);
+			DBJ_ASSERT(s1.is_small() && s1.view() == small_);
+			strng s2(large_);
+			DBJ_ASSERT(s2.is_large() && s2.view() == large_);
+			s1 = s2;
+			DBJ_ASSERT(s1.view() == large_ && s1.c_str()[s1.size()] == 0);
+			strng s3 = strng::make(strng::small_size_, nullptr, '!');
+			DBJ_ASSERT(s3.is_small() && s3.size() == strng::small_size_ && s3.c_str()[s3.size()] == 0);
+
+			strng s4;
+			s4.format_to("%s", small_.c_str()).push_back('+').append(s4.view());
+			DBJ_ASSERT(s4.is_small() && s4.view() == small_ + "+" + small_ + "+");
+			s4.format_to("%d|%s", 42, medium_.c_str());
+			DBJ_ASSERT(s4.is_large() && s4.view() == small_ + "+" + small_ + "+42|" + medium_);
+			s4.append(s4.view()).resize(4, '-');
+			DBJ_ASSERT(s4.view() == small_.substr(0, 4) && s4.capacity() >= 2 * (2 * 13 + 3 + 60));
+			s4.resize(8, '-');
+			DBJ_ASSERT(s4.view() == small_.substr(0, 4) + "----" && s4.c_str()[8] == 0);
+			s4.clear();
+			s4.reserve(1000);
+			DBJ_ASSERT(s4.empty() && s4.capacity() == 1000 && s4.c_str()[0] == 0);
+
+			// small to large, the terminator goes along
+			strng s5(small_);
+			s5.reserve(100);
+			DBJ_ASSERT(s5.is_large() && s5.view() == small_ && s5.c_str()[s5.size()] == 0);
+		}
+
+		compare<strng>("small dbj::strng", small_);
+		compare<dbj::basic_strng<64>>("medium dbj::basic_strng<64>", medium_);
+		compare<dbj::basic_strng<254>>("medium dbj::basic_strng<254>", medium_);
+		compare<strng>("LARGE dbj::strng", large_);
+
+		{
+			dbj::strng_arena arena_;
+			dbj::arena_strng a1(dbj::strng_arena_allocator{ arena_ });
+			a1.append(medium_);
+			const char* first_ = a1.data();
+			// the last one grows in place
+			a1.append(medium_);
+			DBJ_ASSERT(a1.data() == first_ && a1.view() == medium_ + medium_);
+			dbj::arena_strng a2(large_, dbj::strng_arena_allocator{ arena_ });
+			dbj::arena_strng a3(a2);
+			a1.append(a3.view());
+			DBJ_ASSERT(a1.view() == medium_ + medium_ + large_ && a2.view() == a3.view());
+			a1 = dbj::arena_strng(dbj::strng_arena_allocator{ arena_ });
+			a2 = std::move(a3);
+			DBJ_ASSERT(a1.empty() && a3.empty() && a2.view() == large_);
+		}
 
-    const auto large_size_ = strng::small_size_ * 0xF ;
-        DBJ_PRINT("Small size: %d", strng::small_size_ );
-        DBJ_PRINT("Large size: %d", large_size_ );
-
-		// make number of small ones ie size < 1024
-		driver("small dbj::strng",
-			[&] {
-				DBJ_REPEAT(loop_count) {
-					auto hammer = []() {
-						return strng::make(0xFF, nullptr, ' ');
-					};
-					volatile auto s1 = hammer();
-					DBJ_ASSERT(s1.is_small());
-					// Sleep(1);
-				}
-			});
-
-		driver("LARGE dbj::strng",
-			[&] {
-				DBJ_REPEAT(loop_count) {
-					auto hammer = []() {
-						return strng::make(large_size_, nullptr, ' ');
-					};
-					volatile auto s1 = hammer();
-					DBJ_ASSERT(s1.is_large());
-					// Sleep(1);
-				}
-			});
-
-		driver("LARGE std::string",
-			[&] {
-				DBJ_REPEAT(loop_count) {
-					auto hammer = []() {
-						return std::string( large_size_ , '?');
-					};
-					volatile auto s1 = hammer();
-					// DBJ_ASSERT(s1.is_large());
-					// Sleep(1);
-				}
-			});
-
-		driver("LARGE std::vector<char>",
-			[&] {
-				DBJ_REPEAT(loop_count) {
-					auto hammer = []() {
-						return std::vector<char>( large_size_ , '?');
-					};
-					volatile auto s1 = hammer();
-					// DBJ_ASSERT(s1.is_large());
-					// Sleep(1);
-				}
-			});
+		DBJ_PRINT(VT_CYAN "0xFFFFF large strngs, 64 per request" VT_RESET);
+		{
+			const std::string text_(1000, '?');
+			using calloc_strng = dbj::basic_strng<23, calloc_heap>;
+			const float calloc_ = measure_requests<calloc_strng>("calloc", text_,
+				[](size_t size_) { return calloc_strng::make_for_overwrite(size_); }, [] {});
+			measure_requests<strng>("malloc", text_,
+				[](size_t size_) { return strng::make_for_overwrite(size_); }, [] {});
+			dbj::strng_arena arena_;
+			const float arena_rez_ = measure_requests<dbj::arena_strng>("strng_arena", text_,
+				[&](size_t size_) { return dbj::arena_strng::make_for_overwrite(size_, dbj::strng_arena_allocator{ arena_ }); },
+				[&] { arena_.reset(); });
+			DBJ_PRINT("%-28s  %s %.2f" VT_RESET, "arena / calloc",
+				arena_rez_ <= calloc_ ? VT_GREEN : VT_RED, calloc_ > 0 ? arena_rez_ / calloc_ : 0.0f);
+		}
+
+		DBJ_PRINT(VT_CYAN "append and push_back" VT_RESET);
+		for (size_t pieces_ : { 3, 100 })
+		{
+			DBJ_PRINT("%zu pieces, %zu chars", pieces_, pieces_ * 10);
+			const float dbj_ = measure_builder<strng>("dbj::strng", pieces_);
+			const float std_ = measure_builder<std::string>("std::string", pieces_);
+			DBJ_PRINT("%-28s  %s %.2f" VT_RESET, "dbj strng / std::string",
+				dbj_ <= std_ ? VT_GREEN : VT_RED, std_ > 0 ? dbj_ / std_ : 0.0f);
+		}
+		DBJ_PRINT("%s", " ");
 }
 
 
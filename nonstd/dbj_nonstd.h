@@ -16,6 +16,10 @@ namespace dbj
         typedef unsigned __int64 size_t;
         typedef __int64 ptrdiff_t;
         typedef __int64 intptr_t;
+#elif defined(__LP64__) || defined(_LP64)
+        typedef unsigned long size_t;
+        typedef long ptrdiff_t;
+        typedef long intptr_t;
 #else
         typedef unsigned int size_t;
         typedef int ptrdiff_t;
@@ -89,6 +93,34 @@ namespace dbj
         };
 #endif // __clang__
 
+        // STRUCT TEMPLATE remove_cv
+        template <class _Ty>
+        struct remove_cv
+        { // remove top-level const and volatile qualifiers
+            using type = _Ty;
+        };
+
+        template <class _Ty>
+        struct remove_cv<const _Ty>
+        {
+            using type = _Ty;
+        };
+
+        template <class _Ty>
+        struct remove_cv<volatile _Ty>
+        {
+            using type = _Ty;
+        };
+
+        template <class _Ty>
+        struct remove_cv<const volatile _Ty>
+        {
+            using type = _Ty;
+        };
+
+        template <class _Ty>
+        using remove_cv_t = typename remove_cv<_Ty>::type;
+
         // STRUCT TEMPLATE remove_reference
         template <class _Ty>
         struct remove_reference
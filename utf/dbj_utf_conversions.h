@@ -231,13 +231,13 @@ namespace dbj::utf {
                     if (a < 0xA0) return false;
                     break;
                 case 0xED:
-                    if (a > 0x9F) return false;
+                    if (a < 0x80 || a > 0x9F) return false;
                     break;
                 case 0xF0:
                     if (a < 0x90) return false;
                     break;
                 case 0xF4:
-                    if (a > 0x8F) return false;
+                    if (a < 0x80 || a > 0x8F) return false;
                     break;
                 default:
                     if (a < 0x80) return false;
@@ -251,9 +251,10 @@ namespace dbj::utf {
         }
 
         /* --------------------------------------------------------------------- */
+        /* reference, convert_utf8_to_utf16() is in dbj_utf_transcode.h         */
         inline
             conversion_result
-            convert_utf8_to_utf16(const UTF8** sourceStart,
+            convert_utf8_to_utf16_scalar(const UTF8** sourceStart,
                 const UTF8* sourceEnd, UTF16** targetStart,
                 UTF16* targetEnd, conversion_flags flags) {
             conversion_result result = conversionOK;
@@ -345,9 +346,10 @@ namespace dbj::utf {
         }
 
         /* --------------------------------------------------------------------- */
+        /* reference, convert_utf16_to_utf8() is in dbj_utf_transcode.h         */
         inline
             conversion_result
-            convert_utf16_to_utf8(const UTF16** sourceStart,
+            convert_utf16_to_utf8_scalar(const UTF16** sourceStart,
                 const UTF16* sourceEnd, UTF8** targetStart,
                 UTF8* targetEnd, conversion_flags flags) {
             conversion_result result = conversionOK;
@@ -441,9 +443,10 @@ namespace dbj::utf {
 
 
         /* --------------------------------------------------------------------- */
+        /* reference, convert_utf8_to_utf32() is in dbj_utf_transcode.h         */
         inline
             conversion_result
-            convert_utf8_to_utf32(const UTF8** sourceStart,
+            convert_utf8_to_utf32_scalar(const UTF8** sourceStart,
                 const UTF8* sourceEnd, UTF32** targetStart,
                 UTF32* targetEnd, conversion_flags flags) {
             conversion_result result = conversionOK;
@@ -764,4 +767,12 @@ namespace dbj::utf {
 
    --------------------------------------------------------------------- */
 
+/*
+ * fast versions of the *_scalar reference functions above
+ * dbj_utf_validate.h includes it on its own, when it is included first
+ */
+#ifndef DBJ_UTF_VALIDATE_INC
+#include "dbj_utf_transcode.h"
+#endif
+
 #endif  // !LINENOISE_CONVERT_INC
\ No newline at end of file
@@ -2,160 +2,423 @@
 #ifndef DBJ_UTF_CPP_INC
 #define DBJ_UTF_CPP_INC
 
+#include <assert.h>
+#include <string.h>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include "dbj_utf_utils.h"
+#include "dbj_utf_length.h"
 /* 
 C++ dbj utf types using dbj utf functions
+
+Strings of up to 15 code units are kept inside the object, longer ones are
+allocated by the allocator given. All are copyable and noexcept movable.
+
+Allocations and time vs std::basic_string, the DBJ_UTF_CPP_TEST block at
+the bottom
+
+g++ -std=c++17 -O2 -DDBJ_UTF_CPP_TEST -x c++ dbj_utf_cpp.h
 */
 
 namespace dbj::utf {
+
     /*
-    utf32 string is the lowest common denominator
+    storage of the dbj utf strings, always zero terminated
+    size and capacity are in code units, without the terminator
     */
-    class utf32_string final {
+    template <typename unit_type, typename allocator_type>
+    class utf_storage final : private allocator_type {
+
+        using traits_ = std::allocator_traits<allocator_type>;
+
+        static_assert(std::is_same_v<typename traits_::value_type, unit_type>,
+            "allocator must allocate the code units");
+
+        static constexpr bool propagate_move_ =
+            traits_::propagate_on_container_move_assignment::value;
+        static constexpr bool propagate_copy_ =
+            traits_::propagate_on_container_copy_assignment::value;
+        static constexpr bool always_equal_ = traits_::is_always_equal::value;
+
     public:
-        utf32_string() : _length(0), _data(nullptr) {
-            // note: parens intentional, _data must be properly initialized
-            _data = new char32_t[1]();
+        enum : size_t { inline_capacity = 15 };
+
+        explicit utf_storage(const allocator_type& alloc = allocator_type()) noexcept
+            : allocator_type(alloc) {
         }
 
-        explicit utf32_string(const char* src) : _length(0), _data(nullptr) {
-            size_t len = strlen(src);
-            // note: parens intentional, _data must be properly initialized
-            _data = new char32_t[len + 1]();
-            copy_string_8_to_32(_data, len + 1, _length, src);
+        utf_storage(const utf_storage& that)
+            : allocator_type(traits_::select_on_container_copy_construction(that.allocator())) {
+            copy_(that);
         }
 
-        explicit utf32_string(const char8_t* src) 
-            :    utf32_string(reinterpret_cast<const char*>(src))
-        {
+        utf_storage(utf_storage&& that) noexcept
+            : allocator_type(std::move(that.allocator())) {
+            steal_(that);
         }
 
-        explicit utf32_string(const char32_t* src) : _length(0), _data(nullptr) {
-            for (_length = 0; src[_length] != 0; ++_length) {
+        utf_storage& operator=(const utf_storage& that) {
+            if (this != &that) {
+                if constexpr (propagate_copy_ && !always_equal_) {
+                    if (allocator() != that.allocator())
+                        release_();
+                }
+                if constexpr (propagate_copy_)
+                    allocator() = that.allocator();
+                copy_(that);
             }
+            return *this;
+        }
 
-            // note: parens intentional, _data must be properly initialized
-            _data = new char32_t[_length + 1]();
-            memcpy(_data, src, _length * sizeof(char32_t));
+        utf_storage& operator=(utf_storage&& that) noexcept(propagate_move_ || always_equal_) {
+            if (this != &that) {
+                if constexpr (propagate_move_ || always_equal_) {
+                    release_();
+                    if constexpr (propagate_move_)
+                        allocator() = std::move(that.allocator());
+                    steal_(that);
+                }
+                else if (allocator() == that.allocator()) {
+                    release_();
+                    steal_(that);
+                }
+                else {
+                    copy_(that);
+                }
+            }
+            return *this;
         }
 
-        explicit utf32_string(const char32_t* src, int len) : _length(len), _data(nullptr) {
-            // note: parens intentional, _data must be properly initialized
-            _data = new char32_t[len + 1]();
-            memcpy(_data, src, len * sizeof(char32_t));
+        ~utf_storage() { release_(); }
+
+        /* room for size units and the terminator, all zero, previous content is gone */
+        unit_type* reset(size_t size) {
+            if (size > capacity_) {
+                release_();
+                data_ = traits_::allocate(allocator(), size + 1);
+                capacity_ = size;
+            }
+            memset(data_, 0, (size + 1) * sizeof(unit_type));
+            size_ = size;
+            return data_;
         }
 
-        explicit utf32_string(int len) : _length(0), _data(nullptr) {
-            // note: parens intentional, _data must be properly initialized
-            _data = new char32_t[len]();
+        /* shrink to the units actually written */
+        void set_size(size_t size) noexcept {
+            assert(size <= capacity_);
+            size_ = size;
+            data_[size_] = 0;
         }
 
-        explicit utf32_string(const utf32_string& that) : _length(that._length), _data(nullptr) {
-            // note: parens intentional, _data must be properly initialized
-            _data = new char32_t[_length + 1]();
-            memcpy(_data, that._data, sizeof(char32_t) * _length);
+        unit_type* data() const noexcept { return data_; }
+        size_t size() const noexcept { return size_; }
+        size_t capacity() const noexcept { return capacity_; }
+        bool is_inline() const noexcept { return data_ == inline_; }
+
+        allocator_type get_allocator() const noexcept { return allocator(); }
+
+    private:
+        allocator_type& allocator() noexcept { return *this; }
+        const allocator_type& allocator() const noexcept { return *this; }
+
+        void release_() noexcept {
+            if (data_ != inline_)
+                traits_::deallocate(allocator(), data_, capacity_ + 1);
+            data_ = inline_;
+            capacity_ = inline_capacity;
+            size_ = 0;
+            inline_[0] = 0;
         }
 
-        utf32_string& operator=(const utf32_string& that) {
-            if (this != &that) {
-                delete[] _data;
-                _data = new char32_t[that._length]();
-                _length = that._length;
-                memcpy(_data, that._data, sizeof(char32_t) * _length);
+        void copy_(const utf_storage& that) {
+            if (that.size_ > capacity_) {
+                release_();
+                data_ = traits_::allocate(allocator(), that.size_ + 1);
+                capacity_ = that.size_;
             }
+            memcpy(data_, that.data_, (that.size_ + 1) * sizeof(unit_type));
+            size_ = that.size_;
+        }
 
-            return *this;
+        /* that is left empty */
+        void steal_(utf_storage& that) noexcept {
+            if (that.data_ == that.inline_) {
+                memcpy(inline_, that.inline_, sizeof inline_);
+                data_ = inline_;
+                capacity_ = inline_capacity;
+            }
+            else {
+                data_ = that.data_;
+                capacity_ = that.capacity_;
+            }
+            size_ = that.size_;
+            that.data_ = that.inline_;
+            that.capacity_ = inline_capacity;
+            that.size_ = 0;
+            that.inline_[0] = 0;
         }
 
-        ~utf32_string() { delete[] _data; }
+        unit_type* data_{ inline_ };
+        size_t size_{};
+        size_t capacity_{ inline_capacity };
+        unit_type inline_[inline_capacity + 1]{};
+    };
 
+    /*
+    utf32 string is the lowest common denominator
+    */
+    template <typename allocator_type = std::allocator<char32_t>>
+    class basic_utf32_string final {
     public:
-        char32_t* get() const { return _data; }
+        basic_utf32_string() noexcept(noexcept(allocator_type())) : storage_() {}
 
-        size_t length() const { return _length; }
+        explicit basic_utf32_string(const allocator_type& alloc) noexcept : storage_(alloc) {}
 
-        const char32_t& operator[](size_t pos) const { return _data[pos]; }
+        explicit basic_utf32_string(const char* src, const allocator_type& alloc = allocator_type())
+            : storage_(alloc) {
+            size_t len = strlen(src);
+            const UTF8* begin_ = reinterpret_cast<const UTF8*>(src);
+            // exact for valid UTF-8, conversion stops on invalid
+            size_t size_ = utf32_length_from_utf8(begin_, begin_ + len);
+            size_t length_ = 0;
+            copy_string_8_to_32(storage_.reset(size_), size_ + 1, length_, src, len);
+            storage_.set_size(length_);
+        }
 
-        char32_t& operator[](size_t pos) { return _data[pos]; }
+        explicit basic_utf32_string(const char8_t* src, const allocator_type& alloc = allocator_type())
+            :    basic_utf32_string(reinterpret_cast<const char*>(src), alloc)
+        {
+        }
 
-    private:
+        explicit basic_utf32_string(const char32_t* src, const allocator_type& alloc = allocator_type())
+            : basic_utf32_string(src, (int)strlen_32(src), alloc) {
+        }
 
-        void initFromBuffer() {
-            for (_length = 0; _data[_length] != 0; ++_length) {
-            }
+        explicit basic_utf32_string(const char32_t* src, int len, const allocator_type& alloc = allocator_type())
+            : storage_(alloc) {
+            memcpy(storage_.reset(len), src, len * sizeof(char32_t));
         }
 
-        // size_t chars() const { return _length; }
+        /* empty, with the room for len code units */
+        explicit basic_utf32_string(int len, const allocator_type& alloc = allocator_type())
+            : storage_(alloc) {
+            storage_.reset(len);
+            storage_.set_size(0);
+        }
+
+        basic_utf32_string(const basic_utf32_string&) = default;
+        basic_utf32_string(basic_utf32_string&&) noexcept = default;
+        basic_utf32_string& operator=(const basic_utf32_string&) = default;
+        basic_utf32_string& operator=(basic_utf32_string&&) = default;
+
+    public:
+        char32_t* get() const noexcept { return storage_.data(); }
+
+        size_t length() const noexcept { return storage_.size(); }
 
-        size_t _length;
-        char32_t* _data;
+        const char32_t& operator[](size_t pos) const { return storage_.data()[pos]; }
+
+        char32_t& operator[](size_t pos) { return storage_.data()[pos]; }
+
+        allocator_type get_allocator() const noexcept { return storage_.get_allocator(); }
+
+    private:
+        utf_storage<char32_t, allocator_type> storage_;
     };
 
-    class utf8_string final {
-        utf8_string(const utf8_string&) = delete;
-        utf8_string& operator=(const utf8_string&) = delete;
+    using utf32_string = basic_utf32_string<>;
 
+    template <typename allocator_type = std::allocator<char>>
+    class basic_utf8_string final {
     public:
-        utf8_string() = delete;
-
-        explicit utf8_string(const utf32_string& src) 
-            : len_(src.length() * 4 + 1 ),
-            data_(new char[len_])
+        basic_utf8_string() = delete;
 
+        template <typename other_allocator>
+        explicit basic_utf8_string(const basic_utf32_string<other_allocator>& src,
+            const allocator_type& alloc = allocator_type())
+            : storage_(alloc)
         {
-            assert(len_ > 1);
-            assert(data_);
-            copy_string_32_to_8(data_, len_, src.get());
-            assert(data_);
+            const UTF32* begin_ = reinterpret_cast<const UTF32*>(src.get());
+            const size_t len_ = utf8_length_from_utf32(begin_, begin_ + src.length());
+            size_t count_ = 0;
+            copy_string_32_to_8(storage_.reset(len_), len_ + 1, &count_, src.get(), src.length());
+            storage_.set_size(count_);
         }
 
-        ~utf8_string() { delete[] data_; }
+        basic_utf8_string(const basic_utf8_string&) = default;
+        basic_utf8_string(basic_utf8_string&&) noexcept = default;
+        basic_utf8_string& operator=(const basic_utf8_string&) = default;
+        basic_utf8_string& operator=(basic_utf8_string&&) = default;
 
     public:
-        char* get() const noexcept { return data_; }
-        size_t size() const noexcept { return len_;  }
+        char* get() const noexcept { return storage_.data(); }
+        /* with the terminator */
+        size_t size() const noexcept { return storage_.size() + 1; }
+
+        allocator_type get_allocator() const noexcept { return storage_.get_allocator(); }
 
     private:
-        size_t len_{};
-        char* data_{};
+        utf_storage<char, allocator_type> storage_;
     };
 
-    class utf16_string final {
-
-        // no copy
-        utf16_string(const utf16_string&) = delete;
-        utf16_string& operator=(const utf16_string&) = delete;
+    using utf8_string = basic_utf8_string<>;
 
+    template <typename allocator_type = std::allocator<char16_t>>
+    class basic_utf16_string final {
     public:
-        utf16_string() = delete;
-
-        explicit utf16_string(const utf32_string& src) 
-            : len_(src.length() * 2 + 1 ),
-            data_(new char16_t[len_])
+        basic_utf16_string() = delete;
 
+        template <typename other_allocator>
+        explicit basic_utf16_string(const basic_utf32_string<other_allocator>& src,
+            const allocator_type& alloc = allocator_type())
+            : storage_(alloc)
         {
-            assert(len_ > 1);
-            assert(data_);
-            copy_string_32_to_16(data_, len_, src.get());
-            assert(data_);
+            const UTF32* begin_ = reinterpret_cast<const UTF32*>(src.get());
+            const size_t len_ = utf16_length_from_utf32(begin_, begin_ + src.length());
+            size_t count_ = 0;
+            copy_string_32_to_16(storage_.reset(len_), len_ + 1, &count_, src.get(), src.length());
+            storage_.set_size(count_);
         }
 
-        ~utf16_string() { delete[] data_; }
+        basic_utf16_string(const basic_utf16_string&) = default;
+        basic_utf16_string(basic_utf16_string&&) noexcept = default;
+        basic_utf16_string& operator=(const basic_utf16_string&) = default;
+        basic_utf16_string& operator=(basic_utf16_string&&) = default;
 
     public:
 #ifdef WIN32
-        wchar_t * get() const noexcept { return  (wchar_t*)data_ ; }
+        wchar_t * get() const noexcept { return  (wchar_t*)storage_.data() ; }
 #else
-        char16_t* get() const noexcept { return data_; }
+        char16_t* get() const noexcept { return storage_.data(); }
 #endif
 
-        size_t size() const noexcept { return len_;  }
+        /* with the terminator */
+        size_t size() const noexcept { return storage_.size() + 1; }
+
+        allocator_type get_allocator() const noexcept { return storage_.get_allocator(); }
 
     private:
-        size_t len_{};
-        char16_t * data_{};
+        utf_storage<char16_t, allocator_type> storage_;
     };
 
+    using utf16_string = basic_utf16_string<>;
+
 } // namespace dbj::utf
-#endif // !DBJ_UTF_CPP_INC
 
+#ifdef DBJ_UTF_CPP_TEST
+
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+100k random identifiers of 3 to 31 chars, each to utf32, and from that
+to utf8 and utf16; by the dbj utf strings and by std::basic_string doing
+the same conversions. Both take the counting allocator below.
+*/
+namespace dbj_utf_cpp_test {
+
+    inline size_t allocations_ = 0;
+
+    template <typename T>
+    struct counting_allocator {
+        using value_type = T;
+        using is_always_equal = std::true_type;
+
+        counting_allocator() noexcept = default;
+        template <typename U>
+        counting_allocator(const counting_allocator<U>&) noexcept {}
+
+        T* allocate(size_t count_) {
+            ++allocations_;
+            return std::allocator<T>().allocate(count_);
+        }
+        void deallocate(T* p_, size_t count_) noexcept {
+            std::allocator<T>().deallocate(p_, count_);
+        }
+
+        template <typename U>
+        bool operator==(const counting_allocator<U>&) const noexcept { return true; }
+        template <typename U>
+        bool operator!=(const counting_allocator<U>&) const noexcept { return false; }
+    };
+
+    template <typename T>
+    using std_string = std::basic_string<T, std::char_traits<T>, counting_allocator<T>>;
+
+    inline volatile size_t sink_ = 0;
+
+    inline void dbj_strings(std::string const& id_) {
+        using namespace dbj::utf;
+        basic_utf32_string<counting_allocator<char32_t>> wide_(id_.c_str());
+        basic_utf8_string<counting_allocator<char>> narrow_(wide_);
+        basic_utf16_string<counting_allocator<char16_t>> utf16_(wide_);
+        sink_ = sink_ + wide_.length() + narrow_.size() + utf16_.size();
+    }
+
+    inline void std_strings(std::string const& id_) {
+        using namespace dbj::utf;
+        const UTF8* begin_ = reinterpret_cast<const UTF8*>(id_.data());
+        size_t count_ = 0;
+        std_string<char32_t> wide_(utf32_length_from_utf8(begin_, begin_ + id_.size()), 0);
+        copy_string_8_to_32(wide_.data(), wide_.size() + 1, count_, id_.data(), id_.size());
+        wide_.resize(count_);
+
+        const UTF32* wide_begin_ = reinterpret_cast<const UTF32*>(wide_.data());
+        std_string<char> narrow_(utf8_length_from_utf32(wide_begin_, wide_begin_ + wide_.size()), 0);
+        copy_string_32_to_8(narrow_.data(), narrow_.size() + 1, &count_, wide_.data(), wide_.size());
+        narrow_.resize(count_);
+
+        std_string<char16_t> utf16_(utf16_length_from_utf32(wide_begin_, wide_begin_ + wide_.size()), 0);
+        copy_string_32_to_16(utf16_.data(), utf16_.size() + 1, &count_, wide_.data(), wide_.size());
+        utf16_.resize(count_);
+        sink_ = sink_ + wide_.size() + narrow_.size() + utf16_.size();
+    }
+
+    template <typename F>
+    void measure(const char* prompt_, std::vector<std::string> const& ids_, F convert_) {
+        constexpr int repeat_count = 10;
+        const size_t allocations_before_ = allocations_;
+        const auto start_ = std::chrono::steady_clock::now();
+        for (int k = 0; k < repeat_count; ++k)
+            for (std::string const& id_ : ids_)
+                convert_(id_);
+        const double took_ = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+        const double count_ = (double)repeat_count * (double)ids_.size();
+        printf("%-24s %.2f allocations, %6.1f ns per identifier\n", prompt_,
+            (double)(allocations_ - allocations_before_) / count_, took_ / count_);
+    }
+} // dbj_utf_cpp_test
+
+int main(void) {
+    using namespace dbj_utf_cpp_test;
+
+    std::mt19937 random_(3);
+    const char* alphabet_ = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    std::vector<std::string> ids_(100000);
+    size_t inline_count_ = 0;
+    for (std::string& id_ : ids_) {
+        const size_t size_ = 3 + random_() % 29;
+        for (size_t k = 0; k < size_; ++k)
+            id_ += alphabet_[random_() % 37];
+        inline_count_ += size_ <= dbj::utf::utf_storage<char, std::allocator<char>>::inline_capacity;
+    }
+
+    {
+        dbj::utf::utf32_string wide_(ids_[0].c_str());
+        dbj::utf::utf8_string narrow_(wide_);
+        assert(strcmp(narrow_.get(), ids_[0].c_str()) == 0 && narrow_.size() == ids_[0].size() + 1);
+    }
+
+    printf("%zu identifiers, %zu of up to 15 chars\n", ids_.size(), inline_count_);
+    measure("dbj utf strings", ids_, dbj_strings);
+    measure("std::basic_string", ids_, std_strings);
+    return 0;
+}
+
+#endif // DBJ_UTF_CPP_TEST
+
+#endif // !DBJ_UTF_CPP_INC
@@ -0,0 +1,125 @@
+#pragma once
+#ifndef DBJ_UTF_ISA_INC
+#define DBJ_UTF_ISA_INC
+
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    run time instruction set detection for the dbj utf kernels
+
+    DBJ_UTF_NO_SIMD  -- define it to build the scalar code only
+    DBJ_UTF_X86      -- defined here when compiling for x86 or x64 and
+                        DBJ_UTF_NO_SIMD is not defined
+
+    Kernels are compiled for their target ISA through DBJ_UTF_TARGET_*
+    function attributes, thus no special compiler switches are required.
+    Which kernel is actually called is decided once per process, by utf_isa()
+*/
+
+#include <stdint.h>
+
+#if !defined(DBJ_UTF_NO_SIMD) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define DBJ_UTF_X86 1
+#endif
+
+#ifdef DBJ_UTF_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif // DBJ_UTF_X86
+
+// clang (and clang-cl) and GCC will compile intrinsics only inside functions
+// marked with the target ISA; cl.exe does not need (nor know) the attribute
+#undef DBJ_UTF_TARGET
+#if defined(__clang__) || defined(__GNUC__)
+#define DBJ_UTF_TARGET(isa_) __attribute__((target(isa_)))
+#else
+#define DBJ_UTF_TARGET(isa_)
+#endif
+
+#undef DBJ_UTF_TARGET_SSE42
+#define DBJ_UTF_TARGET_SSE42 DBJ_UTF_TARGET("sse4.2,popcnt")
+#undef DBJ_UTF_TARGET_AVX2
+#define DBJ_UTF_TARGET_AVX2 DBJ_UTF_TARGET("avx2,sse4.2,popcnt")
+
+#ifdef __cplusplus
+namespace dbj::utf {
+    extern "C" {
+#endif  // __cplusplus
+
+        typedef enum utf_isa_kind {
+            utf_isa_scalar = 0, /* portable code, word at the time at best */
+            utf_isa_sse42,      /* SSSE3, SSE4.1, SSE4.2 and POPCNT */
+            utf_isa_avx2        /* all of the above plus AVX2 */
+        } utf_isa_kind;
+
+        /* --------------------------------------------------------------------- */
+        inline utf_isa_kind utf_isa_detect(void) {
+#ifdef DBJ_UTF_X86
+            unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+#ifdef _MSC_VER
+            int regs_[4]{};
+            __cpuid(regs_, 0);
+            const unsigned int max_leaf = (unsigned int)regs_[0];
+            __cpuidex(regs_, 1, 0);
+            ecx = (unsigned int)regs_[2];
+#else
+            const unsigned int max_leaf = __get_cpuid_max(0, nullptr);
+            if (max_leaf < 1) return utf_isa_scalar;
+            __cpuid_count(1, 0, eax, ebx, ecx, edx);
+#endif
+            const bool ssse3 = ecx & (1u << 9);
+            const bool sse41 = ecx & (1u << 19);
+            const bool sse42 = ecx & (1u << 20);
+            const bool popcnt = ecx & (1u << 23);
+            const bool osxsave = ecx & (1u << 27);
+            const bool avx = ecx & (1u << 28);
+
+            if (!(ssse3 && sse41 && sse42 && popcnt))
+                return utf_isa_scalar;
+
+            if (!(osxsave && avx) || max_leaf < 7)
+                return utf_isa_sse42;
+
+            /* the OS must save the YMM state too */
+#ifdef _MSC_VER
+            const unsigned long long xcr0 = _xgetbv(0);
+#else
+            unsigned int xcr0_lo = 0, xcr0_hi = 0;
+            __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+            const unsigned long long xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+#endif
+            if ((xcr0 & 6) != 6)
+                return utf_isa_sse42;
+
+#ifdef _MSC_VER
+            __cpuidex(regs_, 7, 0);
+            ebx = (unsigned int)regs_[1];
+#else
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+            const bool avx2 = ebx & (1u << 5);
+            return avx2 ? utf_isa_avx2 : utf_isa_sse42;
+#else  // ! DBJ_UTF_X86
+            return utf_isa_scalar;
+#endif // ! DBJ_UTF_X86
+        }
+
+        /*
+         * Detected once per process. Thread safe as a C++ function static.
+         */
+        inline utf_isa_kind utf_isa(void) {
+            static const utf_isa_kind isa_ = utf_isa_detect();
+            return isa_;
+        }
+
+#ifdef __cplusplus
+    } // "C"
+} // namespace dbj::utf
+#endif  // __cplusplus
+
+#endif  // !DBJ_UTF_ISA_INC
@@ -0,0 +1,507 @@
+#pragma once
+#ifndef DBJ_UTF_LENGTH_INC
+#define DBJ_UTF_LENGTH_INC
+
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    How many code units will the conversion make, before doing it. So that
+    the exact size can be allocated. AVX2, SSE4.2 and scalar kernels, same
+    run time dispatch as in dbj_utf_validate.h
+
+    The results are exact for valid input and for lenient conversions.
+    Strict conversions, conversions of invalid UTF-8 and of UTF-16 ending
+    with the high surrogate stop at the first error, for those the result
+    is the upper bound.
+
+    utf32_length_from_utf8  -- code points, bytes that are not continuations
+    utf16_length_from_utf8  -- plus one for each 4 bytes sequence lead
+    utf8_length_from_utf16  -- 1, 2 or 3 per unit, 4 for the surrogate pair
+    utf32_length_from_utf16 -- units less surrogate pairs
+    utf8_length_from_utf32  -- 1 to 4, 3 for the replacement char
+    utf16_length_from_utf32 -- 1, 2 for the supplementary planes
+
+    Memory, the exact sizes vs the worst case ones allocated before, and
+    the speed of the counting, on ASCII, latin, CJK and emoji, is the
+    DBJ_UTF_LENGTH_TEST block at the bottom
+
+    g++ -std=c++17 -O2 -DDBJ_UTF_LENGTH_TEST -x c++ dbj_utf_length.h
+*/
+
+#include <stddef.h>
+#include "dbj_utf_conversions.h"
+#include "dbj_utf_isa.h"
+
+#ifdef DBJ_UTF_X86
+namespace dbj::utf::simd {
+
+    /* ------------------------------------------------------------------------ */
+    /* SSE4.2                                                                   */
+    /* ------------------------------------------------------------------------ */
+
+    /* continuation bytes are 0x80 .. 0xBF, as signed bytes -128 .. -65 */
+    DBJ_UTF_TARGET_SSE42 inline size_t utf32_length_from_utf8_sse42(const UTF8* source, const UTF8* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 16; source += 16) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            count_ += 16 - _mm_popcnt_u32((unsigned)_mm_movemask_epi8(
+                _mm_cmplt_epi8(in_, _mm_set1_epi8(-64))));
+        }
+        for (; source < sourceEnd; ++source)
+            count_ += (*source & 0xC0) != 0x80;
+        return count_;
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline size_t utf16_length_from_utf8_sse42(const UTF8* source, const UTF8* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 16; source += 16) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const unsigned continuations_ = (unsigned)_mm_movemask_epi8(
+                _mm_cmplt_epi8(in_, _mm_set1_epi8(-64)));
+            /* 0xF0 .. 0xFF, as signed bytes -16 .. -1 */
+            const unsigned four_ = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpgt_epi8(in_, _mm_set1_epi8(-17)), _mm_cmplt_epi8(in_, _mm_setzero_si128())));
+            count_ += 16 - _mm_popcnt_u32(continuations_) + _mm_popcnt_u32(four_);
+        }
+        for (; source < sourceEnd; ++source)
+            count_ += ((*source & 0xC0) != 0x80) + (*source >= 0xF0);
+        return count_;
+    }
+
+    /*
+     * unit bytes is 1 + (u >= 0x80) + (u >= 0x800), the pair is 3 + 3 - 2
+     * last unit of the block is paired with the first unit of the next one
+     */
+    DBJ_UTF_TARGET_SSE42 inline size_t utf8_length_from_utf16_sse42(const UTF16* source, const UTF16* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 8 + 1; source += 8) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const __m128i next_ = _mm_loadu_si128((const __m128i*)(source + 1));
+            const __m128i zero_ = _mm_setzero_si128();
+            const __m128i surrogate_mask_ = _mm_set1_epi16((short)0xFC00);
+            /* two bits per unit */
+            const unsigned one_ = (unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_subs_epu16(in_, _mm_set1_epi16(0x7F)), zero_));
+            const unsigned two_ = (unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_subs_epu16(in_, _mm_set1_epi16(0x7FF)), zero_));
+            const unsigned pairs_ = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpeq_epi16(_mm_and_si128(in_, surrogate_mask_), _mm_set1_epi16((short)0xD800)),
+                _mm_cmpeq_epi16(_mm_and_si128(next_, surrogate_mask_), _mm_set1_epi16((short)0xDC00))));
+            count_ += 3 * 8 - ((_mm_popcnt_u32(one_) + _mm_popcnt_u32(two_) + 2 * _mm_popcnt_u32(pairs_)) >> 1);
+        }
+        for (; source < sourceEnd; ++source) {
+            const UTF16 u_ = *source;
+            count_ += 1 + (u_ >= 0x80) + (u_ >= 0x800);
+            if ((u_ & 0xFC00) == 0xD800 && source + 1 < sourceEnd && (source[1] & 0xFC00) == 0xDC00)
+                count_ -= 2;
+        }
+        return count_;
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline size_t utf32_length_from_utf16_sse42(const UTF16* source, const UTF16* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 8 + 1; source += 8) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const __m128i next_ = _mm_loadu_si128((const __m128i*)(source + 1));
+            const __m128i surrogate_mask_ = _mm_set1_epi16((short)0xFC00);
+            const unsigned pairs_ = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpeq_epi16(_mm_and_si128(in_, surrogate_mask_), _mm_set1_epi16((short)0xD800)),
+                _mm_cmpeq_epi16(_mm_and_si128(next_, surrogate_mask_), _mm_set1_epi16((short)0xDC00))));
+            count_ += 8 - (_mm_popcnt_u32(pairs_) >> 1);
+        }
+        for (; source < sourceEnd; ++source) {
+            ++count_;
+            if ((*source & 0xFC00) == 0xD800 && source + 1 < sourceEnd && (source[1] & 0xFC00) == 0xDC00)
+                --count_;
+        }
+        return count_;
+    }
+
+    /* unsigned a >= b, for 32 bit lanes */
+    DBJ_UTF_TARGET_SSE42 inline __m128i utf32_at_least_sse(__m128i a, __m128i b) {
+        return _mm_cmpeq_epi32(_mm_max_epu32(a, b), a);
+    }
+
+    /* 4 bytes for 0x10000 .. 0x10FFFF, 3 for the replacement char above */
+    DBJ_UTF_TARGET_SSE42 inline size_t utf8_length_from_utf32_sse42(const UTF32* source, const UTF32* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 4; source += 4) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const unsigned two_ = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(
+                utf32_at_least_sse(in_, _mm_set1_epi32(0x80))));
+            const unsigned three_ = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(
+                utf32_at_least_sse(in_, _mm_set1_epi32(0x800))));
+            const unsigned four_ = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(
+                utf32_at_least_sse(in_, _mm_set1_epi32(0x110000)),
+                utf32_at_least_sse(in_, _mm_set1_epi32(0x10000)))));
+            count_ += 4 + _mm_popcnt_u32(two_) + _mm_popcnt_u32(three_) + _mm_popcnt_u32(four_);
+        }
+        for (; source < sourceEnd; ++source) {
+            const UTF32 ch_ = *source;
+            count_ += ch_ < 0x80 ? 1 : ch_ < 0x800 ? 2 : ch_ < 0x10000 ? 3 : ch_ <= LINENOISE_UNI_MAX_LEGAL_UTF32 ? 4 : 3;
+        }
+        return count_;
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline size_t utf16_length_from_utf32_sse42(const UTF32* source, const UTF32* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 4; source += 4) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const __m128i pair_ = _mm_andnot_si128(
+                utf32_at_least_sse(in_, _mm_set1_epi32(0x110000)),
+                utf32_at_least_sse(in_, _mm_set1_epi32(0x10000)));
+            count_ += 4 + _mm_popcnt_u32((unsigned)_mm_movemask_ps(_mm_castsi128_ps(pair_)));
+        }
+        for (; source < sourceEnd; ++source)
+            count_ += 1 + (*source >= 0x10000 && *source <= LINENOISE_UNI_MAX_LEGAL_UTF32);
+        return count_;
+    }
+
+    /* ------------------------------------------------------------------------ */
+    /* AVX2                                                                     */
+    /* ------------------------------------------------------------------------ */
+
+    DBJ_UTF_TARGET_AVX2 inline size_t utf32_length_from_utf8_avx2(const UTF8* source, const UTF8* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 32; source += 32) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            count_ += 32 - _mm_popcnt_u32((unsigned)_mm256_movemask_epi8(
+                _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), in_)));
+        }
+        return count_ + utf32_length_from_utf8_sse42(source, sourceEnd);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline size_t utf16_length_from_utf8_avx2(const UTF8* source, const UTF8* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 32; source += 32) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const unsigned continuations_ = (unsigned)_mm256_movemask_epi8(
+                _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), in_));
+            const unsigned four_ = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpgt_epi8(in_, _mm256_set1_epi8(-17)), _mm256_cmpgt_epi8(_mm256_setzero_si256(), in_)));
+            count_ += 32 - _mm_popcnt_u32(continuations_) + _mm_popcnt_u32(four_);
+        }
+        return count_ + utf16_length_from_utf8_sse42(source, sourceEnd);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline size_t utf8_length_from_utf16_avx2(const UTF16* source, const UTF16* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 16 + 1; source += 16) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const __m256i next_ = _mm256_loadu_si256((const __m256i*)(source + 1));
+            const __m256i zero_ = _mm256_setzero_si256();
+            const __m256i surrogate_mask_ = _mm256_set1_epi16((short)0xFC00);
+            const unsigned one_ = (unsigned)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi16(_mm256_subs_epu16(in_, _mm256_set1_epi16(0x7F)), zero_));
+            const unsigned two_ = (unsigned)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi16(_mm256_subs_epu16(in_, _mm256_set1_epi16(0x7FF)), zero_));
+            const unsigned pairs_ = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi16(_mm256_and_si256(in_, surrogate_mask_), _mm256_set1_epi16((short)0xD800)),
+                _mm256_cmpeq_epi16(_mm256_and_si256(next_, surrogate_mask_), _mm256_set1_epi16((short)0xDC00))));
+            count_ += 3 * 16 - ((_mm_popcnt_u32(one_) + _mm_popcnt_u32(two_) + 2 * _mm_popcnt_u32(pairs_)) >> 1);
+        }
+        return count_ + utf8_length_from_utf16_sse42(source, sourceEnd);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline size_t utf32_length_from_utf16_avx2(const UTF16* source, const UTF16* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 16 + 1; source += 16) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const __m256i next_ = _mm256_loadu_si256((const __m256i*)(source + 1));
+            const __m256i surrogate_mask_ = _mm256_set1_epi16((short)0xFC00);
+            const unsigned pairs_ = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi16(_mm256_and_si256(in_, surrogate_mask_), _mm256_set1_epi16((short)0xD800)),
+                _mm256_cmpeq_epi16(_mm256_and_si256(next_, surrogate_mask_), _mm256_set1_epi16((short)0xDC00))));
+            count_ += 16 - (_mm_popcnt_u32(pairs_) >> 1);
+        }
+        return count_ + utf32_length_from_utf16_sse42(source, sourceEnd);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline __m256i utf32_at_least_avx(__m256i a, __m256i b) {
+        return _mm256_cmpeq_epi32(_mm256_max_epu32(a, b), a);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline size_t utf8_length_from_utf32_avx2(const UTF32* source, const UTF32* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 8; source += 8) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const unsigned two_ = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(
+                utf32_at_least_avx(in_, _mm256_set1_epi32(0x80))));
+            const unsigned three_ = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(
+                utf32_at_least_avx(in_, _mm256_set1_epi32(0x800))));
+            const unsigned four_ = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(
+                utf32_at_least_avx(in_, _mm256_set1_epi32(0x110000)),
+                utf32_at_least_avx(in_, _mm256_set1_epi32(0x10000)))));
+            count_ += 8 + _mm_popcnt_u32(two_) + _mm_popcnt_u32(three_) + _mm_popcnt_u32(four_);
+        }
+        return count_ + utf8_length_from_utf32_sse42(source, sourceEnd);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline size_t utf16_length_from_utf32_avx2(const UTF32* source, const UTF32* sourceEnd) {
+        size_t count_ = 0;
+        for (; sourceEnd - source >= 8; source += 8) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const __m256i pair_ = _mm256_andnot_si256(
+                utf32_at_least_avx(in_, _mm256_set1_epi32(0x110000)),
+                utf32_at_least_avx(in_, _mm256_set1_epi32(0x10000)));
+            count_ += 8 + _mm_popcnt_u32((unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(pair_)));
+        }
+        return count_ + utf16_length_from_utf32_sse42(source, sourceEnd);
+    }
+
+} // namespace dbj::utf::simd
+#endif // DBJ_UTF_X86
+
+#ifdef __cplusplus
+namespace dbj::utf {
+    extern "C" {
+#endif  // __cplusplus
+
+        /* --------------------------------------------------------------------- */
+        /* scalar kernels, the reference                                         */
+        /* --------------------------------------------------------------------- */
+        inline size_t utf32_length_from_utf8_scalar(const UTF8* source, const UTF8* sourceEnd) {
+            size_t count_ = 0;
+            for (; source < sourceEnd; ++source)
+                count_ += (*source & 0xC0) != 0x80;
+            return count_;
+        }
+
+        inline size_t utf16_length_from_utf8_scalar(const UTF8* source, const UTF8* sourceEnd) {
+            size_t count_ = 0;
+            for (; source < sourceEnd; ++source)
+                count_ += ((*source & 0xC0) != 0x80) + (*source >= 0xF0);
+            return count_;
+        }
+
+        inline size_t utf8_length_from_utf16_scalar(const UTF16* source, const UTF16* sourceEnd) {
+            size_t count_ = 0;
+            for (; source < sourceEnd; ++source) {
+                const UTF16 u_ = *source;
+                count_ += 1 + (u_ >= 0x80) + (u_ >= 0x800);
+                /* 3 + 3 for the pair, less 2 */
+                if ((u_ & 0xFC00) == 0xD800 && source + 1 < sourceEnd && (source[1] & 0xFC00) == 0xDC00)
+                    count_ -= 2;
+            }
+            return count_;
+        }
+
+        inline size_t utf32_length_from_utf16_scalar(const UTF16* source, const UTF16* sourceEnd) {
+            size_t count_ = 0;
+            for (; source < sourceEnd; ++source) {
+                ++count_;
+                if ((*source & 0xFC00) == 0xD800 && source + 1 < sourceEnd && (source[1] & 0xFC00) == 0xDC00)
+                    --count_;
+            }
+            return count_;
+        }
+
+        inline size_t utf8_length_from_utf32_scalar(const UTF32* source, const UTF32* sourceEnd) {
+            size_t count_ = 0;
+            for (; source < sourceEnd; ++source) {
+                const UTF32 ch_ = *source;
+                count_ += ch_ < 0x80 ? 1 : ch_ < 0x800 ? 2 : ch_ < 0x10000 ? 3 :
+                    ch_ <= LINENOISE_UNI_MAX_LEGAL_UTF32 ? 4 : 3 /* replacement char */;
+            }
+            return count_;
+        }
+
+        inline size_t utf16_length_from_utf32_scalar(const UTF32* source, const UTF32* sourceEnd) {
+            size_t count_ = 0;
+            for (; source < sourceEnd; ++source)
+                count_ += 1 + (*source >= 0x10000 && *source <= LINENOISE_UNI_MAX_LEGAL_UTF32);
+            return count_;
+        }
+
+        /* --------------------------------------------------------------------- */
+        /* dispatchers                                                           */
+        /* --------------------------------------------------------------------- */
+#undef DBJ_UTF_LENGTH_DISPATCH
+#ifdef DBJ_UTF_X86
+#define DBJ_UTF_LENGTH_DISPATCH(name_, source_, sourceEnd_) \
+            switch (utf_isa()) { \
+            case utf_isa_avx2: return simd::name_##_avx2(source_, sourceEnd_); \
+            case utf_isa_sse42: return simd::name_##_sse42(source_, sourceEnd_); \
+            default: return name_##_scalar(source_, sourceEnd_); \
+            }
+#else
+#define DBJ_UTF_LENGTH_DISPATCH(name_, source_, sourceEnd_) \
+            return name_##_scalar(source_, sourceEnd_)
+#endif
+
+        inline size_t utf32_length_from_utf8(const UTF8* source, const UTF8* sourceEnd) {
+            DBJ_UTF_LENGTH_DISPATCH(utf32_length_from_utf8, source, sourceEnd);
+        }
+
+        inline size_t utf16_length_from_utf8(const UTF8* source, const UTF8* sourceEnd) {
+            DBJ_UTF_LENGTH_DISPATCH(utf16_length_from_utf8, source, sourceEnd);
+        }
+
+        inline size_t utf8_length_from_utf16(const UTF16* source, const UTF16* sourceEnd) {
+            DBJ_UTF_LENGTH_DISPATCH(utf8_length_from_utf16, source, sourceEnd);
+        }
+
+        inline size_t utf32_length_from_utf16(const UTF16* source, const UTF16* sourceEnd) {
+            DBJ_UTF_LENGTH_DISPATCH(utf32_length_from_utf16, source, sourceEnd);
+        }
+
+        inline size_t utf8_length_from_utf32(const UTF32* source, const UTF32* sourceEnd) {
+            DBJ_UTF_LENGTH_DISPATCH(utf8_length_from_utf32, source, sourceEnd);
+        }
+
+        inline size_t utf16_length_from_utf32(const UTF32* source, const UTF32* sourceEnd) {
+            DBJ_UTF_LENGTH_DISPATCH(utf16_length_from_utf32, source, sourceEnd);
+        }
+
+#undef DBJ_UTF_LENGTH_DISPATCH
+
+#ifdef __cplusplus
+    } // "C"
+} // namespace dbj::utf
+#endif  // __cplusplus
+
+#ifdef DBJ_UTF_LENGTH_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+/*
+    ASCII, latin, CJK and emoji, code points at random
+    memory -- buffers of the utf strings for 64 code points, the exact size
+              vs the size they have had before: 4 UTF-8 or 2 UTF-16 units
+              per code point, one UTF-32 unit per source byte
+    speed  -- counting of 1M code points, the scalar reference vs the
+              dispatched kernel, best of 5 runs
+    each count is the count of the conversion, and the same from both
+*/
+namespace dbj_utf_length_test {
+
+    using namespace dbj::utf;
+
+    constexpr size_t short_count = 64;
+    constexpr size_t long_count = 1 << 20;
+    constexpr int runs_count = 5;
+
+    struct corpus final {
+        const char* name;
+        UTF32 first;
+        UTF32 span;
+    };
+
+    inline constexpr corpus corpora[] = {
+        { "ascii", 'a', 26 },
+        { "latin", 0xC0, 0x100 },
+        { "cjk", 0x4E00, 0x5000 },
+        { "emoji", 0x1F600, 0x50 }
+    };
+
+    inline std::vector<UTF32> make_text(corpus const& corpus_, size_t count_) {
+        std::mt19937 random_(7);
+        std::vector<UTF32> text_(count_);
+        for (UTF32& cp_ : text_)
+            cp_ = corpus_.first + random_() % corpus_.span;
+        return text_;
+    }
+
+    template <typename S, typename T, typename C>
+    std::vector<T> convert(C conversion_, std::vector<S> const& source_) {
+        std::vector<T> target_(source_.size() * 4);
+        const S* from_ = source_.data();
+        T* to_ = target_.data();
+        if (conversion_(&from_, from_ + source_.size(), &to_, to_ + target_.size(), strictConversion) != conversionOK) {
+            printf("conversion has failed\n");
+            exit(EXIT_FAILURE);
+        }
+        target_.resize((size_t)(to_ - target_.data()));
+        return target_;
+    }
+
+    inline volatile size_t sink_ = 0;
+
+    // seconds, the best of the runs
+    template <typename F>
+    double best_of(F run_) {
+        double best_ = 1e9;
+        for (int k = 0; k < runs_count; ++k) {
+            const auto start_ = std::chrono::steady_clock::now();
+            sink_ = run_();
+            const double took_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+            best_ = took_ < best_ ? took_ : best_;
+        }
+        return best_;
+    }
+
+    inline void report(const char* prompt_, size_t bytes_, double scalar_, double fast_) {
+        printf("  %-14s scalar %6.2f GB/s, fast %6.2f GB/s\n", prompt_,
+            bytes_ / scalar_ / 1e9, bytes_ / fast_ / 1e9);
+    }
+
+    // the counts of both kernels, and of the conversion, are the same
+    inline bool counts_agree(std::vector<UTF32> const& utf32_, std::vector<UTF8> const& utf8_, std::vector<UTF16> const& utf16_) {
+        const UTF8* b8_ = utf8_.data(), * e8_ = b8_ + utf8_.size();
+        const UTF16* b16_ = utf16_.data(), * e16_ = b16_ + utf16_.size();
+        const UTF32* b32_ = utf32_.data(), * e32_ = b32_ + utf32_.size();
+        return utf32_length_from_utf8(b8_, e8_) == utf32_.size() && utf32_length_from_utf8_scalar(b8_, e8_) == utf32_.size() &&
+            utf16_length_from_utf8(b8_, e8_) == utf16_.size() && utf16_length_from_utf8_scalar(b8_, e8_) == utf16_.size() &&
+            utf8_length_from_utf16(b16_, e16_) == utf8_.size() && utf8_length_from_utf16_scalar(b16_, e16_) == utf8_.size() &&
+            utf32_length_from_utf16(b16_, e16_) == utf32_.size() && utf32_length_from_utf16_scalar(b16_, e16_) == utf32_.size() &&
+            utf8_length_from_utf32(b32_, e32_) == utf8_.size() && utf8_length_from_utf32_scalar(b32_, e32_) == utf8_.size() &&
+            utf16_length_from_utf32(b32_, e32_) == utf16_.size() && utf16_length_from_utf32_scalar(b32_, e32_) == utf16_.size();
+    }
+} // dbj_utf_length_test
+
+int main(void) {
+    using namespace dbj_utf_length_test;
+
+    static const char* isa_names_[] = { "scalar", "SSE4.2", "AVX2" };
+    printf("dispatched to %s\n", isa_names_[utf_isa()]);
+
+    printf("bytes for %zu code points, before -> now\n", short_count);
+    for (corpus const& corpus_ : corpora) {
+        const std::vector<UTF32> utf32_ = make_text(corpus_, short_count);
+        const std::vector<UTF8> utf8_ = convert<UTF32, UTF8>(convert_utf32_to_utf8, utf32_);
+        const std::vector<UTF16> utf16_ = convert<UTF8, UTF16>(convert_utf8_to_utf16, utf8_);
+        if (!counts_agree(utf32_, utf8_, utf16_)) {
+            printf("%s: the counts and the conversions differ\n", corpus_.name);
+            return EXIT_FAILURE;
+        }
+        const UTF32* b32_ = utf32_.data(), * e32_ = b32_ + utf32_.size();
+        const UTF8* b8_ = utf8_.data(), * e8_ = b8_ + utf8_.size();
+        printf("  %-6s utf8_string %4zu -> %4zu, utf16_string %4zu -> %4zu, utf32_string %4zu -> %4zu\n", corpus_.name,
+            (short_count * 4 + 1), (utf8_length_from_utf32(b32_, e32_) + 1),
+            (short_count * 2 + 1) * sizeof(UTF16), (utf16_length_from_utf32(b32_, e32_) + 1) * sizeof(UTF16),
+            (utf8_.size() + 1) * sizeof(UTF32), (utf32_length_from_utf8(b8_, e8_) + 1) * sizeof(UTF32));
+    }
+
+    printf("counting %zu code points\n", long_count);
+    for (corpus const& corpus_ : corpora) {
+        const std::vector<UTF32> utf32_ = make_text(corpus_, long_count);
+        const std::vector<UTF8> utf8_ = convert<UTF32, UTF8>(convert_utf32_to_utf8, utf32_);
+        const std::vector<UTF16> utf16_ = convert<UTF8, UTF16>(convert_utf8_to_utf16, utf8_);
+        if (!counts_agree(utf32_, utf8_, utf16_)) {
+            printf("%s: the counts and the conversions differ\n", corpus_.name);
+            return EXIT_FAILURE;
+        }
+        const UTF8* b8_ = utf8_.data(), * e8_ = b8_ + utf8_.size();
+        const UTF16* b16_ = utf16_.data(), * e16_ = b16_ + utf16_.size();
+        const UTF32* b32_ = utf32_.data(), * e32_ = b32_ + utf32_.size();
+        printf("%s\n", corpus_.name);
+        report("UTF-8 > 32", utf8_.size(),
+            best_of([&] { return utf32_length_from_utf8_scalar(b8_, e8_); }),
+            best_of([&] { return utf32_length_from_utf8(b8_, e8_); }));
+        report("UTF-16 > 8", utf16_.size() * sizeof(UTF16),
+            best_of([&] { return utf8_length_from_utf16_scalar(b16_, e16_); }),
+            best_of([&] { return utf8_length_from_utf16(b16_, e16_); }));
+        report("UTF-32 > 8", utf32_.size() * sizeof(UTF32),
+            best_of([&] { return utf8_length_from_utf32_scalar(b32_, e32_); }),
+            best_of([&] { return utf8_length_from_utf32(b32_, e32_); }));
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif // DBJ_UTF_LENGTH_TEST
+
+#endif  // !DBJ_UTF_LENGTH_INC
@@ -0,0 +1,343 @@
+#pragma once
+#ifndef DBJ_UTF_PARALLEL_INC
+#define DBJ_UTF_PARALLEL_INC
+
+#include <assert.h>
+#include <thread>
+#include <vector>
+#include "dbj_utf_length.h"
+#include "dbj_utf_stream.h"
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    Transcoding of the very large inputs, on all the cores.
+
+    Input is split into chunks, one per worker, at the code point starts.
+    Each worker computes the output size of its chunk, offsets are the sums
+    of the sizes before. Caller allocates the target of the total size, and
+    then each worker converts its chunk straight into its place in the
+    target. There is no merging and no copying.
+
+    dbj::utf::parallel_transcoder<char, char16_t> xcoder_;
+    std::vector<char16_t> out_(xcoder_.plan(data_, size_));
+    auto rez_ = xcoder_.transcode(out_.data(), out_.size());
+
+    Output is the same as of the one convert_X() call over the whole input,
+    status, consumed and produced included. Chunks are converted
+    independently; when one of them is not converted completely, e.g. on
+    ill formed input, everything from that chunk onwards is converted
+    again, serially, from its start.
+
+    From and To are as in the stream_transcoder
+
+    plan() and transcode() each start their own threads, and join them
+    before returning; there is no pool. Thus the chunks should be large,
+    see default_min_chunk. If the thread can not be started the chunks left
+    are done on the calling thread; built without exceptions, that is
+    std::terminate, as everywhere else in std::thread.
+
+    Time from 1 to 16 threads vs one convert_X() call is the
+    DBJ_UTF_PARALLEL_TEST block at the bottom
+
+    g++ -std=c++17 -O2 -pthread -DDBJ_UTF_PARALLEL_TEST -x c++ dbj_utf_parallel.h
+*/
+
+namespace dbj::utf {
+
+    template <typename From, typename To>
+    class parallel_transcoder final {
+
+        static_assert(std::is_integral_v<From> && std::is_integral_v<To>,
+            "code units must be integral types");
+        static_assert(sizeof(From) == 1 || sizeof(From) == 2 || sizeof(From) == 4,
+            "From must be UTF-8, UTF-16 or UTF-32 code unit");
+        static_assert(sizeof(To) == 1 || sizeof(To) == 2 || sizeof(To) == 4,
+            "To must be UTF-8, UTF-16 or UTF-32 code unit");
+        static_assert(sizeof(From) != sizeof(To),
+            "nothing to transcode, use memcpy");
+
+    public:
+        using from_type = From;
+        using to_type = To;
+
+        /* source units, by default smaller chunks are not worth the thread */
+        enum : size_t { default_min_chunk = 1U << 20 };
+
+        struct result final {
+            conversion_result status;
+            size_t consumed; /* source units */
+            size_t produced; /* target units */
+        };
+
+        /* threads 0 is one per core */
+        explicit parallel_transcoder(unsigned threads = 0,
+            conversion_flags flags = lenientConversion, size_t min_chunk = default_min_chunk)
+            : threads_(threads > 0 ? threads : std::thread::hardware_concurrency()),
+            flags_(flags), min_chunk_(min_chunk > 0 ? min_chunk : 1)
+        {
+            if (threads_ == 0) threads_ = 1;
+        }
+
+        /*
+         * Split the source and size the chunks. Returns the number of
+         * target units transcode() needs; exact for well formed input, upper
+         * bound for the rest
+         */
+        size_t plan(const From* source, size_t source_len) {
+            assert(source || source_len == 0);
+            source_ = source;
+            source_len_ = source_len;
+            chunks_.clear();
+
+            size_t count_ = source_len / min_chunk_;
+            if (count_ > threads_) count_ = threads_;
+            if (count_ == 0) count_ = 1;
+
+            const From* const end_ = source + source_len;
+            const From* begin_ = source;
+            for (size_t k = 1; k <= count_; ++k) {
+                const From* split_ = k == count_ ? end_ : code_point_start(source + source_len / count_ * k, end_);
+                if (split_ > begin_)
+                    chunks_.push_back(chunk{ begin_, split_, 0, 0 });
+                begin_ = split_;
+            }
+
+            run(chunks_.size(), [this](size_t k) {
+                chunk& chunk_ = chunks_[k];
+                chunk_.size = length(chunk_.begin, chunk_.end);
+                });
+
+            size_t total_ = 0;
+            for (chunk& chunk_ : chunks_) {
+                chunk_.offset = total_;
+                total_ += chunk_.size;
+            }
+            return total_;
+        }
+
+        /* source given to the last plan() call, into the target */
+        result transcode(To* target, size_t target_len) const {
+            assert(target || target_len == 0);
+            std::vector<result> done_(chunks_.size());
+
+            run(chunks_.size(), [&](size_t k) {
+                const chunk& chunk_ = chunks_[k];
+                const size_t room_ = chunk_.offset >= target_len ? 0 :
+                    target_len - chunk_.offset < chunk_.size ? target_len - chunk_.offset : chunk_.size;
+                const From* src_ = chunk_.begin;
+                To* dst_ = target + chunk_.offset;
+                const conversion_result status_ = convert_units(&src_, chunk_.end, &dst_, dst_ + room_, flags_);
+                done_[k] = result{ status_, (size_t)(src_ - chunk_.begin), (size_t)(dst_ - (target + chunk_.offset)) };
+                });
+
+            for (size_t k = 0; k < chunks_.size(); ++k) {
+                const chunk& chunk_ = chunks_[k];
+                const result& done = done_[k];
+                if (done.status == conversionOK && done.consumed == (size_t)(chunk_.end - chunk_.begin)
+                    && done.produced == chunk_.size)
+                    continue;
+
+                /* all before this chunk are as the serial conversion made them */
+                const From* src_ = chunk_.begin;
+                To* dst_ = target + chunk_.offset;
+                const conversion_result status_ = convert_units(&src_, source_ + source_len_,
+                    &dst_, target + target_len, flags_);
+                return result{ status_, (size_t)(src_ - source_), (size_t)(dst_ - target) };
+            }
+
+            const size_t produced_ = chunks_.empty() ? 0 : chunks_.back().offset + chunks_.back().size;
+            return result{ conversionOK, source_len_, produced_ };
+        }
+
+        /* number of chunks made by the last plan() */
+        size_t chunks() const noexcept { return chunks_.size(); }
+
+        unsigned threads() const noexcept { return threads_; }
+
+        conversion_flags flags() const noexcept { return flags_; }
+
+    private:
+        struct chunk final {
+            const From* begin;
+            const From* end;
+            size_t offset; /* in the target */
+            size_t size;   /* target units */
+        };
+
+        /*
+         * First code point start at or after pos. Any split gives the same
+         * result, this one just keeps the well formed input in one piece
+         */
+        static const From* code_point_start(const From* pos, const From* end) noexcept {
+            if constexpr (sizeof(From) == 1) {
+                for (unsigned k = 0; k < 4 && pos < end && ((UTF8)*pos & 0xC0) == 0x80; ++k)
+                    ++pos;
+            }
+            else if constexpr (sizeof(From) == 2) {
+                if (pos < end && ((UTF16)*pos & 0xFC00) == 0xDC00)
+                    ++pos;
+            }
+            return pos;
+        }
+
+        static size_t length(const From* begin, const From* end) noexcept {
+            if constexpr (sizeof(From) == 1) {
+                const UTF8* b_ = reinterpret_cast<const UTF8*>(begin);
+                const UTF8* e_ = reinterpret_cast<const UTF8*>(end);
+                return sizeof(To) == 2 ? utf16_length_from_utf8(b_, e_) : utf32_length_from_utf8(b_, e_);
+            }
+            else if constexpr (sizeof(From) == 2) {
+                const UTF16* b_ = reinterpret_cast<const UTF16*>(begin);
+                const UTF16* e_ = reinterpret_cast<const UTF16*>(end);
+                return sizeof(To) == 1 ? utf8_length_from_utf16(b_, e_) : utf32_length_from_utf16(b_, e_);
+            }
+            else {
+                const UTF32* b_ = reinterpret_cast<const UTF32*>(begin);
+                const UTF32* e_ = reinterpret_cast<const UTF32*>(end);
+                return sizeof(To) == 1 ? utf8_length_from_utf32(b_, e_) : utf16_length_from_utf32(b_, e_);
+            }
+        }
+
+        /*
+         * job_(0) on this thread, the rest on their own; the ones
+         * without the thread on this thread too
+         */
+        template <typename job_type>
+        static void run(size_t count_, job_type&& job_) {
+            if (count_ == 0) return;
+            std::vector<std::thread> workers_;
+            size_t started_ = 1;
+#ifdef __cpp_exceptions
+            try {
+#endif
+                workers_.reserve(count_ - 1);
+                for (; started_ < count_; ++started_)
+                    workers_.emplace_back(job_, started_);
+#ifdef __cpp_exceptions
+            }
+            catch (...) {
+                /* std::system_error or std::bad_alloc, no more threads */
+            }
+#endif
+            job_(0);
+            for (size_t k = started_; k < count_; ++k)
+                job_(k);
+            for (std::thread& worker_ : workers_)
+                worker_.join();
+        }
+
+        unsigned threads_;
+        conversion_flags flags_;
+        size_t min_chunk_;
+        const From* source_{};
+        size_t source_len_{};
+        std::vector<chunk> chunks_;
+    };
+
+} // namespace dbj::utf
+
+#ifdef DBJ_UTF_PARALLEL_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+/*
+    64M code points of latin with some CJK and emoji, as UTF-8, to UTF-16
+    and back; one convert_X() call vs the parallel transcoder on 1 to 16
+    threads, plan() and transcode() both timed, best of 5 runs.
+    The results are compared with the serial ones first.
+    It scales only as far as the cores, and the memory bandwidth, go.
+*/
+namespace dbj_utf_parallel_test {
+
+    using namespace dbj::utf;
+
+    constexpr size_t code_points_count = 1 << 26;
+    constexpr int runs_count = 5;
+
+    inline std::vector<char> make_text() {
+        std::mt19937 random_(11);
+        std::vector<UTF32> text_(code_points_count);
+        for (UTF32& cp_ : text_) {
+            const unsigned dice_ = random_() % 100;
+            cp_ = dice_ < 70 ? 'a' + random_() % 26 : dice_ < 90 ? 0xC0 + random_() % 0x100 :
+                dice_ < 99 ? 0x4E00 + random_() % 0x5000 : 0x1F600 + random_() % 0x50;
+        }
+        std::vector<char> utf8_(text_.size() * 4);
+        const UTF32* from_ = text_.data();
+        UTF8* to_ = reinterpret_cast<UTF8*>(utf8_.data());
+        convert_utf32_to_utf8(&from_, from_ + text_.size(), &to_, to_ + utf8_.size(), strictConversion);
+        utf8_.resize((size_t)(to_ - reinterpret_cast<UTF8*>(utf8_.data())));
+        return utf8_;
+    }
+
+    // seconds, the best of the runs
+    template <typename F>
+    double best_of(F run_) {
+        double best_ = 1e9;
+        for (int k = 0; k < runs_count; ++k) {
+            const auto start_ = std::chrono::steady_clock::now();
+            run_();
+            const double took_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+            best_ = took_ < best_ ? took_ : best_;
+        }
+        return best_;
+    }
+
+    // into the target of the exact size
+    template <typename From, typename To>
+    size_t serial(std::vector<From> const& source_, std::vector<To>& target_) {
+        const From* from_ = source_.data();
+        To* to_ = target_.data();
+        convert_units(&from_, from_ + source_.size(), &to_, to_ + target_.size(), lenientConversion);
+        return (size_t)(to_ - target_.data());
+    }
+
+    template <typename From, typename To>
+    bool parallel(unsigned threads_, std::vector<From> const& source_, std::vector<To>& target_) {
+        parallel_transcoder<From, To> xcoder_(threads_);
+        if (xcoder_.plan(source_.data(), source_.size()) != target_.size())
+            return false;
+        const auto rez_ = xcoder_.transcode(target_.data(), target_.size());
+        return rez_.status == conversionOK && rez_.consumed == source_.size() && rez_.produced == target_.size();
+    }
+
+    template <typename From, typename To>
+    bool measure(const char* prompt_, std::vector<From> const& source_, std::vector<To> const& expected_) {
+        std::vector<To> target_(expected_.size());
+        for (unsigned threads_ : { 1u, 16u }) {
+            std::fill(target_.begin(), target_.end(), To{});
+            if (!parallel(threads_, source_, target_) || target_ != expected_) {
+                printf("%s: %u threads, differs from the serial conversion\n", prompt_, threads_);
+                return false;
+            }
+        }
+        const double bytes_ = (double)(source_.size() * sizeof(From));
+        const double serial_ = best_of([&] { serial(source_, target_); });
+        printf("%s, %.0f MB\n  serial      %6.2f GB/s\n", prompt_, bytes_ / 1e6, bytes_ / serial_ / 1e9);
+        for (unsigned threads_ : { 1u, 2u, 4u, 8u, 16u }) {
+            const double took_ = best_of([&] { parallel(threads_, source_, target_); });
+            printf("  %2u threads  %6.2f GB/s, x%.2f\n", threads_, bytes_ / took_ / 1e9, serial_ / took_);
+        }
+        return true;
+    }
+} // dbj_utf_parallel_test
+
+int main(void) {
+    using namespace dbj_utf_parallel_test;
+
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    const std::vector<char> utf8_ = make_text();
+    std::vector<char16_t> utf16_(utf8_.size());
+    utf16_.resize(serial(utf8_, utf16_));
+    if (!measure("UTF-8 > 16", utf8_, utf16_) || !measure("UTF-16 > 8", utf16_, utf8_))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+#endif // DBJ_UTF_PARALLEL_TEST
+
+#endif // !DBJ_UTF_PARALLEL_INC
@@ -0,0 +1,353 @@
+#pragma once
+#ifndef DBJ_UTF_STREAM_INC
+#define DBJ_UTF_STREAM_INC
+
+#include <assert.h>
+#include <string.h>
+#include <type_traits>
+#include "dbj_utf_conversions.h"
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    Streaming transcoder. Input comes in arbitrary chunks, e.g. socket or
+    file reads, output goes to the caller's buffers. Sequence cut by the
+    chunk end is kept inside (at most 6 code units) and completed by the
+    next chunk. No allocations, no re-copying of the input.
+
+    From and To are code units: 1, 2 or 4 bytes large, e.g.
+    char, char8_t, UTF8, char16_t, wchar_t on Windows, char32_t, UTF32 ...
+
+    dbj::utf::stream_transcoder<char, wchar_t> xcoder_;
+    while ( size_t got_ = read( chunk_, sizeof chunk_ ) ) {
+        const char * next_ = chunk_ ;
+        do {
+            auto rez_ = xcoder_.transcode( next_, got_, out_, out_size_ );
+            write( out_, rez_.produced );
+            next_ += rez_.consumed ; got_ -= rez_.consumed ;
+            if ( rez_.status == sourceIllegal ) ...
+        } while ( got_ > 0 ) ; // targetExhausted, try again with the rest
+    }
+    if ( xcoder_.finish().status != conversionOK ) ... stream was cut short
+
+    Every chunk split vs the one shot conversion, lone and doubled surrogates
+    included, is the DBJ_UTF_STREAM_TEST block at the bottom
+
+    g++ -std=c++17 -O2 -DDBJ_UTF_STREAM_TEST -x c++ dbj_utf_stream.h
+*/
+
+namespace dbj::utf {
+
+    /*
+     * Pointers are moved through the locals of the exact type, the
+     * reference functions do not see From and To types
+     */
+    template <typename source_unit, typename target_unit, typename From, typename To, typename function_type>
+    inline conversion_result convert_units_call(function_type fun_, const From** source, const From* source_end,
+        To** target, To* target_end, conversion_flags flags_) noexcept {
+        const source_unit* src_ = reinterpret_cast<const source_unit*>(*source);
+        target_unit* dst_ = reinterpret_cast<target_unit*>(*target);
+        const conversion_result rez_ = fun_(&src_, reinterpret_cast<const source_unit*>(source_end),
+            &dst_, reinterpret_cast<target_unit*>(target_end), flags_);
+        *source += src_ - reinterpret_cast<const source_unit*>(*source);
+        *target += dst_ - reinterpret_cast<target_unit*>(*target);
+        return rez_;
+    }
+
+    /* From and To are code units of any type, of 1, 2 or 4 bytes */
+    template <typename From, typename To>
+    inline conversion_result convert_units(const From** source, const From* source_end,
+        To** target, To* target_end, conversion_flags flags_) noexcept {
+        if constexpr (sizeof(From) == 1 && sizeof(To) == 2) {
+            return convert_units_call<UTF8, UTF16>(convert_utf8_to_utf16, source, source_end, target, target_end, flags_);
+        }
+        else if constexpr (sizeof(From) == 1 && sizeof(To) == 4) {
+            return convert_units_call<UTF8, UTF32>(convert_utf8_to_utf32, source, source_end, target, target_end, flags_);
+        }
+        else if constexpr (sizeof(From) == 2 && sizeof(To) == 1) {
+            return convert_units_call<UTF16, UTF8>(convert_utf16_to_utf8, source, source_end, target, target_end, flags_);
+        }
+        else if constexpr (sizeof(From) == 2 && sizeof(To) == 4) {
+            return convert_units_call<UTF16, UTF32>(convert_utf16_to_utf32, source, source_end, target, target_end, flags_);
+        }
+        else if constexpr (sizeof(From) == 4 && sizeof(To) == 1) {
+            return convert_units_call<UTF32, UTF8>(convert_utf32_to_utf8, source, source_end, target, target_end, flags_);
+        }
+        else {
+            return convert_units_call<UTF32, char16_t>(convert_utf32_to_utf16, source, source_end, target, target_end, flags_);
+        }
+    }
+
+    template <typename From, typename To>
+    class stream_transcoder final {
+
+        static_assert(std::is_integral_v<From> && std::is_integral_v<To>,
+            "code units must be integral types");
+        static_assert(sizeof(From) == 1 || sizeof(From) == 2 || sizeof(From) == 4,
+            "From must be UTF-8, UTF-16 or UTF-32 code unit");
+        static_assert(sizeof(To) == 1 || sizeof(To) == 2 || sizeof(To) == 4,
+            "To must be UTF-8, UTF-16 or UTF-32 code unit");
+        static_assert(sizeof(From) != sizeof(To),
+            "nothing to transcode, use memcpy");
+
+        /* longest sequence the reference can report as sourceExhausted */
+        enum : unsigned { carry_capacity = 6 };
+
+    public:
+        using from_type = From;
+        using to_type = To;
+
+        struct result final {
+            conversion_result status;
+            size_t consumed; /* source units, including the ones kept inside */
+            size_t produced; /* target units */
+        };
+
+        explicit stream_transcoder(conversion_flags flags = lenientConversion) noexcept
+            : flags_(flags)
+        {
+        }
+
+        /*
+         * Transcode the chunk into the target. status is
+         *
+         * conversionOK    -- whole chunk consumed; partial sequence at its end
+         *                    (if any) is kept for the next call
+         * targetExhausted -- call again with the rest of the chunk
+         * sourceIllegal   -- illegal sequence starts at source + consumed, or
+         *                    before it, in the units kept from the previous
+         *                    chunk; those are dropped. Caller decides to skip
+         *                    or to stop
+         */
+        result transcode(const From* source, size_t source_len,
+            To* target, size_t target_len) noexcept {
+            assert(source || source_len == 0);
+            assert(target || target_len == 0);
+
+            result rez_{ conversionOK, 0, 0 };
+            const From* src_ = source;
+            const From* const src_end_ = source + source_len;
+            To* dst_ = target;
+            To* const dst_end_ = target + target_len;
+
+            /* the kept units, topped up, until none are left */
+            while (carry_len_ > 0) {
+                /* top up, no more than the kept sequence needs */
+                const unsigned need_ = sequence_length(carry_[0]);
+                const unsigned have_ = (unsigned)(src_end_ - src_);
+                unsigned take_ = need_ > carry_len_ ? need_ - carry_len_ : 0;
+                if (take_ > have_) take_ = have_;
+                From joined_[carry_capacity]{};
+                memcpy(joined_, carry_, carry_len_ * sizeof(From));
+                memcpy(joined_ + carry_len_, src_, take_ * sizeof(From));
+
+                const From* c_ = joined_;
+                conversion_result status_ = convert(&c_, joined_ + carry_len_ + take_,
+                    &dst_, dst_end_, flags_);
+                const unsigned used_ = (unsigned)(c_ - joined_);
+
+                if (status_ == sourceExhausted) {
+                    if (used_ == 0) {
+                        /* still not complete, whole chunk goes inside */
+                        memcpy(carry_ + carry_len_, src_, take_ * sizeof(From));
+                        carry_len_ += take_;
+                        src_ += take_;
+                        rez_.consumed = (size_t)(src_ - source);
+                        rez_.produced = (size_t)(dst_ - target);
+                        return rez_;
+                    }
+                    /*
+                     * the kept sequence was converted on its own, e.g. a lone
+                     * high surrogate in the lenient mode, the one after it is
+                     * incomplete; that one is done below, or on the next turn
+                     */
+                    status_ = conversionOK;
+                }
+                /* target might be too small even for the kept sequence */
+                if (used_ >= carry_len_) {
+                    src_ += used_ - carry_len_;
+                    carry_len_ = 0;
+                }
+                else {
+                    memmove(carry_, carry_ + used_, (carry_len_ - used_) * sizeof(From));
+                    carry_len_ -= used_;
+                }
+                if (status_ != conversionOK) {
+                    if (status_ == sourceIllegal)
+                        carry_len_ = 0;
+                    rez_.status = status_;
+                    rez_.consumed = (size_t)(src_ - source);
+                    rez_.produced = (size_t)(dst_ - target);
+                    return rez_;
+                }
+            }
+
+            const From* s_ = src_;
+            conversion_result status_ = convert(&s_, src_end_, &dst_, dst_end_, flags_);
+
+            if (status_ == sourceExhausted) {
+                /* partial sequence at the end, keep it */
+                assert(src_end_ - s_ <= (ptrdiff_t)carry_capacity);
+                carry_len_ = (unsigned)(src_end_ - s_);
+                memcpy(carry_, s_, carry_len_ * sizeof(From));
+                s_ = src_end_;
+                status_ = conversionOK;
+            }
+
+            rez_.status = status_;
+            rez_.consumed = (size_t)(s_ - source);
+            rez_.produced = (size_t)(dst_ - target);
+            return rez_;
+        }
+
+        /*
+         * End of the stream. sourceExhausted if it was cut in the middle of
+         * the sequence. Kept units are dropped, the transcoder is ready for
+         * the next stream.
+         */
+        result finish() noexcept {
+            const result rez_{ carry_len_ > 0 ? sourceExhausted : conversionOK, 0, 0 };
+            carry_len_ = 0;
+            return rez_;
+        }
+
+        void reset() noexcept { carry_len_ = 0; }
+
+        /* number of source units kept from the previous chunk */
+        size_t pending() const noexcept { return carry_len_; }
+
+        conversion_flags flags() const noexcept { return flags_; }
+
+    private:
+
+        /* the length of the sequence, as the reference sees it, by its first unit */
+        static unsigned sequence_length(From first_) noexcept {
+            if constexpr (sizeof(From) == 1) {
+                return (unsigned)trailing_bytes_for_utf8[(UTF8)first_] + 1;
+            }
+            else if constexpr (sizeof(From) == 2) {
+                const UTF32 ch_ = (UTF16)first_;
+                return (ch_ >= LINENOISE_UNI_SUR_HIGH_START && ch_ <= LINENOISE_UNI_SUR_HIGH_END) ? 2 : 1;
+            }
+            else {
+                return 1;
+            }
+        }
+
+        static conversion_result convert(const From** source, const From* source_end,
+            To** target, To* target_end, conversion_flags flags_) noexcept {
+            return convert_units(source, source_end, target, target_end, flags_);
+        }
+
+        conversion_flags flags_;
+        unsigned carry_len_{};
+        From carry_[carry_capacity]{};
+    };
+
+} // namespace dbj::utf
+
+#ifdef DBJ_UTF_STREAM_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+    each text is cut in two at every place, and in chunks of every size,
+    and streamed through the target of every size from 4 units up.
+    The output must be the one of the one shot conversion, and the
+    stream must never stop moving
+*/
+namespace dbj_utf_stream_test {
+
+    using namespace dbj::utf;
+
+    template <typename From, typename To>
+    std::vector<To> one_shot(std::vector<From> const& text_) {
+        std::vector<To> out_(text_.size() * 4 + 4);
+        const From* from_ = text_.data();
+        To* to_ = out_.data();
+        convert_units(&from_, from_ + text_.size(), &to_, to_ + out_.size(), lenientConversion);
+        out_.resize((size_t)(to_ - out_.data()));
+        return out_;
+    }
+
+    // chunks_ are the chunk ends, false if the stream got stuck
+    template <typename From, typename To>
+    bool streamed(std::vector<From> const& text_, std::vector<size_t> const& chunks_, size_t target_size_,
+        std::vector<To>& out_) {
+        stream_transcoder<From, To> xcoder_;
+        std::vector<To> target_(target_size_);
+        out_.clear();
+        size_t begin_ = 0;
+        for (size_t end_ : chunks_) {
+            const From* next_ = text_.data() + begin_;
+            size_t got_ = end_ - begin_;
+            int idle_ = 0;
+            do {
+                auto rez_ = xcoder_.transcode(next_, got_, target_.data(), target_.size());
+                if (rez_.status != conversionOK && rez_.status != targetExhausted)
+                    return false;
+                out_.insert(out_.end(), target_.begin(), target_.begin() + (ptrdiff_t)rez_.produced);
+                next_ += rez_.consumed;
+                got_ -= rez_.consumed;
+                idle_ = rez_.consumed + rez_.produced > 0 ? 0 : idle_ + 1;
+                if (idle_ > 1)
+                    return false;
+            } while (got_ > 0);
+            begin_ = end_;
+        }
+        xcoder_.finish();
+        return true;
+    }
+
+    template <typename From, typename To>
+    int check(const char* prompt_, std::vector<From> const& text_) {
+        const std::vector<To> expected_ = one_shot<From, To>(text_);
+        std::vector<To> out_;
+        int failed_ = 0;
+        for (size_t target_size_ = 4; target_size_ <= expected_.size() + 4; ++target_size_) {
+            for (size_t cut_ = 0; cut_ <= text_.size(); ++cut_) {
+                if (!streamed(text_, { cut_, text_.size() }, target_size_, out_) || out_ != expected_) {
+                    printf("%s: cut at %zu, target of %zu, differs\n", prompt_, cut_, target_size_);
+                    ++failed_;
+                }
+            }
+            for (size_t chunk_ = 1; chunk_ <= text_.size(); ++chunk_) {
+                std::vector<size_t> chunks_;
+                for (size_t end_ = chunk_; end_ < text_.size() + chunk_; end_ += chunk_)
+                    chunks_.push_back(end_ < text_.size() ? end_ : text_.size());
+                if (!streamed(text_, chunks_, target_size_, out_) || out_ != expected_) {
+                    printf("%s: chunks of %zu, target of %zu, differs\n", prompt_, chunk_, target_size_);
+                    ++failed_;
+                }
+            }
+        }
+        return failed_;
+    }
+} // dbj_utf_stream_test
+
+int main(void) {
+    using namespace dbj_utf_stream_test;
+
+    // a pair, a lone high, a doubled high, a lone low, a high at the very end
+    const std::vector<char16_t> utf16_{ 'a', 0xD83D, 0xDE00, 0xD83D, 'b', 0xD83D, 0xD83D, 'A', 'B',
+        0xDC00, 0x20AC, 0xD83D, 0xD83D, 0xDE01, 0xD83D };
+    // 1 to 4 bytes sequences, the last one cut short
+    const std::vector<char> utf8_{ 'a', '\xC3', '\xA9', '\xE2', '\x82', '\xAC', '\xF0', '\x9F', '\x98', '\x80',
+        'b', '\xE2', '\x82' };
+    const std::vector<char32_t> utf32_{ 'a', 0xE9, 0x20AC, 0x1F600, 'b' };
+
+    int failed_ = 0;
+    failed_ += check<char16_t, char>("UTF-16 > 8", utf16_);
+    failed_ += check<char16_t, char32_t>("UTF-16 > 32", utf16_);
+    failed_ += check<char, char16_t>("UTF-8 > 16", utf8_);
+    failed_ += check<char, char32_t>("UTF-8 > 32", utf8_);
+    failed_ += check<char32_t, char>("UTF-32 > 8", utf32_);
+    failed_ += check<char32_t, char16_t>("UTF-32 > 16", utf32_);
+
+    printf("%s\n", failed_ ? "FAILED" : "all the splits match the one shot conversion");
+    return failed_ ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif // DBJ_UTF_STREAM_TEST
+#endif // !DBJ_UTF_STREAM_INC
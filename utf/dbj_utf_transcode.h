@@ -0,0 +1,1010 @@
+#pragma once
+#ifndef DBJ_UTF_TRANSCODE_INC
+#define DBJ_UTF_TRANSCODE_INC
+
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    Fast versions of the reference conversions from dbj_utf_conversions.h
+    Same names, same signatures, same results. One difference: UTF-16 to
+    UTF-8 on AVX2 and SSE4.2 may write up to 12 bytes after the last one
+    produced, never after the targetEnd. Do not keep anything there.
+
+    Each fast version first runs a kernel over the valid prefix of the
+    source, as long as there is plenty of room in the target. The reference
+    code (the *_scalar function) then continues from where the kernel has
+    stopped, always on a code point boundary. Thus errors, target exhaustion
+    and partial sequences at the end are all reported by the reference code,
+    exactly as before.
+
+    UTF-8 to UTF-32 and UTF-16
+
+    AVX2, SSE4.2 -- source is taken in 64 bytes windows. ASCII windows are
+                    simply widened. Other windows are validated first (see
+                    dbj_utf_validate.h) and then decoded, up to 12 bytes at the
+                    time, with the shuffle tables bellow
+    scalar       -- ASCII is widened 8 bytes at the time, other sequences are
+                    decoded one by one
+
+    UTF-16 to UTF-8
+
+    AVX2, SSE4.2 -- 16 or 8 units at the time. ASCII is narrowed, surrogate
+                    free blocks are encoded 4 code points per shuffle, blocks
+                    with surrogates are done one code point at the time;
+                    4 code points make 4 to 12 bytes, but 16 are stored,
+                    the next step writes over the rest
+    scalar       -- ASCII is narrowed 4 units at the time
+
+    Throughput, the *_scalar reference vs the dispatched version, is the
+    DBJ_UTF_TRANSCODE_TEST block at the bottom
+
+    g++ -std=c++17 -O2 -DDBJ_UTF_TRANSCODE_TEST -x c++ dbj_utf_transcode.h
+*/
+
+#include <string.h>
+#include "dbj_utf_conversions.h"
+#include "dbj_utf_validate.h"
+
+#ifdef __cplusplus
+namespace dbj::utf {
+    extern "C" {
+#endif  // __cplusplus
+
+        /* --------------------------------------------------------------------- */
+        /*
+         * UTF-16 to UTF-8, count units or a bit more, one code point at the
+         * time. Stops in front of unpaired surrogates, which the reference has
+         * to decide about, and in front of a pair cut by the sourceEnd.
+         * Target must have room for count * 3 + 4 bytes. Returns units consumed.
+         */
+        inline unsigned utf16_to_utf8_block(const UTF16* source, unsigned count,
+            const UTF16* sourceEnd, UTF8** out) {
+            unsigned pos_ = 0;
+            while (pos_ < count) {
+                UTF32 ch = source[pos_];
+                if (ch < 0x80) {
+                    *(*out)++ = (UTF8)ch;
+                    ++pos_;
+                }
+                else if (ch < 0x800) {
+                    *(*out)++ = (UTF8)(0xC0 | (ch >> 6));
+                    *(*out)++ = (UTF8)(0x80 | (ch & 0x3F));
+                    ++pos_;
+                }
+                else if (ch < LINENOISE_UNI_SUR_HIGH_START || ch > LINENOISE_UNI_SUR_LOW_END) {
+                    *(*out)++ = (UTF8)(0xE0 | (ch >> 12));
+                    *(*out)++ = (UTF8)(0x80 | ((ch >> 6) & 0x3F));
+                    *(*out)++ = (UTF8)(0x80 | (ch & 0x3F));
+                    ++pos_;
+                }
+                else {
+                    if (ch > LINENOISE_UNI_SUR_HIGH_END || source + pos_ + 1 >= sourceEnd)
+                        break;
+                    const UTF32 ch2 = source[pos_ + 1];
+                    if (ch2 < LINENOISE_UNI_SUR_LOW_START || ch2 > LINENOISE_UNI_SUR_LOW_END)
+                        break;
+                    ch = ((ch - LINENOISE_UNI_SUR_HIGH_START) << linenoise_halfshift) +
+                        (ch2 - LINENOISE_UNI_SUR_LOW_START) + linenoise_halfbase;
+                    *(*out)++ = (UTF8)(0xF0 | (ch >> 18));
+                    *(*out)++ = (UTF8)(0x80 | ((ch >> 12) & 0x3F));
+                    *(*out)++ = (UTF8)(0x80 | ((ch >> 6) & 0x3F));
+                    *(*out)++ = (UTF8)(0x80 | (ch & 0x3F));
+                    pos_ += 2;
+                }
+            }
+            return pos_;
+        }
+
+#ifdef __cplusplus
+    } // "C"
+} // namespace dbj::utf
+#endif  // __cplusplus
+
+#ifdef DBJ_UTF_X86
+namespace dbj::utf::simd {
+
+    /*
+     * UTF-8 decoding shuffles. Input is a 12 bits mask, bit N set if byte N
+     * is the last byte of a code point. There are 3 kinds of shuffles
+     *
+     * utf8_shuffle_6x2  -- first 6 code points are 1 or 2 bytes long,
+     *                      each goes to a 16 bit lane: last byte low, lead high
+     * utf8_shuffle_4x3  -- first 4 code points are 1 to 3 bytes long
+     * utf8_shuffle_3x4  -- first 3 code points are 1 to 4 bytes long
+     *                      each goes to a 32 bit lane: last byte lowest,
+     *                      lead byte highest
+     *
+     * 6x2 is used if possible, then 4x3 and then 3x4. 6x2 pattern number is
+     * made of the bits "is 2 bytes long", 4x3 and 3x4 pattern numbers are made
+     * of base 3 and base 4 digits "length - 1", first code point is the lowest
+     * digit. Empty slots are 0xFF, pshufb makes zeroes out of them.
+     */
+    enum : uint8_t {
+        utf8_shuffle_6x2 = 0,
+        utf8_shuffle_4x3 = 64,
+        utf8_shuffle_3x4 = 64 + 81,
+        utf8_shuffle_none = 64 + 81 + 64
+    };
+
+    struct utf8_decode_tables {
+        /* [ shuffle number, bytes consumed ] for each 12 bits mask */
+        uint8_t index[4096][2];
+        uint8_t shuffle[utf8_shuffle_none + 1][16];
+    };
+
+    constexpr utf8_decode_tables utf8_make_decode_tables() noexcept {
+        utf8_decode_tables tables_{};
+
+        for (int k = 0; k < utf8_shuffle_none + 1; ++k)
+            for (int j = 0; j < 16; ++j)
+                tables_.shuffle[k][j] = 0xFF;
+
+        for (int pattern_ = 0; pattern_ < 64; ++pattern_) {
+            uint8_t* shuffle_ = tables_.shuffle[utf8_shuffle_6x2 + pattern_];
+            int pos_ = 0;
+            for (int cp_ = 0; cp_ < 6; ++cp_) {
+                const int length_ = ((pattern_ >> cp_) & 1) + 1;
+                shuffle_[2 * cp_] = (uint8_t)(pos_ + length_ - 1);
+                if (length_ == 2)
+                    shuffle_[2 * cp_ + 1] = (uint8_t)pos_;
+                pos_ += length_;
+            }
+        }
+
+        for (int pattern_ = 0; pattern_ < 81 + 64; ++pattern_) {
+            const bool is_4x3_ = pattern_ < 81;
+            const int base_ = is_4x3_ ? 3 : 4;
+            uint8_t* shuffle_ = tables_.shuffle[utf8_shuffle_4x3 + pattern_];
+            int digits_ = is_4x3_ ? pattern_ : pattern_ - 81;
+            int pos_ = 0;
+            for (int cp_ = 0; cp_ < (is_4x3_ ? 4 : 3); ++cp_) {
+                const int length_ = digits_ % base_ + 1;
+                digits_ /= base_;
+                for (int byte_ = 0; byte_ < length_; ++byte_)
+                    shuffle_[4 * cp_ + byte_] = (uint8_t)(pos_ + length_ - 1 - byte_);
+                pos_ += length_;
+            }
+        }
+
+        for (int mask_ = 0; mask_ < 4096; ++mask_) {
+            int lengths_[12]{};
+            int count_ = 0, start_ = 0;
+            for (int bit_ = 0; bit_ < 12; ++bit_) {
+                if (mask_ & (1 << bit_)) {
+                    lengths_[count_++] = bit_ - start_ + 1;
+                    start_ = bit_ + 1;
+                }
+            }
+
+            int shuffle_ = utf8_shuffle_none, consumed_ = 0;
+
+            auto fits_ = [&](int cps_, int max_length_) {
+                if (count_ < cps_) return false;
+                for (int k = 0; k < cps_; ++k)
+                    if (lengths_[k] > max_length_) return false;
+                return true;
+            };
+
+            if (fits_(6, 2)) {
+                shuffle_ = utf8_shuffle_6x2;
+                for (int k = 0; k < 6; ++k) {
+                    shuffle_ += (lengths_[k] - 1) << k;
+                    consumed_ += lengths_[k];
+                }
+            }
+            else if (fits_(4, 3) || fits_(3, 4)) {
+                const bool is_4x3_ = fits_(4, 3);
+                const int cps_ = is_4x3_ ? 4 : 3, base_ = is_4x3_ ? 3 : 4;
+                int number_ = 0;
+                for (int k = cps_ - 1; k >= 0; --k) {
+                    number_ = number_ * base_ + (lengths_[k] - 1);
+                    consumed_ += lengths_[k];
+                }
+                shuffle_ = (is_4x3_ ? utf8_shuffle_4x3 : utf8_shuffle_3x4) + number_;
+            }
+
+            tables_.index[mask_][0] = (uint8_t)shuffle_;
+            tables_.index[mask_][1] = (uint8_t)consumed_;
+        }
+        return tables_;
+    }
+
+    alignas(16) inline constexpr utf8_decode_tables utf8_decode = utf8_make_decode_tables();
+
+    /* ------------------------------------------------------------------------ */
+    /* SSE4.2                                                                   */
+    /* ------------------------------------------------------------------------ */
+
+    /* 16 bit lanes, 1 or 2 bytes code points */
+    DBJ_UTF_TARGET_SSE42 inline __m128i utf8_compose_16_sse(__m128i perm) {
+        const __m128i ascii_ = _mm_and_si128(perm, _mm_set1_epi16(0x7F));
+        const __m128i high_ = _mm_and_si128(perm, _mm_set1_epi16(0x1F00));
+        return _mm_or_si128(ascii_, _mm_srli_epi16(high_, 2));
+    }
+
+    /* 32 bit lanes, 1 to 4 bytes code points */
+    DBJ_UTF_TARGET_SSE42 inline __m128i utf8_compose_32_sse(__m128i perm) {
+        const __m128i ascii_ = _mm_and_si128(perm, _mm_set1_epi32(0x7F));
+        const __m128i middle_ = _mm_srli_epi32(_mm_and_si128(perm, _mm_set1_epi32(0x3F00)), 2);
+        /* third byte is a lead 1110____ or a continuation 10______ */
+        __m128i middle_high_ = _mm_and_si128(perm, _mm_set1_epi32(0x3F0000));
+        const __m128i correct_ = _mm_srli_epi32(_mm_and_si128(perm, _mm_set1_epi32(0x400000)), 1);
+        middle_high_ = _mm_srli_epi32(_mm_xor_si128(middle_high_, correct_), 4);
+        const __m128i high_ = _mm_srli_epi32(_mm_and_si128(perm, _mm_set1_epi32(0x07000000)), 6);
+        return _mm_or_si128(_mm_or_si128(ascii_, middle_), _mm_or_si128(middle_high_, high_));
+    }
+
+    /*
+     * Widen 16 ASCII bytes. Overloaded on the target code unit.
+     */
+    DBJ_UTF_TARGET_SSE42 inline void utf8_widen_16_sse(__m128i in, UTF32* out) {
+        _mm_storeu_si128((__m128i*)(out), _mm_cvtepu8_epi32(in));
+        _mm_storeu_si128((__m128i*)(out + 4), _mm_cvtepu8_epi32(_mm_srli_si128(in, 4)));
+        _mm_storeu_si128((__m128i*)(out + 8), _mm_cvtepu8_epi32(_mm_srli_si128(in, 8)));
+        _mm_storeu_si128((__m128i*)(out + 12), _mm_cvtepu8_epi32(_mm_srli_si128(in, 12)));
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline void utf8_widen_16_sse(__m128i in, UTF16* out) {
+        _mm_storeu_si128((__m128i*)(out), _mm_cvtepu8_epi16(in));
+        _mm_storeu_si128((__m128i*)(out + 8), _mm_cvtepu8_epi16(_mm_srli_si128(in, 8)));
+    }
+
+    /*
+     * Decode the start of in, up to 12 bytes. in must be valid UTF-8, starting
+     * on the code point boundary. Writes up to 8 code units, moves out over the
+     * code units made and returns the number of bytes consumed.
+     * Overloaded on the target code unit.
+     */
+    DBJ_UTF_TARGET_SSE42 inline unsigned utf8_decode_sse(__m128i in, unsigned end_mask, UTF32** out) {
+        const uint8_t* index_ = utf8_decode.index[end_mask & 0xFFF];
+        const __m128i perm_ = _mm_shuffle_epi8(in,
+            _mm_load_si128((const __m128i*)utf8_decode.shuffle[index_[0]]));
+        if (index_[0] < utf8_shuffle_4x3) {
+            const __m128i composed_ = utf8_compose_16_sse(perm_);
+            _mm_storeu_si128((__m128i*)(*out), _mm_cvtepu16_epi32(composed_));
+            _mm_storeu_si128((__m128i*)(*out + 4), _mm_cvtepu16_epi32(_mm_srli_si128(composed_, 8)));
+            *out += 6;
+        }
+        else {
+            _mm_storeu_si128((__m128i*)(*out), utf8_compose_32_sse(perm_));
+            *out += (index_[0] < utf8_shuffle_3x4) ? 4 : 3;
+        }
+        return index_[1];
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline unsigned utf8_decode_sse(__m128i in, unsigned end_mask, UTF16** out) {
+        const uint8_t* index_ = utf8_decode.index[end_mask & 0xFFF];
+        const __m128i perm_ = _mm_shuffle_epi8(in,
+            _mm_load_si128((const __m128i*)utf8_decode.shuffle[index_[0]]));
+        if (index_[0] < utf8_shuffle_4x3) {
+            _mm_storeu_si128((__m128i*)(*out), utf8_compose_16_sse(perm_));
+            *out += 6;
+        }
+        else if (index_[0] < utf8_shuffle_3x4) {
+            /* up to 3 bytes, all in the BMP */
+            _mm_storel_epi64((__m128i*)(*out),
+                _mm_packus_epi32(utf8_compose_32_sse(perm_), _mm_setzero_si128()));
+            *out += 4;
+        }
+        else {
+            const __m128i composed_ = utf8_compose_32_sse(perm_);
+            if (_mm_movemask_ps(_mm_castsi128_ps(
+                _mm_cmpgt_epi32(composed_, _mm_set1_epi32(0xFFFF)))) == 0) {
+                _mm_storel_epi64((__m128i*)(*out), _mm_packus_epi32(composed_, _mm_setzero_si128()));
+                *out += 3;
+            }
+            else {
+                alignas(16) UTF32 cps_[4];
+                _mm_store_si128((__m128i*)cps_, composed_);
+                for (int k = 0; k < 3; ++k) {
+                    UTF32 ch = cps_[k];
+                    if (ch <= LINENOISE_UNI_MAX_BMP) {
+                        *(*out)++ = (UTF16)ch;
+                    }
+                    else {
+                        ch -= linenoise_halfbase;
+                        *(*out)++ = (UTF16)((ch >> linenoise_halfshift) + LINENOISE_UNI_SUR_HIGH_START);
+                        *(*out)++ = (UTF16)((ch & linenoise_halfmask) + LINENOISE_UNI_SUR_LOW_START);
+                    }
+                }
+            }
+        }
+        return index_[1];
+    }
+
+    /*
+     * Bit N set for bytes that are not UTF-8 continuations
+     */
+    DBJ_UTF_TARGET_SSE42 inline uint64_t utf8_not_continuation_sse(__m128i in) {
+        return (uint16_t)~_mm_movemask_epi8(_mm_cmplt_epi8(in, _mm_set1_epi8(-64)));
+    }
+
+    /*
+     * Decode one 64 bytes window starting on the code point boundary, that is
+     * already found to be valid. Code points ending in the last 4 bytes of
+     * the window are left for the next one. Returns bytes consumed.
+     * Makes no more code units than there are bytes, plus 8 units of slack.
+     */
+    template <typename unit_type>
+    DBJ_UTF_TARGET_SSE42 inline unsigned utf8_decode_window_sse(
+        const UTF8* window, uint64_t not_ascii, uint64_t not_continuation, unit_type** out) {
+        const uint64_t end_mask_ = not_continuation >> 1;
+        unsigned pos_ = 0;
+        while (pos_ + 16 <= 64) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)(window + pos_));
+            if (((not_ascii >> pos_) & 0xFFFF) == 0) {
+                utf8_widen_16_sse(in_, *out);
+                *out += 16;
+                pos_ += 16;
+                continue;
+            }
+            const unsigned consumed_ = utf8_decode_sse(in_, (unsigned)(end_mask_ >> pos_), out);
+            if (consumed_ == 0) /* can not happen on valid input */
+                break;
+            pos_ += consumed_;
+        }
+        return pos_;
+    }
+
+    /*
+     * UTF-8 to UTF-32 or UTF-16, kernel used by the dispatcher.
+     * Converts the valid prefix, leaves the rest to the reference.
+     */
+    template <typename unit_type>
+    DBJ_UTF_TARGET_SSE42 inline void convert_utf8_sse42(
+        const UTF8** sourceStart, const UTF8* sourceEnd, unit_type** targetStart, unit_type* targetEnd) {
+        const UTF8* source = *sourceStart;
+        unit_type* target = *targetStart;
+        utf8_checker_sse checker_;
+        utf8_checker_init_sse(checker_);
+
+        while (sourceEnd - source >= 64 && targetEnd - target >= 64 + 8) {
+            const __m128i in0_ = _mm_loadu_si128((const __m128i*)(source));
+            const __m128i in1_ = _mm_loadu_si128((const __m128i*)(source + 16));
+            const __m128i in2_ = _mm_loadu_si128((const __m128i*)(source + 32));
+            const __m128i in3_ = _mm_loadu_si128((const __m128i*)(source + 48));
+            const uint64_t not_ascii_ =
+                (uint64_t)(uint16_t)_mm_movemask_epi8(in0_) |
+                (uint64_t)(uint16_t)_mm_movemask_epi8(in1_) << 16 |
+                (uint64_t)(uint16_t)_mm_movemask_epi8(in2_) << 32 |
+                (uint64_t)(uint16_t)_mm_movemask_epi8(in3_) << 48;
+
+            if (not_ascii_ == 0) {
+                utf8_widen_16_sse(in0_, target);
+                utf8_widen_16_sse(in1_, target + 16);
+                utf8_widen_16_sse(in2_, target + 32);
+                utf8_widen_16_sse(in3_, target + 48);
+                source += 64;
+                target += 64;
+                continue;
+            }
+
+            /* window starts on the boundary, nothing comes from before */
+            checker_.error = _mm_setzero_si128();
+            checker_.prev_input = _mm_setzero_si128();
+            checker_.prev_incomplete = _mm_setzero_si128();
+            utf8_check_block_sse(checker_, in0_);
+            utf8_check_block_sse(checker_, in1_);
+            utf8_check_block_sse(checker_, in2_);
+            utf8_check_block_sse(checker_, in3_);
+            if (!utf8_checker_ok_sse(checker_))
+                break;
+
+            const uint64_t not_continuation_ =
+                utf8_not_continuation_sse(in0_) |
+                utf8_not_continuation_sse(in1_) << 16 |
+                utf8_not_continuation_sse(in2_) << 32 |
+                utf8_not_continuation_sse(in3_) << 48;
+
+            const unsigned consumed_ = utf8_decode_window_sse(
+                source, not_ascii_, not_continuation_, &target);
+            if (consumed_ == 0)
+                break;
+            source += consumed_;
+        }
+
+        /* ASCII in the tail */
+        while (sourceEnd - source >= 16 && targetEnd - target >= 16) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            if (_mm_movemask_epi8(in_) != 0)
+                break;
+            utf8_widen_16_sse(in_, target);
+            source += 16;
+            target += 16;
+        }
+
+        *sourceStart = source;
+        *targetStart = target;
+    }
+
+    /*
+     * UTF-16 to UTF-8 shuffles, for 4 BMP code points, each encoded in the
+     * 32 bit lane, lead byte lowest. Pattern number is made of base 3 digits
+     * "length - 1", first code point is the lowest digit. The last byte of
+     * each row is the number of bytes made.
+     */
+    struct utf16_encode_tables {
+        uint8_t shuffle[81][16];
+    };
+
+    constexpr utf16_encode_tables utf16_make_encode_tables() noexcept {
+        utf16_encode_tables tables_{};
+        for (int pattern_ = 0; pattern_ < 81; ++pattern_) {
+            uint8_t* shuffle_ = tables_.shuffle[pattern_];
+            for (int j = 0; j < 16; ++j)
+                shuffle_[j] = 0x80;
+            int digits_ = pattern_, pos_ = 0;
+            for (int cp_ = 0; cp_ < 4; ++cp_) {
+                const int length_ = digits_ % 3 + 1;
+                digits_ /= 3;
+                for (int byte_ = 0; byte_ < length_; ++byte_)
+                    shuffle_[pos_++] = (uint8_t)(4 * cp_ + byte_);
+            }
+            shuffle_[15] = (uint8_t)pos_;
+        }
+        return tables_;
+    }
+
+    alignas(16) inline constexpr utf16_encode_tables utf16_encode = utf16_make_encode_tables();
+
+    /*
+     * Encode 4 BMP non surrogate code points, in 32 bit lanes. Writes 16
+     * bytes, returns how many of them are UTF-8 (4 to 12).
+     */
+    DBJ_UTF_TARGET_SSE42 inline unsigned utf16_encode_4_sse(__m128i cps, UTF8* out) {
+        const __m128i low6_ = _mm_and_si128(cps, _mm_set1_epi32(0x3F));
+        const __m128i mid6_ = _mm_and_si128(_mm_srli_epi32(cps, 6), _mm_set1_epi32(0x3F));
+        /* two bytes: 110xxxxx 10xxxxxx */
+        const __m128i two_ = _mm_or_si128(
+            _mm_or_si128(_mm_srli_epi32(cps, 6), _mm_set1_epi32(0x80C0)),
+            _mm_slli_epi32(low6_, 8));
+        /* three bytes: 1110xxxx 10xxxxxx 10xxxxxx */
+        const __m128i three_ = _mm_or_si128(
+            _mm_or_si128(_mm_srli_epi32(cps, 12), _mm_set1_epi32(0x8080E0)),
+            _mm_or_si128(_mm_slli_epi32(mid6_, 8), _mm_slli_epi32(low6_, 16)));
+
+        const __m128i is_one_ = _mm_cmplt_epi32(cps, _mm_set1_epi32(0x80));
+        const __m128i is_two_ = _mm_cmplt_epi32(cps, _mm_set1_epi32(0x800));
+        const __m128i bytes_ = _mm_blendv_epi8(_mm_blendv_epi8(three_, two_, is_two_), cps, is_one_);
+
+        /* length - 1 per lane is 2 + is_one + is_two, lanes are 0 or -1 */
+        alignas(16) int32_t lengths_[4];
+        _mm_store_si128((__m128i*)lengths_,
+            _mm_add_epi32(_mm_set1_epi32(2), _mm_add_epi32(is_one_, is_two_)));
+        const unsigned pattern_ = lengths_[0] + 3 * lengths_[1] + 9 * lengths_[2] + 27 * lengths_[3];
+
+        const uint8_t* shuffle_ = utf16_encode.shuffle[pattern_];
+        _mm_storeu_si128((__m128i*)out,
+            _mm_shuffle_epi8(bytes_, _mm_load_si128((const __m128i*)shuffle_)));
+        return shuffle_[15];
+    }
+
+    /*
+     * UTF-16 to UTF-8, 8 code units at the time.
+     * Converts up to the first unpaired surrogate, leaves the rest to the
+     * reference. Each step makes at most 8 * 3 + 4 bytes.
+     */
+    DBJ_UTF_TARGET_SSE42 inline void convert_utf16_to_utf8_sse42(
+        const UTF16** sourceStart, const UTF16* sourceEnd, UTF8** targetStart, UTF8* targetEnd) {
+        const UTF16* source = *sourceStart;
+        UTF8* target = *targetStart;
+
+        while (sourceEnd - source >= 8 && targetEnd - target >= 32) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            if (_mm_testz_si128(in_, _mm_set1_epi16((short)0xFF80))) {
+                _mm_storel_epi64((__m128i*)target, _mm_packus_epi16(in_, in_));
+                source += 8;
+                target += 8;
+                continue;
+            }
+            const __m128i surrogates_ = _mm_cmpeq_epi16(
+                _mm_and_si128(in_, _mm_set1_epi16((short)0xF800)), _mm_set1_epi16((short)0xD800));
+            if (_mm_testz_si128(surrogates_, surrogates_)) {
+                target += utf16_encode_4_sse(_mm_cvtepu16_epi32(in_), target);
+                target += utf16_encode_4_sse(_mm_cvtepu16_epi32(_mm_srli_si128(in_, 8)), target);
+                source += 8;
+                continue;
+            }
+            const unsigned consumed_ = utf16_to_utf8_block(source, 8, sourceEnd, &target);
+            source += consumed_;
+            if (consumed_ < 8)
+                break;
+        }
+
+        *sourceStart = source;
+        *targetStart = target;
+    }
+
+    /* ------------------------------------------------------------------------ */
+    /* AVX2                                                                     */
+    /* ------------------------------------------------------------------------ */
+    DBJ_UTF_TARGET_AVX2 inline void utf8_widen_32_avx(const UTF8* in, UTF32* out) {
+        _mm256_storeu_si256((__m256i*)(out), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in))));
+        _mm256_storeu_si256((__m256i*)(out + 8), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + 8))));
+        _mm256_storeu_si256((__m256i*)(out + 16), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + 16))));
+        _mm256_storeu_si256((__m256i*)(out + 24), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + 24))));
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline void utf8_widen_32_avx(const UTF8* in, UTF16* out) {
+        _mm256_storeu_si256((__m256i*)(out), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in))));
+        _mm256_storeu_si256((__m256i*)(out + 16), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in + 16))));
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline uint64_t utf8_not_continuation_avx(__m256i in) {
+        return (uint32_t)~_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-64), in));
+    }
+
+    template <typename unit_type>
+    DBJ_UTF_TARGET_AVX2 inline void convert_utf8_avx2(
+        const UTF8** sourceStart, const UTF8* sourceEnd, unit_type** targetStart, unit_type* targetEnd) {
+        const UTF8* source = *sourceStart;
+        unit_type* target = *targetStart;
+        utf8_checker_avx checker_;
+        utf8_checker_init_avx(checker_);
+
+        while (sourceEnd - source >= 64 && targetEnd - target >= 64 + 8) {
+            const __m256i in0_ = _mm256_loadu_si256((const __m256i*)(source));
+            const __m256i in1_ = _mm256_loadu_si256((const __m256i*)(source + 32));
+            const uint64_t not_ascii_ =
+                (uint64_t)(uint32_t)_mm256_movemask_epi8(in0_) |
+                (uint64_t)(uint32_t)_mm256_movemask_epi8(in1_) << 32;
+
+            if (not_ascii_ == 0) {
+                utf8_widen_32_avx(source, target);
+                utf8_widen_32_avx(source + 32, target + 32);
+                source += 64;
+                target += 64;
+                continue;
+            }
+
+            checker_.error = _mm256_setzero_si256();
+            checker_.prev_input = _mm256_setzero_si256();
+            checker_.prev_incomplete = _mm256_setzero_si256();
+            utf8_check_block_avx(checker_, in0_);
+            utf8_check_block_avx(checker_, in1_);
+            if (!utf8_checker_ok_avx(checker_))
+                break;
+
+            const uint64_t not_continuation_ =
+                utf8_not_continuation_avx(in0_) | utf8_not_continuation_avx(in1_) << 32;
+
+            const unsigned consumed_ = utf8_decode_window_sse(
+                source, not_ascii_, not_continuation_, &target);
+            if (consumed_ == 0)
+                break;
+            source += consumed_;
+        }
+
+        while (sourceEnd - source >= 32 && targetEnd - target >= 32) {
+            if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)source)) != 0)
+                break;
+            utf8_widen_32_avx(source, target);
+            source += 32;
+            target += 32;
+        }
+
+        *sourceStart = source;
+        *targetStart = target;
+    }
+
+    /*
+     * Encode 8 BMP non surrogate code points, in 32 bit lanes. Writes 32
+     * bytes, returns how many of them are UTF-8 (8 to 24).
+     */
+    DBJ_UTF_TARGET_AVX2 inline unsigned utf16_encode_8_avx(__m256i cps, UTF8* out) {
+        const __m256i low6_ = _mm256_and_si256(cps, _mm256_set1_epi32(0x3F));
+        const __m256i mid6_ = _mm256_and_si256(_mm256_srli_epi32(cps, 6), _mm256_set1_epi32(0x3F));
+        const __m256i two_ = _mm256_or_si256(
+            _mm256_or_si256(_mm256_srli_epi32(cps, 6), _mm256_set1_epi32(0x80C0)),
+            _mm256_slli_epi32(low6_, 8));
+        const __m256i three_ = _mm256_or_si256(
+            _mm256_or_si256(_mm256_srli_epi32(cps, 12), _mm256_set1_epi32(0x8080E0)),
+            _mm256_or_si256(_mm256_slli_epi32(mid6_, 8), _mm256_slli_epi32(low6_, 16)));
+
+        const __m256i is_one_ = _mm256_cmpgt_epi32(_mm256_set1_epi32(0x80), cps);
+        const __m256i is_two_ = _mm256_cmpgt_epi32(_mm256_set1_epi32(0x800), cps);
+        const __m256i bytes_ = _mm256_blendv_epi8(_mm256_blendv_epi8(three_, two_, is_two_), cps, is_one_);
+
+        alignas(32) int32_t lengths_[8];
+        _mm256_store_si256((__m256i*)lengths_,
+            _mm256_add_epi32(_mm256_set1_epi32(2), _mm256_add_epi32(is_one_, is_two_)));
+        const unsigned low_ = lengths_[0] + 3 * lengths_[1] + 9 * lengths_[2] + 27 * lengths_[3];
+        const unsigned high_ = lengths_[4] + 3 * lengths_[5] + 9 * lengths_[6] + 27 * lengths_[7];
+
+        const uint8_t* shuffle_low_ = utf16_encode.shuffle[low_];
+        const uint8_t* shuffle_high_ = utf16_encode.shuffle[high_];
+        const __m256i shuffled_ = _mm256_shuffle_epi8(bytes_, _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_load_si128((const __m128i*)shuffle_low_)),
+            _mm_load_si128((const __m128i*)shuffle_high_), 1));
+
+        _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(shuffled_));
+        _mm_storeu_si128((__m128i*)(out + shuffle_low_[15]), _mm256_extracti128_si256(shuffled_, 1));
+        return shuffle_low_[15] + shuffle_high_[15];
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline void convert_utf16_to_utf8_avx2(
+        const UTF16** sourceStart, const UTF16* sourceEnd, UTF8** targetStart, UTF8* targetEnd) {
+        const UTF16* source = *sourceStart;
+        UTF8* target = *targetStart;
+
+        while (sourceEnd - source >= 16 && targetEnd - target >= 64) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            if (_mm256_testz_si256(in_, _mm256_set1_epi16((short)0xFF80))) {
+                const __m128i packed_ = _mm_packus_epi16(
+                    _mm256_castsi256_si128(in_), _mm256_extracti128_si256(in_, 1));
+                _mm_storeu_si128((__m128i*)target, packed_);
+                source += 16;
+                target += 16;
+                continue;
+            }
+            const __m256i surrogates_ = _mm256_cmpeq_epi16(
+                _mm256_and_si256(in_, _mm256_set1_epi16((short)0xF800)), _mm256_set1_epi16((short)0xD800));
+            if (_mm256_testz_si256(surrogates_, surrogates_)) {
+                target += utf16_encode_8_avx(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(in_)), target);
+                target += utf16_encode_8_avx(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(in_, 1)), target);
+                source += 16;
+                continue;
+            }
+            const unsigned consumed_ = utf16_to_utf8_block(source, 16, sourceEnd, &target);
+            source += consumed_;
+            if (consumed_ < 16)
+                break;
+        }
+
+        *sourceStart = source;
+        *targetStart = target;
+    }
+
+} // namespace dbj::utf::simd
+#endif // DBJ_UTF_X86
+
+#ifdef __cplusplus
+namespace dbj::utf {
+    extern "C" {
+#endif  // __cplusplus
+
+        /* --------------------------------------------------------------------- */
+        /*
+         * Portable prefix converters: ASCII 8 bytes (4 UTF-16 units) at the
+         * time, anything else one code point at the time. They stop in front
+         * of anything the reference has to decide about, and when the target
+         * is about to be exhausted.
+         */
+        inline void convert_utf8_to_utf32_word(const UTF8** sourceStart,
+            const UTF8* sourceEnd, UTF32** targetStart, UTF32* targetEnd) {
+            const uint64_t high_bits = 0x8080808080808080ULL;
+            const UTF8* source = *sourceStart;
+            UTF32* target = *targetStart;
+            while (source < sourceEnd && target < targetEnd) {
+                uint64_t word_;
+                while (sourceEnd - source >= 8 && targetEnd - target >= 8) {
+                    memcpy(&word_, source, 8);
+                    if (word_ & high_bits)
+                        break;
+                    for (int k = 0; k < 8; ++k)
+                        target[k] = source[k];
+                    source += 8;
+                    target += 8;
+                }
+                if (source == sourceEnd || target == targetEnd)
+                    break;
+                const UTF8 lead = *source;
+                if (lead < 0x80) {
+                    *target++ = *source++;
+                    continue;
+                }
+                /* the most common, two bytes sequence */
+                if (lead >= 0xC2 && lead <= 0xDF && sourceEnd - source >= 2 &&
+                    (source[1] & 0xC0) == 0x80) {
+                    *target++ = ((UTF32)(lead & 0x1F) << 6) | (source[1] & 0x3F);
+                    source += 2;
+                    continue;
+                }
+                const int length = trailing_bytes_for_utf8[lead] + 1;
+                if (sourceEnd - source <= length - 1 || !is_legal_utf8(source, length))
+                    break;
+                UTF32 ch = 0;
+                switch (length) {
+                case 4: ch += *source++; ch <<= 6; /* fall through */
+                case 3: ch += *source++; ch <<= 6; /* fall through */
+                case 2: ch += *source++; ch <<= 6; /* fall through */
+                default: ch += *source++;
+                }
+                *target++ = ch - offsets_from_utf8[length - 1];
+            }
+            *sourceStart = source;
+            *targetStart = target;
+        }
+
+        /* --------------------------------------------------------------------- */
+        inline void convert_utf8_to_utf16_word(const UTF8** sourceStart,
+            const UTF8* sourceEnd, UTF16** targetStart, UTF16* targetEnd) {
+            const uint64_t high_bits = 0x8080808080808080ULL;
+            const UTF8* source = *sourceStart;
+            UTF16* target = *targetStart;
+            while (source < sourceEnd && target < targetEnd) {
+                uint64_t word_;
+                while (sourceEnd - source >= 8 && targetEnd - target >= 8) {
+                    memcpy(&word_, source, 8);
+                    if (word_ & high_bits)
+                        break;
+                    for (int k = 0; k < 8; ++k)
+                        target[k] = source[k];
+                    source += 8;
+                    target += 8;
+                }
+                if (source == sourceEnd || target == targetEnd)
+                    break;
+                const UTF8 lead = *source;
+                if (lead < 0x80) {
+                    *target++ = *source++;
+                    continue;
+                }
+                if (lead >= 0xC2 && lead <= 0xDF && sourceEnd - source >= 2 &&
+                    (source[1] & 0xC0) == 0x80) {
+                    *target++ = (UTF16)(((lead & 0x1F) << 6) | (source[1] & 0x3F));
+                    source += 2;
+                    continue;
+                }
+                const int length = trailing_bytes_for_utf8[lead] + 1;
+                if (sourceEnd - source <= length - 1 || !is_legal_utf8(source, length))
+                    break;
+                /* surrogates coming from UTF-8 are left to the reference */
+                if (lead == 0xED && source[1] >= 0xA0)
+                    break;
+                if (length == 4 && targetEnd - target < 2)
+                    break;
+                UTF32 ch = 0;
+                switch (length) {
+                case 4: ch += *source++; ch <<= 6; /* fall through */
+                case 3: ch += *source++; ch <<= 6; /* fall through */
+                case 2: ch += *source++; ch <<= 6; /* fall through */
+                default: ch += *source++;
+                }
+                ch -= offsets_from_utf8[length - 1];
+                if (ch <= LINENOISE_UNI_MAX_BMP) {
+                    *target++ = (UTF16)ch;
+                }
+                else {
+                    ch -= linenoise_halfbase;
+                    *target++ = (UTF16)((ch >> linenoise_halfshift) + LINENOISE_UNI_SUR_HIGH_START);
+                    *target++ = (UTF16)((ch & linenoise_halfmask) + LINENOISE_UNI_SUR_LOW_START);
+                }
+            }
+            *sourceStart = source;
+            *targetStart = target;
+        }
+
+        /* --------------------------------------------------------------------- */
+        inline void convert_utf16_to_utf8_word(const UTF16** sourceStart,
+            const UTF16* sourceEnd, UTF8** targetStart, UTF8* targetEnd) {
+            const uint64_t high_bits = 0xFF80FF80FF80FF80ULL;
+            const UTF16* source = *sourceStart;
+            UTF8* target = *targetStart;
+            while (sourceEnd - source >= 4 && targetEnd - target >= 8) {
+                uint64_t word_;
+                memcpy(&word_, source, 8);
+                if ((word_ & high_bits) == 0) {
+                    for (int k = 0; k < 4; ++k)
+                        target[k] = (UTF8)source[k];
+                    source += 4;
+                    target += 4;
+                    continue;
+                }
+                /* 4 units make at most 12 bytes, or 13 if the last one is a pair */
+                if (targetEnd - target < 16)
+                    break;
+                const unsigned consumed_ = utf16_to_utf8_block(source, 4, sourceEnd, &target);
+                source += consumed_;
+                if (consumed_ < 4)
+                    break;
+            }
+            *sourceStart = source;
+            *targetStart = target;
+        }
+
+        /* --------------------------------------------------------------------- */
+        inline
+            conversion_result
+            convert_utf8_to_utf32(const UTF8** sourceStart,
+                const UTF8* sourceEnd, UTF32** targetStart,
+                UTF32* targetEnd, conversion_flags flags) {
+            switch (utf_isa()) {
+#ifdef DBJ_UTF_X86
+            case utf_isa_avx2:
+                simd::convert_utf8_avx2(sourceStart, sourceEnd, targetStart, targetEnd);
+                break;
+            case utf_isa_sse42:
+                simd::convert_utf8_sse42(sourceStart, sourceEnd, targetStart, targetEnd);
+                break;
+#endif // DBJ_UTF_X86
+            default:
+                convert_utf8_to_utf32_word(sourceStart, sourceEnd, targetStart, targetEnd);
+            }
+            return convert_utf8_to_utf32_scalar(sourceStart, sourceEnd, targetStart, targetEnd, flags);
+        }
+
+        /* --------------------------------------------------------------------- */
+        inline
+            conversion_result
+            convert_utf8_to_utf16(const UTF8** sourceStart,
+                const UTF8* sourceEnd, UTF16** targetStart,
+                UTF16* targetEnd, conversion_flags flags) {
+            switch (utf_isa()) {
+#ifdef DBJ_UTF_X86
+            case utf_isa_avx2:
+                simd::convert_utf8_avx2(sourceStart, sourceEnd, targetStart, targetEnd);
+                break;
+            case utf_isa_sse42:
+                simd::convert_utf8_sse42(sourceStart, sourceEnd, targetStart, targetEnd);
+                break;
+#endif // DBJ_UTF_X86
+            default:
+                convert_utf8_to_utf16_word(sourceStart, sourceEnd, targetStart, targetEnd);
+            }
+            return convert_utf8_to_utf16_scalar(sourceStart, sourceEnd, targetStart, targetEnd, flags);
+        }
+
+        /* --------------------------------------------------------------------- */
+        /* up to 12 bytes after *targetStart, and before targetEnd, are scratch */
+        inline
+            conversion_result
+            convert_utf16_to_utf8(const UTF16** sourceStart,
+                const UTF16* sourceEnd, UTF8** targetStart,
+                UTF8* targetEnd, conversion_flags flags) {
+            switch (utf_isa()) {
+#ifdef DBJ_UTF_X86
+            case utf_isa_avx2:
+                simd::convert_utf16_to_utf8_avx2(sourceStart, sourceEnd, targetStart, targetEnd);
+                break;
+            case utf_isa_sse42:
+                simd::convert_utf16_to_utf8_sse42(sourceStart, sourceEnd, targetStart, targetEnd);
+                break;
+#endif // DBJ_UTF_X86
+            default:
+                convert_utf16_to_utf8_word(sourceStart, sourceEnd, targetStart, targetEnd);
+            }
+            return convert_utf16_to_utf8_scalar(sourceStart, sourceEnd, targetStart, targetEnd, flags);
+        }
+
+#ifdef __cplusplus
+    } // "C"
+} // namespace dbj::utf
+#endif  // __cplusplus
+
+#ifdef DBJ_UTF_TRANSCODE_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+/*
+    2M code points of ASCII, of latin with some emoji and of CJK
+    both directions, the reference and the dispatched conversion
+    results are compared first, then timed, best of 5 runs
+*/
+namespace dbj_utf_transcode_test {
+
+    using namespace dbj::utf;
+
+    constexpr size_t code_points_count = 1 << 21;
+    constexpr int runs_count = 5;
+
+    inline std::vector<UTF32> make_text(int profile_) {
+        std::mt19937 random_(42);
+        std::vector<UTF32> text_(code_points_count);
+        for (UTF32& cp_ : text_) {
+            const unsigned dice_ = random_() % 100;
+            if (profile_ == 0)
+                cp_ = 'a' + random_() % 26;
+            else if (profile_ == 1)
+                cp_ = dice_ == 99 ? 0x1F600 + random_() % 50 : dice_ < 70 ? 'a' + random_() % 26 : 0xC0 + random_() % 0x100;
+            else
+                cp_ = dice_ < 10 ? ' ' : 0x4E00 + random_() % 0x5000;
+        }
+        return text_;
+    }
+
+    // seconds, the best of the runs
+    template <typename F>
+    double best_of(F run_) {
+        double best_ = 1e9;
+        for (int k = 0; k < runs_count; ++k) {
+            const auto start_ = std::chrono::steady_clock::now();
+            run_();
+            const double took_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+            best_ = took_ < best_ ? took_ : best_;
+        }
+        return best_;
+    }
+
+    inline void report(const char* prompt_, size_t bytes_, double scalar_, double fast_) {
+        printf("%-14s scalar %6.2f GB/s, fast %6.2f GB/s, x%.1f\n", prompt_,
+            bytes_ / scalar_ / 1e9, bytes_ / fast_ / 1e9, scalar_ / fast_);
+    }
+
+    template <typename S, typename T, typename C>
+    size_t convert(C conversion_, std::vector<S> const& source_, std::vector<T>& target_) {
+        const S* from_ = source_.data();
+        T* to_ = target_.data();
+        const conversion_result rez_ = conversion_(&from_, from_ + source_.size(), &to_, to_ + target_.size(), strictConversion);
+        if (rez_ != conversionOK || from_ != source_.data() + source_.size()) {
+            printf("conversion has failed\n");
+            exit(EXIT_FAILURE);
+        }
+        return (size_t)(to_ - target_.data());
+    }
+
+    /*
+     * into the targets of every size, for the first units of the text;
+     * up to the reference result and nothing is written after 12 bytes
+     * past it
+     */
+    inline bool scratch_is_bounded(std::vector<UTF16> const& utf16_) {
+        constexpr UTF8 untouched_ = 0x5A;
+        const std::vector<UTF16> text_(utf16_.begin(), utf16_.begin() + (utf16_.size() < 512 ? utf16_.size() : 512));
+        for (size_t room_ = 0; room_ <= text_.size() * 3; ++room_) {
+            std::vector<UTF8> reference_(room_, untouched_), fast_(room_, untouched_);
+            const UTF16* from_ = text_.data();
+            UTF8* to_ = reference_.data();
+            const conversion_result reference_rez_ = convert_utf16_to_utf8_scalar(&from_, from_ + text_.size(), &to_, to_ + room_, strictConversion);
+            const size_t reference_size_ = (size_t)(to_ - reference_.data());
+            from_ = text_.data();
+            to_ = fast_.data();
+            const conversion_result fast_rez_ = convert_utf16_to_utf8(&from_, from_ + text_.size(), &to_, to_ + room_, strictConversion);
+            const size_t fast_size_ = (size_t)(to_ - fast_.data());
+            if (fast_rez_ != reference_rez_ || fast_size_ != reference_size_ ||
+                memcmp(fast_.data(), reference_.data(), fast_size_) != 0)
+                return false;
+            for (size_t k = fast_size_ + 12; k < room_; ++k)
+                if (fast_[k] != untouched_)
+                    return false;
+        }
+        return true;
+    }
+} // dbj_utf_transcode_test
+
+int main(void) {
+    using namespace dbj_utf_transcode_test;
+
+    static const char* isa_names_[] = { "scalar", "SSE4.2", "AVX2" };
+    printf("dispatched to %s\n", isa_names_[utf_isa()]);
+
+    static const char* profile_names_[] = { "ascii", "latin+emoji", "cjk" };
+    for (int profile_ = 0; profile_ < 3; ++profile_) {
+        const std::vector<UTF32> text_ = make_text(profile_);
+        std::vector<UTF8> utf8_(text_.size() * 4);
+        std::vector<UTF16> utf16_(text_.size() * 2);
+        utf8_.resize(convert(convert_utf32_to_utf8, text_, utf8_));
+        utf16_.resize(convert(convert_utf8_to_utf16_scalar, utf8_, utf16_));
+
+        std::vector<UTF16> to16_(utf16_.size()), to16_fast_(utf16_.size());
+        std::vector<UTF8> to8_(utf8_.size()), to8_fast_(utf8_.size());
+        if (convert(convert_utf8_to_utf16_scalar, utf8_, to16_) != convert(convert_utf8_to_utf16, utf8_, to16_fast_) ||
+            to16_ != to16_fast_ || to16_ != utf16_ ||
+            convert(convert_utf16_to_utf8_scalar, utf16_, to8_) != convert(convert_utf16_to_utf8, utf16_, to8_fast_) ||
+            to8_ != to8_fast_ || to8_ != utf8_) {
+            printf("%s: the fast and the reference results differ\n", profile_names_[profile_]);
+            return EXIT_FAILURE;
+        }
+        if (!scratch_is_bounded(utf16_)) {
+            printf("%s: UTF-16 > 8 into the small target differs, or writes too far\n", profile_names_[profile_]);
+            return EXIT_FAILURE;
+        }
+
+        printf("%s, %zu UTF-8 bytes, %zu UTF-16 units\n", profile_names_[profile_], utf8_.size(), utf16_.size());
+        report("  UTF-8 > 16", utf8_.size(),
+            best_of([&] { convert(convert_utf8_to_utf16_scalar, utf8_, to16_); }),
+            best_of([&] { convert(convert_utf8_to_utf16, utf8_, to16_fast_); }));
+        report("  UTF-16 > 8", utf16_.size() * sizeof(UTF16),
+            best_of([&] { convert(convert_utf16_to_utf8_scalar, utf16_, to8_); }),
+            best_of([&] { convert(convert_utf16_to_utf8, utf16_, to8_fast_); }));
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif // DBJ_UTF_TRANSCODE_TEST
+
+#endif  // !DBJ_UTF_TRANSCODE_INC
@@ -8,10 +8,10 @@ this is C++ code
 */
 #include "dbj_utf_conversions.h"
 
-#ifdef __cplusplus 
+/*
+overloads bellow, thus no extern "C" here
+*/
 namespace dbj::utf {
-    extern "C" {
-#endif // __cplusplus 
 
 #ifdef __cpp_char8_t
 	// C++20 or modern compiler C++17
@@ -25,10 +25,11 @@ namespace dbj::utf {
 
 #endif // not __cpp_char8_t defined
 
+    /* srcLen is in bytes, src does not need to be zero terminated */
     inline conversion_result copy_string_8_to_32(char32_t* dst, size_t dstSize,
-        size_t& dstCount, const char* src) {
+        size_t& dstCount, const char* src, size_t srcLen) {
         const UTF8* sourceStart = reinterpret_cast<const UTF8*>(src);
-        const UTF8* sourceEnd = sourceStart + strlen(src);
+        const UTF8* sourceEnd = sourceStart + srcLen;
         UTF32* targetStart = reinterpret_cast<UTF32*>(dst);
         UTF32* targetEnd = targetStart + dstSize;
 
@@ -46,6 +47,11 @@ namespace dbj::utf {
         return res;
     }
 
+    inline conversion_result copy_string_8_to_32(char32_t* dst, size_t dstSize,
+        size_t& dstCount, const char* src) {
+        return copy_string_8_to_32(dst, dstSize, dstCount, src, strlen(src));
+    }
+
     inline conversion_result copy_string_8_to_32(char32_t* dst, size_t dstSize,
         size_t& dstCount, const char8_t* src) {
         return copy_string_8_to_32(dst, dstSize, dstCount,
@@ -67,7 +73,11 @@ namespace dbj::utf {
     }
 
     inline char8_t* strdup8(const char* src) {
+#ifdef _MSC_VER
         return reinterpret_cast<char8_t*>(_strdup(src));
+#else
+        return reinterpret_cast<char8_t*>(strdup(src));
+#endif
     }
 
     inline void copy_string_32_to_16
@@ -143,10 +153,7 @@ namespace dbj::utf {
         return 0;
     }
 
-#ifdef __cplusplus 
-} //    extern "C" 
 } // namespace dbj::utf 
-#endif // __cplusplus 
 
 #endif // !DBJ_UTF_UTILS_INC
 
@@ -0,0 +1,411 @@
+#pragma once
+#ifndef DBJ_UTF_VALIDATE_INC
+#define DBJ_UTF_VALIDATE_INC
+
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    UTF-8 validation of whole buffers
+
+    is_legal_utf8_buffer_scalar() is the reference; it walks the buffer
+    one sequence at the time using is_legal_utf8_sequence()
+
+    is_legal_utf8_buffer() returns the same verdict, but it is using
+    the best kernel available on the machine:
+
+    AVX2, SSE4.2 -- the "lookup" algorithm from
+                    John Keiser, Daniel Lemire, "Validating UTF-8 In Less
+                    Than One Instruction Per Byte", 2020
+                    https://arxiv.org/abs/2010.03090
+    scalar       -- ASCII is skipped 8 bytes at the time, everything else
+                    is checked by is_legal_utf8()
+*/
+
+#include <string.h>
+#include "dbj_utf_conversions.h"
+#include "dbj_utf_isa.h"
+
+#ifdef DBJ_UTF_X86
+namespace dbj::utf::simd {
+
+    /*
+     * Each pair of (previous, current) bytes is classified by looking up
+     * three nibbles: high and low nibble of the previous byte and high nibble
+     * of the current byte. Bits that survive the AND of the three lookups
+     * are errors. The only thing not caught that way are the missing 3rd and
+     * 4th bytes, see utf8_check_multibyte_lengths_*
+     */
+    enum : uint8_t {
+        utf8_too_short = 1 << 0,     /* 11______ 0_______ or 11______ 11______ */
+        utf8_too_long = 1 << 1,      /* 0_______ 10______ */
+        utf8_overlong_3 = 1 << 2,    /* 11100000 100_____ */
+        utf8_too_large = 1 << 3,     /* 11110100 1001____, 11110100 101_____, 11110101 ... */
+        utf8_surrogate = 1 << 4,     /* 11101101 101_____ */
+        utf8_overlong_2 = 1 << 5,    /* 1100000_ 10______ */
+        utf8_too_large_1000 = 1 << 6,/* 11110101 1000____ and above */
+        utf8_overlong_4 = 1 << 6,    /* 11110000 1000____ */
+        utf8_two_conts = 1 << 7,     /* 10______ 10______ */
+        utf8_carry = utf8_too_short | utf8_too_long | utf8_two_conts
+    };
+
+    alignas(16) inline constexpr uint8_t utf8_byte_1_high[16] = {
+        /* 0_______ ________ <ASCII in byte 1> */
+        utf8_too_long, utf8_too_long, utf8_too_long, utf8_too_long,
+        utf8_too_long, utf8_too_long, utf8_too_long, utf8_too_long,
+        /* 10______ ________ <continuation in byte 1> */
+        utf8_two_conts, utf8_two_conts, utf8_two_conts, utf8_two_conts,
+        /* 1100____ ________ <two byte lead in byte 1> */
+        utf8_too_short | utf8_overlong_2,
+        /* 1101____ ________ <two byte lead in byte 1> */
+        utf8_too_short,
+        /* 1110____ ________ <three byte lead in byte 1> */
+        utf8_too_short | utf8_overlong_3 | utf8_surrogate,
+        /* 1111____ ________ <four+ byte lead in byte 1> */
+        utf8_too_short | utf8_too_large | utf8_too_large_1000 | utf8_overlong_4
+    };
+
+    alignas(16) inline constexpr uint8_t utf8_byte_1_low[16] = {
+        /* ____0000 ________ */
+        utf8_carry | utf8_overlong_3 | utf8_overlong_2 | utf8_overlong_4,
+        /* ____0001 ________ */
+        utf8_carry | utf8_overlong_2,
+        /* ____001_ ________ */
+        utf8_carry,
+        utf8_carry,
+        /* ____0100 ________ */
+        utf8_carry | utf8_too_large,
+        /* ____0101 ________ */
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        /* ____011_ ________ */
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        /* ____1___ ________ */
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        /* ____1101 ________ */
+        utf8_carry | utf8_too_large | utf8_too_large_1000 | utf8_surrogate,
+        utf8_carry | utf8_too_large | utf8_too_large_1000,
+        utf8_carry | utf8_too_large | utf8_too_large_1000
+    };
+
+    alignas(16) inline constexpr uint8_t utf8_byte_2_high[16] = {
+        /* ________ 0_______ <ASCII in byte 2> */
+        utf8_too_short, utf8_too_short, utf8_too_short, utf8_too_short,
+        utf8_too_short, utf8_too_short, utf8_too_short, utf8_too_short,
+        /* ________ 1000____ */
+        utf8_too_long | utf8_overlong_2 | utf8_two_conts | utf8_overlong_3 | utf8_too_large_1000 | utf8_overlong_4,
+        /* ________ 1001____ */
+        utf8_too_long | utf8_overlong_2 | utf8_two_conts | utf8_overlong_3 | utf8_too_large,
+        /* ________ 101_____ */
+        utf8_too_long | utf8_overlong_2 | utf8_two_conts | utf8_surrogate | utf8_too_large,
+        utf8_too_long | utf8_overlong_2 | utf8_two_conts | utf8_surrogate | utf8_too_large,
+        /* ________ 11______ */
+        utf8_too_short, utf8_too_short, utf8_too_short, utf8_too_short
+    };
+
+    /* last 3 bytes of a block: anything above is a sequence not finished */
+    alignas(16) inline constexpr uint8_t utf8_max_complete_16[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+    };
+
+    /* ------------------------------------------------------------------------ */
+    /* SSE4.2, 16 bytes block                                                   */
+    /* ------------------------------------------------------------------------ */
+    struct utf8_checker_sse {
+        __m128i error;
+        __m128i prev_input;
+        __m128i prev_incomplete;
+        /* lookup tables loaded once per buffer */
+        __m128i byte_1_high;
+        __m128i byte_1_low;
+        __m128i byte_2_high;
+        __m128i max_complete;
+    };
+
+    DBJ_UTF_TARGET_SSE42 inline void utf8_checker_init_sse(utf8_checker_sse& checker_) {
+        checker_.error = _mm_setzero_si128();
+        checker_.prev_input = _mm_setzero_si128();
+        checker_.prev_incomplete = _mm_setzero_si128();
+        checker_.byte_1_high = _mm_load_si128((const __m128i*)utf8_byte_1_high);
+        checker_.byte_1_low = _mm_load_si128((const __m128i*)utf8_byte_1_low);
+        checker_.byte_2_high = _mm_load_si128((const __m128i*)utf8_byte_2_high);
+        checker_.max_complete = _mm_load_si128((const __m128i*)utf8_max_complete_16);
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline __m128i utf8_check_special_cases_sse(
+        utf8_checker_sse const& checker_, __m128i input, __m128i prev1) {
+        const __m128i nibble_mask_ = _mm_set1_epi8(0x0F);
+        const __m128i byte_1_high_ = _mm_shuffle_epi8(checker_.byte_1_high,
+            _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble_mask_));
+        const __m128i byte_1_low_ = _mm_shuffle_epi8(checker_.byte_1_low,
+            _mm_and_si128(prev1, nibble_mask_));
+        const __m128i byte_2_high_ = _mm_shuffle_epi8(checker_.byte_2_high,
+            _mm_and_si128(_mm_srli_epi16(input, 4), nibble_mask_));
+        return _mm_and_si128(_mm_and_si128(byte_1_high_, byte_1_low_), byte_2_high_);
+    }
+
+    /* 3rd and 4th bytes of a sequence must be continuations and nothing else may be */
+    DBJ_UTF_TARGET_SSE42 inline __m128i utf8_check_multibyte_lengths_sse(
+        __m128i input, __m128i prev_input, __m128i special_cases) {
+        const __m128i prev2_ = _mm_alignr_epi8(input, prev_input, 16 - 2);
+        const __m128i prev3_ = _mm_alignr_epi8(input, prev_input, 16 - 3);
+        /* only 111_____ will be >= 0x80 */
+        const __m128i is_third_byte_ = _mm_subs_epu8(prev2_, _mm_set1_epi8((char)(0xE0 - 0x80)));
+        /* only 1111____ will be >= 0x80 */
+        const __m128i is_fourth_byte_ = _mm_subs_epu8(prev3_, _mm_set1_epi8((char)(0xF0 - 0x80)));
+        const __m128i must23_80_ = _mm_and_si128(
+            _mm_or_si128(is_third_byte_, is_fourth_byte_), _mm_set1_epi8((char)0x80));
+        return _mm_xor_si128(must23_80_, special_cases);
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline void utf8_check_block_sse(utf8_checker_sse& checker_, __m128i input) {
+        if (_mm_movemask_epi8(input) == 0) {
+            /* ASCII block, only the previous block might be unfinished */
+            checker_.error = _mm_or_si128(checker_.error, checker_.prev_incomplete);
+            checker_.prev_incomplete = _mm_setzero_si128();
+        }
+        else {
+            const __m128i prev1_ = _mm_alignr_epi8(input, checker_.prev_input, 16 - 1);
+            const __m128i special_ = utf8_check_special_cases_sse(checker_, input, prev1_);
+            checker_.error = _mm_or_si128(checker_.error,
+                utf8_check_multibyte_lengths_sse(input, checker_.prev_input, special_));
+            checker_.prev_incomplete = _mm_subs_epu8(input, checker_.max_complete);
+        }
+        checker_.prev_input = input;
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline bool utf8_checker_ok_sse(utf8_checker_sse const& checker_) {
+        return _mm_testz_si128(checker_.error, checker_.error);
+    }
+
+    DBJ_UTF_TARGET_SSE42 inline bool is_legal_utf8_buffer_sse42(const UTF8* source, const UTF8* sourceEnd) {
+        utf8_checker_sse checker_;
+        utf8_checker_init_sse(checker_);
+
+        while (sourceEnd - source >= 64) {
+            const __m128i in0_ = _mm_loadu_si128((const __m128i*)(source));
+            const __m128i in1_ = _mm_loadu_si128((const __m128i*)(source + 16));
+            const __m128i in2_ = _mm_loadu_si128((const __m128i*)(source + 32));
+            const __m128i in3_ = _mm_loadu_si128((const __m128i*)(source + 48));
+            const __m128i any_ = _mm_or_si128(_mm_or_si128(in0_, in1_), _mm_or_si128(in2_, in3_));
+            if (_mm_movemask_epi8(any_) == 0) {
+                checker_.error = _mm_or_si128(checker_.error, checker_.prev_incomplete);
+                checker_.prev_incomplete = _mm_setzero_si128();
+                checker_.prev_input = in3_;
+            }
+            else {
+                utf8_check_block_sse(checker_, in0_);
+                utf8_check_block_sse(checker_, in1_);
+                utf8_check_block_sse(checker_, in2_);
+                utf8_check_block_sse(checker_, in3_);
+                if (!utf8_checker_ok_sse(checker_))
+                    return false;
+            }
+            source += 64;
+        }
+
+        while (sourceEnd - source >= 16) {
+            utf8_check_block_sse(checker_, _mm_loadu_si128((const __m128i*)source));
+            source += 16;
+        }
+
+        /*
+         * the tail is padded with zeroes; ASCII zero after a sequence not
+         * finished is an error, and an empty tail checks the previous block
+         */
+        alignas(16) UTF8 tail_[16] = { 0 };
+        if (sourceEnd > source) /* empty input might be nullptr */
+            memcpy(tail_, source, (size_t)(sourceEnd - source));
+        utf8_check_block_sse(checker_, _mm_load_si128((const __m128i*)tail_));
+
+        return utf8_checker_ok_sse(checker_);
+    }
+
+    /* ------------------------------------------------------------------------ */
+    /* AVX2, 32 bytes block                                                     */
+    /* ------------------------------------------------------------------------ */
+    struct utf8_checker_avx {
+        __m256i error;
+        __m256i prev_input;
+        __m256i prev_incomplete;
+        __m256i byte_1_high;
+        __m256i byte_1_low;
+        __m256i byte_2_high;
+        __m256i max_complete;
+    };
+
+    DBJ_UTF_TARGET_AVX2 inline __m256i utf8_broadcast_avx(const uint8_t(&table_)[16]) {
+        return _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)table_));
+    }
+
+    /* bytes of input shifted right by N, with the top N bytes of prev coming in */
+    template <int N>
+    DBJ_UTF_TARGET_AVX2 inline __m256i utf8_prev_avx(__m256i input, __m256i prev) {
+        return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline void utf8_checker_init_avx(utf8_checker_avx& checker_) {
+        checker_.error = _mm256_setzero_si256();
+        checker_.prev_input = _mm256_setzero_si256();
+        checker_.prev_incomplete = _mm256_setzero_si256();
+        checker_.byte_1_high = utf8_broadcast_avx(utf8_byte_1_high);
+        checker_.byte_1_low = utf8_broadcast_avx(utf8_byte_1_low);
+        checker_.byte_2_high = utf8_broadcast_avx(utf8_byte_2_high);
+        /* only the upper half carries the last 3 bytes of the block */
+        checker_.max_complete = _mm256_inserti128_si256(
+            _mm256_set1_epi8((char)0xFF),
+            _mm_load_si128((const __m128i*)utf8_max_complete_16), 1);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline void utf8_check_block_avx(utf8_checker_avx& checker_, __m256i input) {
+        if (_mm256_movemask_epi8(input) == 0) {
+            checker_.error = _mm256_or_si256(checker_.error, checker_.prev_incomplete);
+            checker_.prev_incomplete = _mm256_setzero_si256();
+        }
+        else {
+            const __m256i nibble_mask_ = _mm256_set1_epi8(0x0F);
+            const __m256i prev1_ = utf8_prev_avx<1>(input, checker_.prev_input);
+            const __m256i byte_1_high_ = _mm256_shuffle_epi8(checker_.byte_1_high,
+                _mm256_and_si256(_mm256_srli_epi16(prev1_, 4), nibble_mask_));
+            const __m256i byte_1_low_ = _mm256_shuffle_epi8(checker_.byte_1_low,
+                _mm256_and_si256(prev1_, nibble_mask_));
+            const __m256i byte_2_high_ = _mm256_shuffle_epi8(checker_.byte_2_high,
+                _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble_mask_));
+            const __m256i special_ = _mm256_and_si256(_mm256_and_si256(byte_1_high_, byte_1_low_), byte_2_high_);
+
+            const __m256i prev2_ = utf8_prev_avx<2>(input, checker_.prev_input);
+            const __m256i prev3_ = utf8_prev_avx<3>(input, checker_.prev_input);
+            const __m256i is_third_byte_ = _mm256_subs_epu8(prev2_, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+            const __m256i is_fourth_byte_ = _mm256_subs_epu8(prev3_, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+            const __m256i must23_80_ = _mm256_and_si256(
+                _mm256_or_si256(is_third_byte_, is_fourth_byte_), _mm256_set1_epi8((char)0x80));
+
+            checker_.error = _mm256_or_si256(checker_.error, _mm256_xor_si256(must23_80_, special_));
+            checker_.prev_incomplete = _mm256_subs_epu8(input, checker_.max_complete);
+        }
+        checker_.prev_input = input;
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline bool utf8_checker_ok_avx(utf8_checker_avx const& checker_) {
+        return _mm256_testz_si256(checker_.error, checker_.error);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline bool is_legal_utf8_buffer_avx2(const UTF8* source, const UTF8* sourceEnd) {
+        utf8_checker_avx checker_;
+        utf8_checker_init_avx(checker_);
+
+        while (sourceEnd - source >= 64) {
+            const __m256i in0_ = _mm256_loadu_si256((const __m256i*)(source));
+            const __m256i in1_ = _mm256_loadu_si256((const __m256i*)(source + 32));
+            if (_mm256_movemask_epi8(_mm256_or_si256(in0_, in1_)) == 0) {
+                checker_.error = _mm256_or_si256(checker_.error, checker_.prev_incomplete);
+                checker_.prev_incomplete = _mm256_setzero_si256();
+                checker_.prev_input = in1_;
+            }
+            else {
+                utf8_check_block_avx(checker_, in0_);
+                utf8_check_block_avx(checker_, in1_);
+                if (!utf8_checker_ok_avx(checker_))
+                    return false;
+            }
+            source += 64;
+        }
+
+        if (sourceEnd - source >= 32) {
+            utf8_check_block_avx(checker_, _mm256_loadu_si256((const __m256i*)source));
+            source += 32;
+        }
+
+        alignas(32) UTF8 tail_[32] = { 0 };
+        if (sourceEnd > source) /* empty input might be nullptr */
+            memcpy(tail_, source, (size_t)(sourceEnd - source));
+        utf8_check_block_avx(checker_, _mm256_load_si256((const __m256i*)tail_));
+
+        return utf8_checker_ok_avx(checker_);
+    }
+
+} // namespace dbj::utf::simd
+#endif // DBJ_UTF_X86
+
+#ifdef __cplusplus
+namespace dbj::utf {
+    extern "C" {
+#endif  // __cplusplus
+
+        /* --------------------------------------------------------------------- */
+        /*
+         * The reference. Whole buffer is legal if it is made of legal sequences
+         * only. Empty buffer is legal.
+         */
+        inline bool is_legal_utf8_buffer_scalar(const UTF8* source, const UTF8* sourceEnd) {
+            while (source < sourceEnd) {
+                if (!is_legal_utf8_sequence(source, sourceEnd))
+                    return false;
+                source += trailing_bytes_for_utf8[*source] + 1;
+            }
+            return true;
+        }
+
+        /* --------------------------------------------------------------------- */
+        /*
+         * Portable fallback. Same as the reference but skipping ASCII
+         * runs a machine word at the time.
+         */
+        inline bool is_legal_utf8_buffer_word(const UTF8* source, const UTF8* sourceEnd) {
+            const uint64_t high_bits = 0x8080808080808080ULL;
+            while (source < sourceEnd) {
+                uint64_t word_;
+                while (sourceEnd - source >= 8) {
+                    memcpy(&word_, source, 8);
+                    if (word_ & high_bits)
+                        break;
+                    source += 8;
+                }
+                if (source == sourceEnd)
+                    break;
+                if (*source < 0x80) {
+                    ++source;
+                    continue;
+                }
+                const int length = trailing_bytes_for_utf8[*source] + 1;
+                if (sourceEnd - source < length)
+                    return false;
+                if (!is_legal_utf8(source, length))
+                    return false;
+                source += length;
+            }
+            return true;
+        }
+
+        /* --------------------------------------------------------------------- */
+        /*
+         * Exported function to return whether a whole UTF-8 buffer is legal or
+         * not. Same verdict as is_legal_utf8_buffer_scalar(), best kernel for
+         * the machine is used.
+         */
+        inline bool is_legal_utf8_buffer(const UTF8* source, const UTF8* sourceEnd) {
+#ifdef DBJ_UTF_X86
+            switch (utf_isa()) {
+            case utf_isa_avx2:
+                return simd::is_legal_utf8_buffer_avx2(source, sourceEnd);
+            case utf_isa_sse42:
+                return simd::is_legal_utf8_buffer_sse42(source, sourceEnd);
+            default:
+                break;
+            }
+#endif // DBJ_UTF_X86
+            return is_legal_utf8_buffer_word(source, sourceEnd);
+        }
+
+#ifdef __cplusplus
+    } // "C"
+} // namespace dbj::utf
+#endif  // __cplusplus
+
+#include "dbj_utf_transcode.h"
+
+#endif  // !DBJ_UTF_VALIDATE_INC
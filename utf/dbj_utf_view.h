@@ -0,0 +1,457 @@
+#pragma once
+#ifndef DBJ_UTF_VIEW_INC
+#define DBJ_UTF_VIEW_INC
+
+/*
+    (c) 2021 by dbj@dbj.org -- https://dbj.org/license_dbj
+
+    Non owning views over UTF-8 and UTF-16 buffers. Code points are decoded
+    on the fly, while iterating; nothing is allocated and nothing is copied.
+
+    const char * text_ = ... ;
+    dbj::utf::utf8_view view_(text_, text_len_);
+    for (char32_t cp_ : view_) ...
+    auto it_ = view_.advance(view_.begin(), 42); // SIMD skip
+    size_t cps_ = view_.count_code_points();     // SIMD count
+
+    Views do not validate. Well formed text decodes as expected, ill formed
+    sequences decode as U+FFFD. In UTF-8 each byte that is not a
+    continuation byte starts a code point, and continuation bytes belong to
+    the code point before them. In UTF-16 each unit starts a code point,
+    except the low surrogate right after the high one. Thus forward and
+    backward iteration, count_code_points() and advance() always agree,
+    for any input. count_code_points() is the same as
+    utf32_length_from_utf8() / utf32_length_from_utf16()
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <wchar.h>
+#include <iterator>
+#include <string_view>
+#include "dbj_utf_validate.h"
+#include "dbj_utf_length.h"
+
+#ifdef DBJ_UTF_X86
+namespace dbj::utf::simd {
+
+    /* index of the lowest set bit, bits_ must not be 0 */
+    inline unsigned utf_lowest_bit(unsigned bits_) {
+#ifdef _MSC_VER
+        unsigned long index_ = 0;
+        _BitScanForward(&index_, bits_);
+        return (unsigned)index_;
+#else
+        return (unsigned)__builtin_ctz(bits_);
+#endif
+    }
+
+    /* index of the n-th (1 based) set bit, bits_ has at least n of them */
+    inline unsigned utf_nth_bit(unsigned bits_, size_t n) {
+        while (--n > 0)
+            bits_ &= bits_ - 1;
+        return utf_lowest_bit(bits_);
+    }
+
+    /* ------------------------------------------------------------------------ */
+    /* SSE4.2                                                                   */
+    /* ------------------------------------------------------------------------ */
+
+    /*
+     * Position of the n-th code point start at or after source, sourceEnd
+     * if there are less than n. Starts are bytes that are not 0x80 .. 0xBF,
+     * as signed bytes not less than -64
+     */
+    DBJ_UTF_TARGET_SSE42 inline const UTF8* utf8_nth_start_sse42(const UTF8* source, const UTF8* sourceEnd, size_t n) {
+        for (; sourceEnd - source >= 16; source += 16) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const unsigned starts_ = 0xFFFF & ~(unsigned)_mm_movemask_epi8(
+                _mm_cmplt_epi8(in_, _mm_set1_epi8(-64)));
+            const size_t count_ = (size_t)_mm_popcnt_u32(starts_);
+            if (count_ >= n)
+                return source + utf_nth_bit(starts_, n);
+            n -= count_;
+        }
+        for (; source < sourceEnd; ++source)
+            if ((*source & 0xC0) != 0x80 && --n == 0)
+                return source;
+        return sourceEnd;
+    }
+
+    /*
+     * Same for UTF-16, starts are units that are not low surrogates right
+     * after the high ones. source[-1] must be readable
+     */
+    DBJ_UTF_TARGET_SSE42 inline const UTF16* utf16_nth_start_sse42(const UTF16* source, const UTF16* sourceEnd, size_t n) {
+        for (; sourceEnd - source >= 8; source += 8) {
+            const __m128i in_ = _mm_loadu_si128((const __m128i*)source);
+            const __m128i prev_ = _mm_loadu_si128((const __m128i*)(source - 1));
+            const __m128i surrogate_mask_ = _mm_set1_epi16((short)0xFC00);
+            const __m128i low_after_high_ = _mm_and_si128(
+                _mm_cmpeq_epi16(_mm_and_si128(prev_, surrogate_mask_), _mm_set1_epi16((short)0xD800)),
+                _mm_cmpeq_epi16(_mm_and_si128(in_, surrogate_mask_), _mm_set1_epi16((short)0xDC00)));
+            /* one bit per unit, the even ones */
+            const unsigned starts_ = 0x5555 & ~(unsigned)_mm_movemask_epi8(low_after_high_);
+            const size_t count_ = (size_t)_mm_popcnt_u32(starts_);
+            if (count_ >= n)
+                return source + utf_nth_bit(starts_, n) / 2;
+            n -= count_;
+        }
+        for (; source < sourceEnd; ++source)
+            if (!((source[-1] & 0xFC00) == 0xD800 && (*source & 0xFC00) == 0xDC00) && --n == 0)
+                return source;
+        return sourceEnd;
+    }
+
+    /* ------------------------------------------------------------------------ */
+    /* AVX2                                                                     */
+    /* ------------------------------------------------------------------------ */
+
+    DBJ_UTF_TARGET_AVX2 inline const UTF8* utf8_nth_start_avx2(const UTF8* source, const UTF8* sourceEnd, size_t n) {
+        for (; sourceEnd - source >= 32; source += 32) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const unsigned starts_ = ~(unsigned)_mm256_movemask_epi8(
+                _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), in_));
+            const size_t count_ = (size_t)_mm_popcnt_u32(starts_);
+            if (count_ >= n)
+                return source + utf_nth_bit(starts_, n);
+            n -= count_;
+        }
+        return utf8_nth_start_sse42(source, sourceEnd, n);
+    }
+
+    DBJ_UTF_TARGET_AVX2 inline const UTF16* utf16_nth_start_avx2(const UTF16* source, const UTF16* sourceEnd, size_t n) {
+        for (; sourceEnd - source >= 16; source += 16) {
+            const __m256i in_ = _mm256_loadu_si256((const __m256i*)source);
+            const __m256i prev_ = _mm256_loadu_si256((const __m256i*)(source - 1));
+            const __m256i surrogate_mask_ = _mm256_set1_epi16((short)0xFC00);
+            const __m256i low_after_high_ = _mm256_and_si256(
+                _mm256_cmpeq_epi16(_mm256_and_si256(prev_, surrogate_mask_), _mm256_set1_epi16((short)0xD800)),
+                _mm256_cmpeq_epi16(_mm256_and_si256(in_, surrogate_mask_), _mm256_set1_epi16((short)0xDC00)));
+            const unsigned starts_ = 0x55555555u & ~(unsigned)_mm256_movemask_epi8(low_after_high_);
+            const size_t count_ = (size_t)_mm_popcnt_u32(starts_);
+            if (count_ >= n)
+                return source + utf_nth_bit(starts_, n) / 2;
+            n -= count_;
+        }
+        return utf16_nth_start_sse42(source, sourceEnd, n);
+    }
+
+} // namespace dbj::utf::simd
+#endif // DBJ_UTF_X86
+
+#ifdef __cplusplus
+namespace dbj::utf {
+    extern "C" {
+#endif  // __cplusplus
+
+        /* --------------------------------------------------------------------- */
+        inline const UTF8* utf8_nth_start_scalar(const UTF8* source, const UTF8* sourceEnd, size_t n) {
+            for (; source < sourceEnd; ++source)
+                if ((*source & 0xC0) != 0x80 && --n == 0)
+                    return source;
+            return sourceEnd;
+        }
+
+        inline const UTF16* utf16_nth_start_scalar(const UTF16* source, const UTF16* sourceEnd, size_t n) {
+            for (; source < sourceEnd; ++source)
+                if (!((source[-1] & 0xFC00) == 0xD800 && (*source & 0xFC00) == 0xDC00) && --n == 0)
+                    return source;
+            return sourceEnd;
+        }
+
+#undef DBJ_UTF_VIEW_DISPATCH
+#ifdef DBJ_UTF_X86
+#define DBJ_UTF_VIEW_DISPATCH(name_, source_, sourceEnd_, n_) \
+            switch (utf_isa()) { \
+            case utf_isa_avx2: return simd::name_##_avx2(source_, sourceEnd_, n_); \
+            case utf_isa_sse42: return simd::name_##_sse42(source_, sourceEnd_, n_); \
+            default: return name_##_scalar(source_, sourceEnd_, n_); \
+            }
+#else
+#define DBJ_UTF_VIEW_DISPATCH(name_, source_, sourceEnd_, n_) \
+            return name_##_scalar(source_, sourceEnd_, n_)
+#endif
+
+        /*
+         * Start of the code point n code points after the one starting at
+         * source, sourceEnd if there are not that many
+         */
+        inline const UTF8* utf8_advance(const UTF8* source, const UTF8* sourceEnd, size_t n) {
+            if (n == 0 || source >= sourceEnd) return source;
+            DBJ_UTF_VIEW_DISPATCH(utf8_nth_start, source + 1, sourceEnd, n);
+        }
+
+        inline const UTF16* utf16_advance(const UTF16* source, const UTF16* sourceEnd, size_t n) {
+            if (n == 0 || source >= sourceEnd) return source;
+            DBJ_UTF_VIEW_DISPATCH(utf16_nth_start, source + 1, sourceEnd, n);
+        }
+
+#undef DBJ_UTF_VIEW_DISPATCH
+
+#ifdef __cplusplus
+    } // "C"
+} // namespace dbj::utf
+#endif  // __cplusplus
+
+namespace dbj::utf {
+
+    /* ------------------------------------------------------------------------ */
+    class utf8_view final {
+    public:
+        using value_type = char32_t;
+        using size_type = size_t;
+
+        class iterator final {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = char32_t;
+            using difference_type = ptrdiff_t;
+            using pointer = void;
+            using reference = char32_t;
+
+            iterator() noexcept = default;
+
+            char32_t operator*() const noexcept {
+                const UTF8* next_ = pos_;
+                return decode(pos_, end_, next_);
+            }
+
+            iterator& operator++() noexcept {
+                assert(pos_ < end_);
+                do ++pos_; while (pos_ < end_ && (*pos_ & 0xC0) == 0x80);
+                return *this;
+            }
+
+            iterator operator++(int) noexcept { iterator prev_ = *this; ++*this; return prev_; }
+
+            iterator& operator--() noexcept {
+                assert(pos_ > begin_);
+                do --pos_; while (pos_ > begin_ && (*pos_ & 0xC0) == 0x80);
+                return *this;
+            }
+
+            iterator operator--(int) noexcept { iterator prev_ = *this; --*this; return prev_; }
+
+            /* position in the buffer, the first unit of the code point */
+            const UTF8* base() const noexcept { return pos_; }
+
+            friend bool operator==(const iterator& a, const iterator& b) noexcept { return a.pos_ == b.pos_; }
+            friend bool operator!=(const iterator& a, const iterator& b) noexcept { return a.pos_ != b.pos_; }
+
+        private:
+            friend class utf8_view;
+
+            iterator(const UTF8* begin, const UTF8* pos, const UTF8* end) noexcept
+                : begin_(begin), pos_(pos), end_(end) {
+            }
+
+            const UTF8* begin_{};
+            const UTF8* pos_{};
+            const UTF8* end_{};
+        };
+
+        using const_iterator = iterator;
+
+        constexpr utf8_view() noexcept = default;
+
+        utf8_view(const UTF8* data, size_t size) noexcept : data_(data), size_(size) {
+            assert(data || size == 0);
+        }
+
+        utf8_view(const char* data, size_t size) noexcept
+            : utf8_view(reinterpret_cast<const UTF8*>(data), size) {
+        }
+
+        explicit utf8_view(const char* src) noexcept
+            : utf8_view(src, src ? strlen(src) : 0) {
+        }
+
+        utf8_view(std::string_view src) noexcept
+            : utf8_view(src.data(), src.size()) {
+        }
+
+#ifdef __cpp_char8_t
+        utf8_view(std::u8string_view src) noexcept
+            : utf8_view(reinterpret_cast<const UTF8*>(src.data()), src.size()) {
+        }
+#endif
+
+        const UTF8* data() const noexcept { return data_; }
+        /* in code units */
+        size_t size() const noexcept { return size_; }
+        bool empty() const noexcept { return size_ == 0; }
+
+        iterator begin() const noexcept { return iterator(data_, data_, data_ + size_); }
+        iterator end() const noexcept { return iterator(data_, data_ + size_, data_ + size_); }
+
+        /* continuation bytes at the very beginning are one code point */
+        size_t count_code_points() const noexcept {
+            if (size_ == 0) return 0;
+            return utf32_length_from_utf8(data_, data_ + size_) + ((*data_ & 0xC0) == 0x80);
+        }
+
+        /* n code points forward, not beyond the end */
+        iterator advance(iterator pos, size_t n) const noexcept {
+            return iterator(data_, utf8_advance(pos.pos_, data_ + size_, n), data_ + size_);
+        }
+
+        bool valid() const noexcept { return is_legal_utf8_buffer(data_, data_ + size_); }
+
+        /* the code point starting at pos, next_ is set to the start of the next one */
+        static char32_t decode(const UTF8* pos, const UTF8* end, const UTF8*& next_) noexcept {
+            assert(pos < end);
+            UTF32 ch_ = *pos;
+            next_ = pos + 1;
+            while (next_ < end && (*next_ & 0xC0) == 0x80)
+                ++next_;
+            const size_t length_ = (size_t)(next_ - pos);
+
+            if (ch_ < 0x80)
+                return length_ == 1 ? (char32_t)ch_ : (char32_t)LINENOISE_UNI_REPLACEMENT_CHAR;
+
+            const size_t expected_ = ch_ >= 0xF5 ? 0 : ch_ >= 0xF0 ? 4 : ch_ >= 0xE0 ? 3 : ch_ >= 0xC2 ? 2 : 0;
+            if (length_ != expected_)
+                return (char32_t)LINENOISE_UNI_REPLACEMENT_CHAR;
+
+            static constexpr UTF32 minimum_[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+            ch_ &= 0x7Fu >> expected_;
+            for (size_t k = 1; k < length_; ++k)
+                ch_ = (ch_ << 6) | (pos[k] & 0x3Fu);
+            if (ch_ < minimum_[expected_] || ch_ > LINENOISE_UNI_MAX_LEGAL_UTF32 ||
+                (ch_ >= LINENOISE_UNI_SUR_HIGH_START && ch_ <= LINENOISE_UNI_SUR_LOW_END))
+                return (char32_t)LINENOISE_UNI_REPLACEMENT_CHAR;
+            return (char32_t)ch_;
+        }
+
+    private:
+        const UTF8* data_{};
+        size_t size_{};
+    };
+
+    /* ------------------------------------------------------------------------ */
+    class utf16_view final {
+    public:
+        using value_type = char32_t;
+        using size_type = size_t;
+
+        class iterator final {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = char32_t;
+            using difference_type = ptrdiff_t;
+            using pointer = void;
+            using reference = char32_t;
+
+            iterator() noexcept = default;
+
+            char32_t operator*() const noexcept {
+                const UTF16* next_ = pos_;
+                return decode(pos_, end_, next_);
+            }
+
+            iterator& operator++() noexcept {
+                assert(pos_ < end_);
+                if ((*pos_ & 0xFC00) == 0xD800 && pos_ + 1 < end_ && (pos_[1] & 0xFC00) == 0xDC00)
+                    ++pos_;
+                ++pos_;
+                return *this;
+            }
+
+            iterator operator++(int) noexcept { iterator prev_ = *this; ++*this; return prev_; }
+
+            iterator& operator--() noexcept {
+                assert(pos_ > begin_);
+                --pos_;
+                if ((*pos_ & 0xFC00) == 0xDC00 && pos_ > begin_ && (pos_[-1] & 0xFC00) == 0xD800)
+                    --pos_;
+                return *this;
+            }
+
+            iterator operator--(int) noexcept { iterator prev_ = *this; --*this; return prev_; }
+
+            /* position in the buffer, the first unit of the code point */
+            const UTF16* base() const noexcept { return pos_; }
+
+            friend bool operator==(const iterator& a, const iterator& b) noexcept { return a.pos_ == b.pos_; }
+            friend bool operator!=(const iterator& a, const iterator& b) noexcept { return a.pos_ != b.pos_; }
+
+        private:
+            friend class utf16_view;
+
+            iterator(const UTF16* begin, const UTF16* pos, const UTF16* end) noexcept
+                : begin_(begin), pos_(pos), end_(end) {
+            }
+
+            const UTF16* begin_{};
+            const UTF16* pos_{};
+            const UTF16* end_{};
+        };
+
+        using const_iterator = iterator;
+
+        constexpr utf16_view() noexcept = default;
+
+        utf16_view(const UTF16* data, size_t size) noexcept : data_(data), size_(size) {
+            assert(data || size == 0);
+        }
+
+        utf16_view(const char16_t* data, size_t size) noexcept
+            : utf16_view(reinterpret_cast<const UTF16*>(data), size) {
+        }
+
+        utf16_view(std::u16string_view src) noexcept
+            : utf16_view(src.data(), src.size()) {
+        }
+
+#if WCHAR_MAX == 0xFFFF
+        utf16_view(const wchar_t* data, size_t size) noexcept
+            : utf16_view(reinterpret_cast<const UTF16*>(data), size) {
+        }
+
+        utf16_view(std::wstring_view src) noexcept
+            : utf16_view(src.data(), src.size()) {
+        }
+#endif
+
+        const UTF16* data() const noexcept { return data_; }
+        /* in code units */
+        size_t size() const noexcept { return size_; }
+        bool empty() const noexcept { return size_ == 0; }
+
+        iterator begin() const noexcept { return iterator(data_, data_, data_ + size_); }
+        iterator end() const noexcept { return iterator(data_, data_ + size_, data_ + size_); }
+
+        size_t count_code_points() const noexcept {
+            return utf32_length_from_utf16(data_, data_ + size_);
+        }
+
+        /* n code points forward, not beyond the end */
+        iterator advance(iterator pos, size_t n) const noexcept {
+            return iterator(data_, utf16_advance(pos.pos_, data_ + size_, n), data_ + size_);
+        }
+
+        /* the code point starting at pos, next_ is set to the start of the next one */
+        static char32_t decode(const UTF16* pos, const UTF16* end, const UTF16*& next_) noexcept {
+            assert(pos < end);
+            const UTF32 ch_ = *pos;
+            next_ = pos + 1;
+            if (ch_ >= LINENOISE_UNI_SUR_HIGH_START && ch_ <= LINENOISE_UNI_SUR_LOW_END) {
+                if (ch_ <= LINENOISE_UNI_SUR_HIGH_END && next_ < end && (*next_ & 0xFC00) == 0xDC00) {
+                    const UTF32 low_ = *next_++;
+                    return (char32_t)(((ch_ - LINENOISE_UNI_SUR_HIGH_START) << linenoise_halfshift)
+                        + (low_ - LINENOISE_UNI_SUR_LOW_START) + linenoise_halfbase);
+                }
+                return (char32_t)LINENOISE_UNI_REPLACEMENT_CHAR;
+            }
+            return (char32_t)ch_;
+        }
+
+    private:
+        const UTF16* data_{};
+        size_t size_{};
+    };
+
+} // namespace dbj::utf
+
+#endif // !DBJ_UTF_VIEW_INC
@@ -1,6 +1,11 @@
 #pragma once
 #ifndef DBJ_WCWIDTH_INC
 #define DBJ_WCWIDTH_INC
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dbj_wcwidth_intervals.h"
+
 /*
  * DBJ changed back to C
  * defined in wcwidth.c
@@ -17,7 +22,284 @@ extern "C" {
 	 * @param n    length of text to calculate
 	 */
 	extern int dbj_wcswidth(const char32_t* pwcs, size_t n);
+	/**
+	 * East Asian Ambiguous characters are 2 columns wide
+	 */
+	extern int dbj_wcwidth_cjk(char32_t ucs);
+	extern int dbj_wcswidth_cjk(const char32_t* pwcs, size_t n);
 } // "C"
 
-#endif // !DBJ_WCWIDTH_INC
+/*
+ * C++ versions, same results as the C ones above, header only.
+ *
+ * Instead of the binary search over the interval tables, two stage lookup
+ * table made at compile time: 256 code points pages, the page index is
+ * the first stage, the second stage is 2 bits per code point. Thus each
+ * lookup is two loads, a shift and a mask.
+ *
+ * Most of the pages are uniform: all code points of the same width. They
+ * all share 4 pages, one per width. Only the pages that have interval
+ * boundaries inside are stored.
+ *
+ * The DBJ_WCWIDTH_TEST block at the bottom compares them with wcwidth.c,
+ * for all the 0x110000 code points:
+ *
+ * gcc -O2 -c wcwidth.c
+ * g++ -std=c++17 -O2 -DDBJ_WCWIDTH_TEST -x c++ dbj_wcwidth.h -x none wcwidth.o
+ */
+namespace dbj::utf {
+
+	struct wcwidth_interval {
+		char32_t first;
+		char32_t last;
+	};
+
+	inline constexpr wcwidth_interval wcwidth_combining[] = { DBJ_WCWIDTH_COMBINING };
+	inline constexpr wcwidth_interval wcwidth_ambiguous[] = { DBJ_WCWIDTH_AMBIGUOUS };
+	inline constexpr wcwidth_interval wcwidth_wide[] = { DBJ_WCWIDTH_WIDE };
+	inline constexpr wcwidth_interval wcwidth_control[] = { { 0x01, 0x1F }, { 0x7F, 0x9F } };
+	inline constexpr wcwidth_interval wcwidth_null[] = { { 0x00, 0x00 } };
+
+	enum : unsigned {
+		wcwidth_page_bits = 8,
+		wcwidth_page_size = 1U << wcwidth_page_bits,
+		wcwidth_page_count = 0x110000U >> wcwidth_page_bits,
+		/* 2 bits per code point */
+		wcwidth_page_bytes = wcwidth_page_size / 4
+	};
+
+	/* 2 bit codes, -1 is 3 */
+	enum : uint8_t { wcwidth_code_control = 3 };
+
+	inline constexpr int8_t wcwidth_from_code[4] = { 0, 1, 2, -1 };
+
+	template <size_t N>
+	constexpr bool wcwidth_find(char32_t ucs, const wcwidth_interval(&table)[N]) noexcept {
+		size_t min_ = 0, max_ = N;
+		while (min_ < max_) {
+			const size_t mid_ = (min_ + max_) / 2;
+			if (ucs > table[mid_].last)
+				min_ = mid_ + 1;
+			else if (ucs < table[mid_].first)
+				max_ = mid_;
+			else
+				return true;
+		}
+		return false;
+	}
+
+	/* 2 bit code of one code point, the precedence is as in wcwidth.c */
+	constexpr uint8_t wcwidth_code(char32_t ucs, bool cjk) noexcept {
+		if (cjk && wcwidth_find(ucs, wcwidth_ambiguous)) return 2;
+		if (ucs == 0) return 0;
+		if (wcwidth_find(ucs, wcwidth_control)) return wcwidth_code_control;
+		if (wcwidth_find(ucs, wcwidth_combining)) return 0;
+		if (wcwidth_find(ucs, wcwidth_wide)) return 2;
+		return 1;
+	}
+
+	/* page has an interval boundary inside */
+	template <size_t N>
+	constexpr void wcwidth_mark_mixed(bool(&mixed)[wcwidth_page_count], const wcwidth_interval(&table)[N]) noexcept {
+		for (size_t k = 0; k < N; ++k) {
+			if (table[k].first % wcwidth_page_size != 0)
+				mixed[table[k].first >> wcwidth_page_bits] = true;
+			const char32_t next_ = table[k].last + 1;
+			if (next_ % wcwidth_page_size != 0 && next_ < 0x110000)
+				mixed[next_ >> wcwidth_page_bits] = true;
+		}
+	}
+
+	struct wcwidth_mixed_pages {
+		bool mixed[wcwidth_page_count];
+		unsigned count;
+	};
+
+	constexpr wcwidth_mixed_pages wcwidth_find_mixed(bool cjk) noexcept {
+		wcwidth_mixed_pages pages_{};
+		wcwidth_mark_mixed(pages_.mixed, wcwidth_null);
+		wcwidth_mark_mixed(pages_.mixed, wcwidth_control);
+		wcwidth_mark_mixed(pages_.mixed, wcwidth_combining);
+		wcwidth_mark_mixed(pages_.mixed, wcwidth_wide);
+		if (cjk)
+			wcwidth_mark_mixed(pages_.mixed, wcwidth_ambiguous);
+		for (unsigned p = 0; p < wcwidth_page_count; ++p)
+			pages_.count += pages_.mixed[p];
+		return pages_;
+	}
+
+	/* paint the page codes with one interval table, later paint wins */
+	template <size_t N>
+	constexpr void wcwidth_paint(uint8_t(&codes)[wcwidth_page_size], char32_t page_first,
+		const wcwidth_interval(&table)[N], uint8_t code) noexcept {
+		const char32_t page_last = page_first + wcwidth_page_size - 1;
+		for (size_t k = 0; k < N; ++k) {
+			if (table[k].last < page_first || table[k].first > page_last)
+				continue;
+			const char32_t from_ = table[k].first < page_first ? page_first : table[k].first;
+			const char32_t to_ = table[k].last > page_last ? page_last : table[k].last;
+			for (char32_t ucs = from_; ucs <= to_; ++ucs)
+				codes[ucs - page_first] = code;
+		}
+	}
+
+	template <bool cjk>
+	struct wcwidth_table {
+		static constexpr unsigned mixed_count = wcwidth_find_mixed(cjk).count;
+		static_assert(4 + mixed_count <= 256, "page index must fit in a byte");
+
+		/* first stage */
+		uint8_t page[wcwidth_page_count];
+		/* second stage, pages 0 .. 3 are uniform, of the code 0 .. 3 */
+		uint8_t cells[4 + mixed_count][wcwidth_page_bytes];
+	};
+
+	template <bool cjk>
+	constexpr wcwidth_table<cjk> wcwidth_make_table() noexcept {
+		wcwidth_table<cjk> table_{};
+		const wcwidth_mixed_pages pages_ = wcwidth_find_mixed(cjk);
+
+		for (unsigned code_ = 0; code_ < 4; ++code_)
+			for (unsigned k = 0; k < wcwidth_page_bytes; ++k)
+				table_.cells[code_][k] = (uint8_t)(code_ * 0x55);
 
+		unsigned next_ = 4;
+		for (unsigned p = 0; p < wcwidth_page_count; ++p) {
+			const char32_t first_ = (char32_t)p << wcwidth_page_bits;
+			if (!pages_.mixed[p]) {
+				table_.page[p] = wcwidth_code(first_, cjk);
+				continue;
+			}
+			uint8_t codes_[wcwidth_page_size]{};
+			for (unsigned k = 0; k < wcwidth_page_size; ++k)
+				codes_[k] = 1;
+			wcwidth_paint(codes_, first_, wcwidth_wide, 2);
+			wcwidth_paint(codes_, first_, wcwidth_combining, 0);
+			wcwidth_paint(codes_, first_, wcwidth_control, wcwidth_code_control);
+			wcwidth_paint(codes_, first_, wcwidth_null, 0);
+			if (cjk)
+				wcwidth_paint(codes_, first_, wcwidth_ambiguous, 2);
+
+			for (unsigned k = 0; k < wcwidth_page_size; ++k)
+				table_.cells[next_][k / 4] |= (uint8_t)(codes_[k] << ((k % 4) * 2));
+			table_.page[p] = (uint8_t)next_++;
+		}
+		return table_;
+	}
+
+	inline constexpr wcwidth_table<false> wcwidth_plain = wcwidth_make_table<false>();
+	inline constexpr wcwidth_table<true> wcwidth_cjk_table = wcwidth_make_table<true>();
+
+	template <bool cjk>
+	constexpr int wcwidth_lookup(const wcwidth_table<cjk>& table, char32_t ucs) noexcept {
+		/* beyond Unicode, as in wcwidth.c */
+		if (ucs >= 0x110000) return 1;
+		const uint8_t cell_ = table.cells[table.page[ucs >> wcwidth_page_bits]][(ucs % wcwidth_page_size) / 4];
+		return wcwidth_from_code[(cell_ >> ((ucs % 4) * 2)) & 3];
+	}
+
+	/* dbj_wcwidth() */
+	constexpr int wcwidth(char32_t ucs) noexcept {
+		return wcwidth_lookup(wcwidth_plain, ucs);
+	}
+
+	/* dbj_wcwidth_cjk() */
+	constexpr int wcwidth_cjk(char32_t ucs) noexcept {
+		return wcwidth_lookup(wcwidth_cjk_table, ucs);
+	}
+
+	/*
+	 * dbj_wcswidth(), up to n code points or up to the first 0
+	 * -1 on the first control character.
+	 * Printable ASCII and Latin-1 (0x20 .. 0x7E, 0xA0 .. 0xFF) are all 1
+	 * column wide, they are simply counted.
+	 */
+	inline int wcswidth(const char32_t* pwcs, size_t n) noexcept {
+		int width_ = 0;
+		const char32_t* const end_ = pwcs + n;
+		while (pwcs < end_) {
+			const char32_t* run_ = pwcs;
+			while (pwcs < end_ && ((*pwcs - 0x20U) < 0x5FU || (*pwcs - 0xA0U) < 0x60U))
+				++pwcs;
+			width_ += (int)(pwcs - run_);
+			if (pwcs == end_ || *pwcs == 0)
+				break;
+			const int w_ = wcwidth(*pwcs++);
+			if (w_ < 0)
+				return -1;
+			width_ += w_;
+		}
+		return width_;
+	}
+
+	/*
+	 * dbj_wcswidth_cjk(), Latin-1 has ambiguous characters thus only
+	 * printable ASCII is counted
+	 */
+	inline int wcswidth_cjk(const char32_t* pwcs, size_t n) noexcept {
+		int width_ = 0;
+		const char32_t* const end_ = pwcs + n;
+		while (pwcs < end_) {
+			const char32_t* run_ = pwcs;
+			while (pwcs < end_ && (*pwcs - 0x20U) < 0x5FU)
+				++pwcs;
+			width_ += (int)(pwcs - run_);
+			if (pwcs == end_ || *pwcs == 0)
+				break;
+			const int w_ = wcwidth_cjk(*pwcs++);
+			if (w_ < 0)
+				return -1;
+			width_ += w_;
+		}
+		return width_;
+	}
+
+} // namespace dbj::utf
+
+#ifdef DBJ_WCWIDTH_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * every code point, then a few beyond Unicode, through the tables here
+ * and through the interval search of wcwidth.c
+ * then all the Latin-1 and BMP strings of up to 8 code points, in 1024
+ * code points steps, through wcswidth
+ */
+int main(void) {
+	static_assert(dbj::utf::wcwidth(U'a') == 1 && dbj::utf::wcwidth(0x4E00) == 2, "wcwidth is not constexpr");
+
+	unsigned long mismatches_ = 0;
+	const auto check_ = [&](char32_t ucs_) {
+		if (dbj::utf::wcwidth(ucs_) != dbj_wcwidth(ucs_) || dbj::utf::wcwidth_cjk(ucs_) != dbj_wcwidth_cjk(ucs_)) {
+			if (mismatches_++ < 16)
+				printf("U+%04X: wcwidth %d, expected %d, wcwidth_cjk %d, expected %d\n", (unsigned)ucs_,
+					dbj::utf::wcwidth(ucs_), dbj_wcwidth(ucs_), dbj::utf::wcwidth_cjk(ucs_), dbj_wcwidth_cjk(ucs_));
+		}
+	};
+	for (char32_t ucs_ = 0; ucs_ < 0x110000; ++ucs_)
+		check_(ucs_);
+	const char32_t beyond_[] = { 0x110000U, 0x12FFFFU, 0x7FFFFFFFU, 0xFFFFFFFFU };
+	for (char32_t ucs_ : beyond_)
+		check_(ucs_);
+
+	char32_t text_[8]{};
+	for (char32_t from_ = 0; from_ < 0x10000; from_ += 1024 - 5) {
+		for (size_t k = 0; k < 8; ++k)
+			text_[k] = from_ + (char32_t)(k * 131);
+		for (size_t n = 0; n <= 8; ++n)
+			if (dbj::utf::wcswidth(text_, n) != dbj_wcswidth(text_, n) ||
+				dbj::utf::wcswidth_cjk(text_, n) != dbj_wcswidth_cjk(text_, n)) {
+				if (mismatches_++ < 16)
+					printf("wcswidth from U+%04X, %zu code points\n", (unsigned)from_, n);
+			}
+	}
+
+	printf("%lu mismatches\n", mismatches_);
+	return mismatches_ == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // DBJ_WCWIDTH_TEST
+
+#endif // !DBJ_WCWIDTH_INC